@@ -0,0 +1,145 @@
+#ifndef cimgBrowseScheduler
+#define cimgBrowseScheduler
+
+#include <algorithm>
+#include <chrono>
+#include <CImg.h>
+
+///
+/// \brief The BrowseScheduler class
+/// The input of the debug loops, which browse the correspondences one by one in [\c first, \c last]. Each poll
+/// drains all the input pending on the display and merges it into one target, so a fast wheel or a held key
+/// costs one render instead of one per event. The renders begin at most once per refresh period: a loop
+/// drops the render of a target left behind for the next one, and refines the current render meanwhile.
+/// The arrows and the wheel step by one; an arrow held, repeated by the system, steps by more and more,
+/// doubling every \c repeatsPerDoubling repeats up to a page. PAGEUP and PAGEDOWN step by a page, a twentieth
+/// of the range, HOME and END go to the first and the last correspondence; Q, ESC and closing the display quit.
+class BrowseScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    //! Constructor: browses [\c first, \c last] from \c first, rendering at most \c refreshRate times a second,
+    //! without limit if 0.
+    BrowseScheduler(const int first, const int last, const double refreshRate = 60.0):
+        _first(first),
+        _last(std::max(first, last)),
+        _target(first),
+        _page(std::max(10, (_last-_first+1)/20)),
+        _period(refreshRate > 0 ? 1000.0/refreshRate : 0.0),
+        _flagQuit(false),
+        _repeatKey(0),
+        _numRepeats(0),
+        _lastPress(Clock::now() - std::chrono::seconds(1)),
+        _lastRender(Clock::now() - std::chrono::seconds(1)),
+        _numEvents(0),
+        _numRenders(0)
+    {}
+
+    //! returns the correspondence to show.
+    int target(void) const {return _target;}
+    //! sets the correspondence to show, clamped to the range.
+    void target(const int target){_target = std::max(_first, std::min(target, _last));}
+    //! returns true once the user asked to quit.
+    bool quit(void) const {return _flagQuit;}
+    //! returns the refresh period in milliseconds, 0 for no limit.
+    double period(void) const {return _period;}
+    //! returns the time budget of a step of the renders: \c frameBudget, within a refresh period so a render
+    //! left behind is dropped by the next refresh.
+    double budget(const double frameBudget) const
+    {
+        return frameBudget > 0 && _period > 0 ? std::min(frameBudget, _period) : frameBudget;
+    }
+
+    ///
+    /// \brief poll
+    /// merges the input pending on \c disp into the target, waiting for an event first if \c flagWait,
+    /// then consumes it.
+    void poll(cimg_library::CImgDisplay& disp, const bool flagWait)
+    {
+        using namespace cimg_library;
+        if(flagWait && !disp.is_closed()) disp.wait();
+        const Clock::time_point now = Clock::now();
+        if(disp.is_closed() || disp.is_keyQ() || disp.is_keyESC()) _flagQuit = true;
+        // the wheel accumulates its notches since the last poll
+        if(disp.wheel() != 0)
+        {
+            ++_numEvents;
+            target(_target + disp.wheel());
+            disp.set_wheel();
+        }
+        // the keys pressed and released since the last poll, the most recent first; a release is recorded as 0
+        for(unsigned int i = 128; i-- > 0;)
+        {
+            const unsigned int key = disp.key(i);
+            if(key == 0) continue;
+            press(key, now);
+            ++_numEvents;
+        }
+        disp.set_key();
+    }
+
+    //! returns true if a render may begin, a refresh period after the previous one.
+    bool due(void) const {return delay() == 0;}
+    //! returns the milliseconds until a render may begin.
+    unsigned int delay(void) const
+    {
+        const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - _lastRender).count();
+        return elapsed >= _period ? 0 : (unsigned int)(_period - elapsed) + 1;
+    }
+    //! records the beginning of a render.
+    void rendered(void)
+    {
+        _lastRender = Clock::now();
+        ++_numRenders;
+    }
+
+    //! returns the number of input events merged.
+    long long numberOfEvents(void) const {return _numEvents;}
+    //! returns the number of renders begun.
+    long long numberOfRenders(void) const {return _numRenders;}
+
+    enum
+    {
+        repeatsPerDoubling = 8, //!< The number of repeats of a held arrow doubling its step.
+        repeatGap = 250         //!< The longest gap in milliseconds between two presses of an arrow counted as a repeat.
+    };
+
+private:
+    void press(const unsigned int key, const Clock::time_point& now)
+    {
+        using namespace cimg_library;
+        if(key == cimg::keyARROWUP || key == cimg::keyARROWRIGHT || key == cimg::keyARROWDOWN || key == cimg::keyARROWLEFT)
+        {
+            // a press soon after one of the same key is a repeat of a held key
+            const bool flagRepeat = key == _repeatKey && now - _lastPress < std::chrono::milliseconds(repeatGap);
+            _numRepeats = flagRepeat ? _numRepeats+1 : 0;
+            _repeatKey = key;
+            _lastPress = now;
+            const int step = std::min(1 << std::min(_numRepeats/repeatsPerDoubling, 20), _page);
+            target(key == cimg::keyARROWUP || key == cimg::keyARROWRIGHT ? _target + step : _target - step);
+            return;
+        }
+        _repeatKey = 0;
+        if(key == cimg::keyPAGEUP) target(_target + _page);
+        else if(key == cimg::keyPAGEDOWN) target(_target - _page);
+        else if(key == cimg::keyHOME) _target = _first;
+        else if(key == cimg::keyEND) _target = _last;
+        else if(key == cimg::keyQ || key == cimg::keyESC) _flagQuit = true;
+    }
+
+    int _first;
+    int _last;
+    int _target;
+    int _page;                          //!< The step of PAGEUP and PAGEDOWN, and the largest of the arrows.
+    double _period;
+    bool _flagQuit;
+    unsigned int _repeatKey;            //!< The arrow pressed last, 0 if another key was pressed since.
+    int _numRepeats;                    //!< The number of repeats of \c _repeatKey.
+    Clock::time_point _lastPress;
+    Clock::time_point _lastRender;
+    long long _numEvents;
+    long long _numRenders;
+};
+
+#endif
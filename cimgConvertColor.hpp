@@ -2,6 +2,7 @@
 #define cimgConvertColor
 
 #include <CImg.h>
+#include "cimgCpuDispatch.hpp"
 
 template <typename T>
 cimg_library::CImg<T> getRGBtoGray(
@@ -15,6 +16,20 @@ cimg_library::CImg<T> getRGBtoGray(
     return _img.get_RGBtoYCbCr().get_channel(0);
 }
 
+//! returns the luma of an 8-bit RGB image through the runtime-dispatched kernel, same as \c get_RGBtoYCbCr().get_channel(0).
+inline cimg_library::CImg<unsigned char> getRGBtoGray(
+    const cimg_library::CImg<unsigned char>& _img
+)
+{
+    assert(
+        _img.spectrum() == 3 &&
+        "The spectrum of the input image must be 3."
+    );
+    cimg_library::CImg<unsigned char> img(_img.width(), _img.height(), _img.depth(), 1);
+    pixelKernels().rgbToGray(_img.data(0,0,0,0), _img.data(0,0,0,1), _img.data(0,0,0,2), img.data(), img.size());
+    return img;
+}
+
 template <typename T>
 cimg_library::CImg<T> getGraytoRGB(
     const cimg_library::CImg<T>& _img
@@ -32,6 +47,24 @@ cimg_library::CImg<T> getGraytoRGB(
     return img;
 }
 
+//! returns an 8-bit RGB image replicating the gray image \c _img through the runtime-dispatched copy.
+inline cimg_library::CImg<unsigned char> getGraytoRGB(
+    const cimg_library::CImg<unsigned char>& _img
+)
+{
+    assert(
+        _img.spectrum() == 1 &&
+        "The spectrum of the input image must be 1."
+    );
+    cimg_library::CImg<unsigned char> img(_img.width(), _img.height(), _img.depth(), 3);
+    const size_t plane = (size_t)_img.width()*_img.height()*_img.depth();
+    for(int c = 0; c < 3; ++c)
+    {
+        pixelKernels().copy(img.data(0,0,0,c), _img.data(), plane);
+    }
+    return img;
+}
+
 template <typename T>
 cimg_library::CImg<T> getGrayscaledRGB(
     const cimg_library::CImg<T>& _img
@@ -44,4 +77,21 @@ cimg_library::CImg<T> getGrayscaledRGB(
     return getGraytoRGB( getRGBtoGray(_img) );
 }
 
+//! returns the grayscaled RGB image shown by the viewers, from an RGB or a gray image \c _img; the alpha channel of
+//! a gray+alpha or an RGBA image is dropped. Throws \c cimg_library::CImgArgumentException for other spectra.
+template <typename T>
+cimg_library::CImg<T> getDisplayRGB(
+    const cimg_library::CImg<T>& _img
+)
+{
+    switch(_img.spectrum())
+    {
+    case 1: return getGraytoRGB( _img );
+    case 2: return getGraytoRGB( _img.get_channel(0) );
+    case 3: return getGrayscaledRGB( _img );
+    case 4: return getGrayscaledRGB( _img.get_channels(0, 2) );
+    default: throw cimg_library::CImgArgumentException("getDisplayRGB: the spectrum of the image must be 1 to 4.");
+    }
+}
+
 #endif
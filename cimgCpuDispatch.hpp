@@ -0,0 +1,889 @@
+#ifndef cimgCpuDispatch
+#define cimgCpuDispatch
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CIMG_MATCHING_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+///
+/// \brief Runtime CPU dispatch of the 8-bit pixel kernels
+/// The hot loops over 8-bit buffers are compiled for several instruction sets in the same binary,
+/// and the best one supported by the running CPU is selected on first use.
+/// The environment variable \c CIMG_MATCHING_SIMD (scalar, sse2, avx2 or avx512) forces a lower level,
+/// e.g. to compare the variants on one machine.
+/// Every variant computes exactly the same integer arithmetic as the scalar one.
+/// The table also holds the reductions over the energies and the labels of the correspondences;
+/// the floating-point sum adds the values in the same order at every level, so its result is exact
+/// across levels too.
+
+//! SIMD levels in increasing order.
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_LEVELS
+};
+
+//! returns the name of \c level.
+inline const char* simdLevelName(const SimdLevel level)
+{
+    static const char* names[SIMD_LEVELS] = {"scalar", "sse2", "avx2", "avx512"};
+    return names[level];
+}
+
+///
+/// \brief The PixelKernelTable struct
+/// A set of 8-bit kernels compiled for one SIMD level.
+struct PixelKernelTable
+{
+    SimdLevel level;
+    //! y[i] = luma of (r[i],g[i],b[i]) as computed by \c RGBtoYCbCr.
+    void (*rgbToGray)(const unsigned char* r, const unsigned char* g, const unsigned char* b, unsigned char* y, size_t n);
+    //! dst[i] = (src0[i]*w + src1[i]*(256-w) + 128) >> 8, with w in [0,256].
+    void (*blend)(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, size_t n, unsigned int w);
+    //! dst[i] = (value*w + dst[i]*(256-w) + 128) >> 8, with w in [0,256].
+    void (*fill)(unsigned char* dst, unsigned char value, size_t n, unsigned int w);
+    //! dst[i] = src[i].
+    void (*copy)(unsigned char* dst, const unsigned char* src, size_t n);
+    //! dst[i] = (src[i]*a + dst[i]*(256-a) + 128) >> 8, with a = alpha[i] + (alpha[i] >> 7).
+    void (*composite)(unsigned char* dst, const unsigned char* src, const unsigned char* alpha, size_t n);
+    //! u[i], v[i] = BT.601 chroma of the mean of the pixels 2i and 2i+1 of the rows 0 and 1.
+    void (*rgbToChroma420)(const unsigned char* r0, const unsigned char* g0, const unsigned char* b0,
+                           const unsigned char* r1, const unsigned char* g1, const unsigned char* b1,
+                           unsigned char* u, unsigned char* v, size_t n);
+    //! returns the sum of x[0..n): 4 partial sums s[k] of the x[i] with i%4 == k over the first 4*(n/4) values,
+    //! combined as (s[0]+s[2]) + (s[1]+s[3]), then the remaining values in order.
+    double (*sum)(const double* x, size_t n);
+    //! returns the number of x[i] equal to \c value.
+    size_t (*countEqual)(const int* x, int value, size_t n);
+    //! returns the number of points (x0[i],y0[i]) mapped by the homography \c h (row-major 3x3) closer than
+    //! sqrt(threshold2) to (x1[i],y1[i]), setting inliers[i] to 1 for them and 0 for the others unless \c inliers is 0.
+    size_t (*transformInliers)(const float* x0, const float* y0, const float* x1, const float* y1, size_t n,
+                               const float* h, float threshold2, unsigned char* inliers);
+    //! writes to \c index the indices i of the x[i] not less than \c threshold, in increasing order, and returns their number.
+    size_t (*selectAbove)(const float* x, size_t n, float threshold, unsigned int* index);
+};
+
+//------------------------------------------
+//
+//! \name Scalar kernels
+//@{
+inline void rgbToGrayScalar(const unsigned char* r, const unsigned char* g, const unsigned char* b, unsigned char* y, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        y[i] = (unsigned char)(((66u*r[i] + 129u*g[i] + 25u*b[i] + 128u) >> 8) + 16u);
+    }
+}
+
+inline void blendScalar(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, size_t n, unsigned int w)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        dst[i] = (unsigned char)((src0[i]*w + src1[i]*(256u-w) + 128u) >> 8);
+    }
+}
+
+inline void fillScalar(unsigned char* dst, unsigned char value, size_t n, unsigned int w)
+{
+    const unsigned int c = value*w + 128u;
+    for(size_t i = 0; i < n; ++i)
+    {
+        dst[i] = (unsigned char)((dst[i]*(256u-w) + c) >> 8);
+    }
+}
+
+inline void copyScalar(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    std::memcpy(dst, src, n);
+}
+
+inline void compositeScalar(unsigned char* dst, const unsigned char* src, const unsigned char* alpha, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        const unsigned int a = alpha[i] + (alpha[i] >> 7);
+        dst[i] = (unsigned char)((src[i]*a + dst[i]*(256u-a) + 128u) >> 8);
+    }
+}
+
+// The chroma offset 128 is folded into the rounding constant, 128 + (128 << 8) = 32896,
+// so that the sums stay in [4336, 61456] and fit unsigned 16-bit lanes.
+inline void rgbToChroma420Scalar(const unsigned char* r0, const unsigned char* g0, const unsigned char* b0,
+                                 const unsigned char* r1, const unsigned char* g1, const unsigned char* b1,
+                                 unsigned char* u, unsigned char* v, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        const size_t j = 2*i;
+        const unsigned int r = (r0[j] + r0[j+1] + r1[j] + r1[j+1] + 2u) >> 2;
+        const unsigned int g = (g0[j] + g0[j+1] + g1[j] + g1[j+1] + 2u) >> 2;
+        const unsigned int b = (b0[j] + b0[j+1] + b1[j] + b1[j+1] + 2u) >> 2;
+        u[i] = (unsigned char)((112u*b + 32896u - 38u*r - 74u*g) >> 8);
+        v[i] = (unsigned char)((112u*r + 32896u - 94u*g - 18u*b) >> 8);
+    }
+}
+
+inline double sumScalar(const double* x, size_t n)
+{
+    double s[4] = {0, 0, 0, 0};
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        for(int k = 0; k < 4; ++k) s[k] += x[i+k];
+    }
+    double sum = (s[0] + s[2]) + (s[1] + s[3]);
+    for(; i < n; ++i) sum += x[i];
+    return sum;
+}
+
+inline size_t countEqualScalar(const int* x, int value, size_t n)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < n; ++i) count += x[i] == value;
+    return count;
+}
+
+// The SIMD variants evaluate the same expressions in the same order, without fused multiply-add,
+// and divide exactly, so they classify every point as the scalar kernel does.
+inline size_t transformInliersScalar(const float* x0, const float* y0, const float* x1, const float* y1, size_t n,
+                                     const float* h, float threshold2, unsigned char* inliers)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        const float w = (h[6]*x0[i] + h[7]*y0[i]) + h[8];
+        const float du = ((h[0]*x0[i] + h[1]*y0[i]) + h[2])/w - x1[i];
+        const float dv = ((h[3]*x0[i] + h[4]*y0[i]) + h[5])/w - y1[i];
+        const bool inlier = du*du + dv*dv < threshold2;
+        count += inlier;
+        if(inliers) inliers[i] = inlier;
+    }
+    return count;
+}
+
+inline size_t selectAboveScalar(const float* x, size_t n, float threshold, unsigned int* index)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < n; ++i)
+    { // branch-free: every index is written, only the selected ones are kept
+        index[count] = (unsigned int)i;
+        count += x[i] >= threshold;
+    }
+    return count;
+}
+//@}
+
+#ifdef CIMG_MATCHING_X86_DISPATCH
+// All intermediate values stay below 2^16, so the kernels work on unsigned 16-bit lanes.
+// unpacklo/unpackhi followed by packus keep the byte order within each 128-bit lane.
+
+//------------------------------------------
+//
+//! \name SSE2 kernels
+//@{
+__attribute__((target("sse2")))
+inline void rgbToGraySSE2(const unsigned char* r, const unsigned char* g, const unsigned char* b, unsigned char* y, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i kr = _mm_set1_epi16(66), kg = _mm_set1_epi16(129), kb = _mm_set1_epi16(25);
+    const __m128i k128 = _mm_set1_epi16(128), k16 = _mm_set1_epi16(16);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        const __m128i vr = _mm_loadu_si128((const __m128i*)(r+i));
+        const __m128i vg = _mm_loadu_si128((const __m128i*)(g+i));
+        const __m128i vb = _mm_loadu_si128((const __m128i*)(b+i));
+        __m128i lo = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(vr, zero), kr), _mm_mullo_epi16(_mm_unpacklo_epi8(vg, zero), kg)),
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), kb), k128));
+        __m128i hi = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(vr, zero), kr), _mm_mullo_epi16(_mm_unpackhi_epi8(vg, zero), kg)),
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), kb), k128));
+        lo = _mm_add_epi16(_mm_srli_epi16(lo, 8), k16);
+        hi = _mm_add_epi16(_mm_srli_epi16(hi, 8), k16);
+        _mm_storeu_si128((__m128i*)(y+i), _mm_packus_epi16(lo, hi));
+    }
+    rgbToGrayScalar(r+i, g+i, b+i, y+i, n-i);
+}
+
+__attribute__((target("sse2")))
+inline void blendSSE2(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, size_t n, unsigned int w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w0 = _mm_set1_epi16((short)w), w1 = _mm_set1_epi16((short)(256-w)), k128 = _mm_set1_epi16(128);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(src0+i));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(src1+i));
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), w0), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), w1)), k128);
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), w0), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), w1)), k128);
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    blendScalar(dst+i, src0+i, src1+i, n-i, w);
+}
+
+__attribute__((target("sse2")))
+inline void fillSSE2(unsigned char* dst, unsigned char value, size_t n, unsigned int w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i w1 = _mm_set1_epi16((short)(256-w)), c = _mm_set1_epi16((short)(value*w + 128u));
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        const __m128i d = _mm_loadu_si128((const __m128i*)(dst+i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), w1), c);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), w1), c);
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    fillScalar(dst+i, value, n-i, w);
+}
+
+__attribute__((target("sse2")))
+inline void copySSE2(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(src+i));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(src+i+16));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(src+i+32));
+        const __m128i d = _mm_loadu_si128((const __m128i*)(src+i+48));
+        _mm_storeu_si128((__m128i*)(dst+i), a);
+        _mm_storeu_si128((__m128i*)(dst+i+16), b);
+        _mm_storeu_si128((__m128i*)(dst+i+32), c);
+        _mm_storeu_si128((__m128i*)(dst+i+48), d);
+    }
+    copyScalar(dst+i, src+i, n-i);
+}
+
+__attribute__((target("sse2")))
+inline void compositeSSE2(unsigned char* dst, const unsigned char* src, const unsigned char* alpha, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k256 = _mm_set1_epi16(256), k128 = _mm_set1_epi16(128);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        const __m128i s = _mm_loadu_si128((const __m128i*)(src+i));
+        const __m128i d = _mm_loadu_si128((const __m128i*)(dst+i));
+        const __m128i a = _mm_loadu_si128((const __m128i*)(alpha+i));
+        __m128i alo = _mm_unpacklo_epi8(a, zero), ahi = _mm_unpackhi_epi8(a, zero);
+        alo = _mm_add_epi16(alo, _mm_srli_epi16(alo, 7));
+        ahi = _mm_add_epi16(ahi, _mm_srli_epi16(ahi, 7));
+        __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), alo), _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(k256, alo))), k128);
+        __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), ahi), _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(k256, ahi))), k128);
+        _mm_storeu_si128((__m128i*)(dst+i), _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    compositeScalar(dst+i, src+i, alpha+i, n-i);
+}
+
+//! returns the means of the 2x2 blocks of 16 pixels of the rows \c p0 and \c p1, in 16-bit lanes.
+__attribute__((target("sse2")))
+inline __m128i mean2x2SSE2(const unsigned char* p0, const unsigned char* p1)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff), k2 = _mm_set1_epi16(2);
+    const __m128i a = _mm_loadu_si128((const __m128i*)p0);
+    const __m128i b = _mm_loadu_si128((const __m128i*)p1);
+    const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+                                      _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+    return _mm_srli_epi16(_mm_add_epi16(sum, k2), 2);
+}
+
+__attribute__((target("sse2")))
+inline void rgbToChroma420SSE2(const unsigned char* r0, const unsigned char* g0, const unsigned char* b0,
+                               const unsigned char* r1, const unsigned char* g1, const unsigned char* b1,
+                               unsigned char* u, unsigned char* v, size_t n)
+{
+    const __m128i k112 = _mm_set1_epi16(112), k38 = _mm_set1_epi16(38), k74 = _mm_set1_epi16(74);
+    const __m128i k94 = _mm_set1_epi16(94), k18 = _mm_set1_epi16(18), offset = _mm_set1_epi16((short)32896);
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i vu[2], vv[2];
+        for(int h = 0; h < 2; ++h)
+        {
+            const size_t j = 2*i + 16*h;
+            const __m128i r = mean2x2SSE2(r0+j, r1+j), g = mean2x2SSE2(g0+j, g1+j), b = mean2x2SSE2(b0+j, b1+j);
+            vu[h] = _mm_srli_epi16(_mm_sub_epi16(_mm_add_epi16(_mm_mullo_epi16(b, k112), offset),
+                                                 _mm_add_epi16(_mm_mullo_epi16(r, k38), _mm_mullo_epi16(g, k74))), 8);
+            vv[h] = _mm_srli_epi16(_mm_sub_epi16(_mm_add_epi16(_mm_mullo_epi16(r, k112), offset),
+                                                 _mm_add_epi16(_mm_mullo_epi16(g, k94), _mm_mullo_epi16(b, k18))), 8);
+        }
+        _mm_storeu_si128((__m128i*)(u+i), _mm_packus_epi16(vu[0], vu[1]));
+        _mm_storeu_si128((__m128i*)(v+i), _mm_packus_epi16(vv[0], vv[1]));
+    }
+    rgbToChroma420Scalar(r0+2*i, g0+2*i, b0+2*i, r1+2*i, g1+2*i, b1+2*i, u+i, v+i, n-i);
+}
+
+// the partial sums 0 and 1 in lo, 2 and 3 in hi
+__attribute__((target("sse2")))
+inline double sumSSE2(const double* x, size_t n)
+{
+    __m128d lo = _mm_setzero_pd(), hi = _mm_setzero_pd();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        lo = _mm_add_pd(lo, _mm_loadu_pd(x+i));
+        hi = _mm_add_pd(hi, _mm_loadu_pd(x+i+2));
+    }
+    double s[2];
+    _mm_storeu_pd(s, _mm_add_pd(lo, hi));
+    double sum = s[0] + s[1];
+    for(; i < n; ++i) sum += x[i];
+    return sum;
+}
+
+// the lanes of the comparison are -1 where equal, subtracted from the 32-bit counts
+__attribute__((target("sse2")))
+inline size_t countEqualSSE2(const int* x, int value, size_t n)
+{
+    const __m128i v = _mm_set1_epi32(value);
+    __m128i counts = _mm_setzero_si128();
+    size_t i = 0, count = 0;
+    while(i + 4 <= n)
+    {
+        // flush the counts before they can overflow
+        const size_t end = std::min(n - n%4, i + ((size_t)1 << 30));
+        for(; i < end; i += 4) counts = _mm_sub_epi32(counts, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(x+i)), v));
+        unsigned int c[4];
+        _mm_storeu_si128((__m128i*)c, counts);
+        count += (size_t)c[0] + c[1] + c[2] + c[3];
+        counts = _mm_setzero_si128();
+    }
+    return count + countEqualScalar(x+i, value, n-i);
+}
+
+__attribute__((target("sse2")))
+inline size_t transformInliersSSE2(const float* x0, const float* y0, const float* x1, const float* y1, size_t n,
+                                   const float* h, float threshold2, unsigned char* inliers)
+{
+    __m128 k[9];
+    for(int j = 0; j < 9; ++j) k[j] = _mm_set1_ps(h[j]);
+    const __m128 t2 = _mm_set1_ps(threshold2);
+    size_t i = 0, count = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(x0+i), y = _mm_loadu_ps(y0+i);
+        const __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(k[6], x), _mm_mul_ps(k[7], y)), k[8]);
+        const __m128 du = _mm_sub_ps(_mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(k[0], x), _mm_mul_ps(k[1], y)), k[2]), w), _mm_loadu_ps(x1+i));
+        const __m128 dv = _mm_sub_ps(_mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(k[3], x), _mm_mul_ps(k[4], y)), k[5]), w), _mm_loadu_ps(y1+i));
+        const int mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(du, du), _mm_mul_ps(dv, dv)), t2));
+        count += __builtin_popcount(mask);
+        if(inliers)
+        {
+            for(int j = 0; j < 4; ++j) inliers[i+j] = (unsigned char)((mask >> j) & 1);
+        }
+    }
+    return count + transformInliersScalar(x0+i, y0+i, x1+i, y1+i, n-i, h, threshold2, inliers ? inliers+i : 0);
+}
+
+// the comparison mask is scanned bit by bit, so a block of weights all below the threshold costs one test
+__attribute__((target("sse2")))
+inline size_t selectAboveSSE2(const float* x, size_t n, float threshold, unsigned int* index)
+{
+    const __m128 t = _mm_set1_ps(threshold);
+    size_t i = 0, count = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        for(int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(x+i), t)); mask != 0; mask &= mask-1)
+        {
+            index[count++] = (unsigned int)(i + __builtin_ctz(mask));
+        }
+    }
+    const size_t rest = selectAboveScalar(x+i, n-i, threshold, index+count);
+    for(size_t k = count; k < count+rest; ++k) index[k] += (unsigned int)i;
+    return count + rest;
+}
+//@}
+
+//------------------------------------------
+//
+//! \name AVX2 kernels
+//@{
+__attribute__((target("avx2")))
+inline void rgbToGrayAVX2(const unsigned char* r, const unsigned char* g, const unsigned char* b, unsigned char* y, size_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i kr = _mm256_set1_epi16(66), kg = _mm256_set1_epi16(129), kb = _mm256_set1_epi16(25);
+    const __m256i k128 = _mm256_set1_epi16(128), k16 = _mm256_set1_epi16(16);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        const __m256i vr = _mm256_loadu_si256((const __m256i*)(r+i));
+        const __m256i vg = _mm256_loadu_si256((const __m256i*)(g+i));
+        const __m256i vb = _mm256_loadu_si256((const __m256i*)(b+i));
+        __m256i lo = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(vr, zero), kr), _mm256_mullo_epi16(_mm256_unpacklo_epi8(vg, zero), kg)),
+            _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), kb), k128));
+        __m256i hi = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(vr, zero), kr), _mm256_mullo_epi16(_mm256_unpackhi_epi8(vg, zero), kg)),
+            _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), kb), k128));
+        lo = _mm256_add_epi16(_mm256_srli_epi16(lo, 8), k16);
+        hi = _mm256_add_epi16(_mm256_srli_epi16(hi, 8), k16);
+        _mm256_storeu_si256((__m256i*)(y+i), _mm256_packus_epi16(lo, hi));
+    }
+    rgbToGraySSE2(r+i, g+i, b+i, y+i, n-i);
+}
+
+__attribute__((target("avx2")))
+inline void blendAVX2(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, size_t n, unsigned int w)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i w0 = _mm256_set1_epi16((short)w), w1 = _mm256_set1_epi16((short)(256-w)), k128 = _mm256_set1_epi16(128);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(src0+i));
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(src1+i));
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), w0), _mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), w1)), k128);
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), w0), _mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), w1)), k128);
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    blendSSE2(dst+i, src0+i, src1+i, n-i, w);
+}
+
+__attribute__((target("avx2")))
+inline void fillAVX2(unsigned char* dst, unsigned char value, size_t n, unsigned int w)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i w1 = _mm256_set1_epi16((short)(256-w)), c = _mm256_set1_epi16((short)(value*w + 128u));
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        const __m256i d = _mm256_loadu_si256((const __m256i*)(dst+i));
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), w1), c);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), w1), c);
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    fillSSE2(dst+i, value, n-i, w);
+}
+
+__attribute__((target("avx2")))
+inline void copyAVX2(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 128 <= n; i += 128)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(src+i));
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(src+i+32));
+        const __m256i c = _mm256_loadu_si256((const __m256i*)(src+i+64));
+        const __m256i d = _mm256_loadu_si256((const __m256i*)(src+i+96));
+        _mm256_storeu_si256((__m256i*)(dst+i), a);
+        _mm256_storeu_si256((__m256i*)(dst+i+32), b);
+        _mm256_storeu_si256((__m256i*)(dst+i+64), c);
+        _mm256_storeu_si256((__m256i*)(dst+i+96), d);
+    }
+    copySSE2(dst+i, src+i, n-i);
+}
+
+__attribute__((target("avx2")))
+inline void compositeAVX2(unsigned char* dst, const unsigned char* src, const unsigned char* alpha, size_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i k256 = _mm256_set1_epi16(256), k128 = _mm256_set1_epi16(128);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(src+i));
+        const __m256i d = _mm256_loadu_si256((const __m256i*)(dst+i));
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(alpha+i));
+        __m256i alo = _mm256_unpacklo_epi8(a, zero), ahi = _mm256_unpackhi_epi8(a, zero);
+        alo = _mm256_add_epi16(alo, _mm256_srli_epi16(alo, 7));
+        ahi = _mm256_add_epi16(ahi, _mm256_srli_epi16(ahi, 7));
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), alo), _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero), _mm256_sub_epi16(k256, alo))), k128);
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), ahi), _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero), _mm256_sub_epi16(k256, ahi))), k128);
+        _mm256_storeu_si256((__m256i*)(dst+i), _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    compositeSSE2(dst+i, src+i, alpha+i, n-i);
+}
+
+//! returns the means of the 2x2 blocks of 32 pixels of the rows \c p0 and \c p1, in 16-bit lanes.
+__attribute__((target("avx2")))
+inline __m256i mean2x2AVX2(const unsigned char* p0, const unsigned char* p1)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff), k2 = _mm256_set1_epi16(2);
+    const __m256i a = _mm256_loadu_si256((const __m256i*)p0);
+    const __m256i b = _mm256_loadu_si256((const __m256i*)p1);
+    const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, mask), _mm256_srli_epi16(a, 8)),
+                                         _mm256_add_epi16(_mm256_and_si256(b, mask), _mm256_srli_epi16(b, 8)));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, k2), 2);
+}
+
+// packus interleaves the 128-bit lanes of its operands; the permutation restores the pixel order.
+__attribute__((target("avx2")))
+inline void rgbToChroma420AVX2(const unsigned char* r0, const unsigned char* g0, const unsigned char* b0,
+                               const unsigned char* r1, const unsigned char* g1, const unsigned char* b1,
+                               unsigned char* u, unsigned char* v, size_t n)
+{
+    const __m256i k112 = _mm256_set1_epi16(112), k38 = _mm256_set1_epi16(38), k74 = _mm256_set1_epi16(74);
+    const __m256i k94 = _mm256_set1_epi16(94), k18 = _mm256_set1_epi16(18), offset = _mm256_set1_epi16((short)32896);
+    size_t i = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i vu[2], vv[2];
+        for(int h = 0; h < 2; ++h)
+        {
+            const size_t j = 2*i + 32*h;
+            const __m256i r = mean2x2AVX2(r0+j, r1+j), g = mean2x2AVX2(g0+j, g1+j), b = mean2x2AVX2(b0+j, b1+j);
+            vu[h] = _mm256_srli_epi16(_mm256_sub_epi16(_mm256_add_epi16(_mm256_mullo_epi16(b, k112), offset),
+                                                       _mm256_add_epi16(_mm256_mullo_epi16(r, k38), _mm256_mullo_epi16(g, k74))), 8);
+            vv[h] = _mm256_srli_epi16(_mm256_sub_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, k112), offset),
+                                                       _mm256_add_epi16(_mm256_mullo_epi16(g, k94), _mm256_mullo_epi16(b, k18))), 8);
+        }
+        _mm256_storeu_si256((__m256i*)(u+i), _mm256_permute4x64_epi64(_mm256_packus_epi16(vu[0], vu[1]), 0xd8));
+        _mm256_storeu_si256((__m256i*)(v+i), _mm256_permute4x64_epi64(_mm256_packus_epi16(vv[0], vv[1]), 0xd8));
+    }
+    rgbToChroma420SSE2(r0+2*i, g0+2*i, b0+2*i, r1+2*i, g1+2*i, b1+2*i, u+i, v+i, n-i);
+}
+
+__attribute__((target("avx2")))
+inline double sumAVX2(const double* x, size_t n)
+{
+    __m256d acc = _mm256_setzero_pd();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) acc = _mm256_add_pd(acc, _mm256_loadu_pd(x+i));
+    double s[2];
+    _mm_storeu_pd(s, _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1)));
+    double sum = s[0] + s[1];
+    for(; i < n; ++i) sum += x[i];
+    return sum;
+}
+
+__attribute__((target("avx2")))
+inline size_t countEqualAVX2(const int* x, int value, size_t n)
+{
+    const __m256i v = _mm256_set1_epi32(value);
+    __m256i counts = _mm256_setzero_si256();
+    size_t i = 0, count = 0;
+    while(i + 8 <= n)
+    {
+        const size_t end = std::min(n - n%8, i + ((size_t)1 << 31));
+        for(; i < end; i += 8) counts = _mm256_sub_epi32(counts, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(x+i)), v));
+        unsigned int c[8];
+        _mm256_storeu_si256((__m256i*)c, counts);
+        for(int k = 0; k < 8; ++k) count += c[k];
+        counts = _mm256_setzero_si256();
+    }
+    return count + countEqualSSE2(x+i, value, n-i);
+}
+
+__attribute__((target("avx2")))
+inline size_t transformInliersAVX2(const float* x0, const float* y0, const float* x1, const float* y1, size_t n,
+                                   const float* h, float threshold2, unsigned char* inliers)
+{
+    __m256 k[9];
+    for(int j = 0; j < 9; ++j) k[j] = _mm256_set1_ps(h[j]);
+    const __m256 t2 = _mm256_set1_ps(threshold2);
+    size_t i = 0, count = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(x0+i), y = _mm256_loadu_ps(y0+i);
+        const __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(k[6], x), _mm256_mul_ps(k[7], y)), k[8]);
+        const __m256 du = _mm256_sub_ps(_mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(k[0], x), _mm256_mul_ps(k[1], y)), k[2]), w), _mm256_loadu_ps(x1+i));
+        const __m256 dv = _mm256_sub_ps(_mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(k[3], x), _mm256_mul_ps(k[4], y)), k[5]), w), _mm256_loadu_ps(y1+i));
+        const int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(du, du), _mm256_mul_ps(dv, dv)), t2, _CMP_LT_OQ));
+        count += __builtin_popcount(mask);
+        if(inliers)
+        {
+            for(int j = 0; j < 8; ++j) inliers[i+j] = (unsigned char)((mask >> j) & 1);
+        }
+    }
+    return count + transformInliersSSE2(x0+i, y0+i, x1+i, y1+i, n-i, h, threshold2, inliers ? inliers+i : 0);
+}
+
+__attribute__((target("avx2")))
+inline size_t selectAboveAVX2(const float* x, size_t n, float threshold, unsigned int* index)
+{
+    const __m256 t = _mm256_set1_ps(threshold);
+    size_t i = 0, count = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        for(int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(x+i), t, _CMP_GE_OQ)); mask != 0; mask &= mask-1)
+        {
+            index[count++] = (unsigned int)(i + __builtin_ctz(mask));
+        }
+    }
+    const size_t rest = selectAboveSSE2(x+i, n-i, threshold, index+count);
+    for(size_t k = count; k < count+rest; ++k) index[k] += (unsigned int)i;
+    return count + rest;
+}
+//@}
+
+//------------------------------------------
+//
+//! \name AVX-512 kernels (AVX512F + AVX512BW)
+//! The 4:2:0 chroma kernel and the reductions, bound by their loads, use the AVX2 ones;
+//! a wider sum would also add the energies in another order.
+//@{
+__attribute__((target("avx512f,avx512bw")))
+inline void rgbToGrayAVX512(const unsigned char* r, const unsigned char* g, const unsigned char* b, unsigned char* y, size_t n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i kr = _mm512_set1_epi16(66), kg = _mm512_set1_epi16(129), kb = _mm512_set1_epi16(25);
+    const __m512i k128 = _mm512_set1_epi16(128), k16 = _mm512_set1_epi16(16);
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        const __m512i vr = _mm512_loadu_si512((const void*)(r+i));
+        const __m512i vg = _mm512_loadu_si512((const void*)(g+i));
+        const __m512i vb = _mm512_loadu_si512((const void*)(b+i));
+        __m512i lo = _mm512_add_epi16(
+            _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(vr, zero), kr), _mm512_mullo_epi16(_mm512_unpacklo_epi8(vg, zero), kg)),
+            _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(vb, zero), kb), k128));
+        __m512i hi = _mm512_add_epi16(
+            _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(vr, zero), kr), _mm512_mullo_epi16(_mm512_unpackhi_epi8(vg, zero), kg)),
+            _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(vb, zero), kb), k128));
+        lo = _mm512_add_epi16(_mm512_srli_epi16(lo, 8), k16);
+        hi = _mm512_add_epi16(_mm512_srli_epi16(hi, 8), k16);
+        _mm512_storeu_si512((void*)(y+i), _mm512_packus_epi16(lo, hi));
+    }
+    rgbToGrayAVX2(r+i, g+i, b+i, y+i, n-i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void blendAVX512(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, size_t n, unsigned int w)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i w0 = _mm512_set1_epi16((short)w), w1 = _mm512_set1_epi16((short)(256-w)), k128 = _mm512_set1_epi16(128);
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        const __m512i a = _mm512_loadu_si512((const void*)(src0+i));
+        const __m512i b = _mm512_loadu_si512((const void*)(src1+i));
+        __m512i lo = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(a, zero), w0), _mm512_mullo_epi16(_mm512_unpacklo_epi8(b, zero), w1)), k128);
+        __m512i hi = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(a, zero), w0), _mm512_mullo_epi16(_mm512_unpackhi_epi8(b, zero), w1)), k128);
+        _mm512_storeu_si512((void*)(dst+i), _mm512_packus_epi16(_mm512_srli_epi16(lo, 8), _mm512_srli_epi16(hi, 8)));
+    }
+    blendAVX2(dst+i, src0+i, src1+i, n-i, w);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void fillAVX512(unsigned char* dst, unsigned char value, size_t n, unsigned int w)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i w1 = _mm512_set1_epi16((short)(256-w)), c = _mm512_set1_epi16((short)(value*w + 128u));
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        const __m512i d = _mm512_loadu_si512((const void*)(dst+i));
+        __m512i lo = _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(d, zero), w1), c);
+        __m512i hi = _mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(d, zero), w1), c);
+        _mm512_storeu_si512((void*)(dst+i), _mm512_packus_epi16(_mm512_srli_epi16(lo, 8), _mm512_srli_epi16(hi, 8)));
+    }
+    fillAVX2(dst+i, value, n-i, w);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void copyAVX512(unsigned char* dst, const unsigned char* src, size_t n)
+{
+    size_t i = 0;
+    for(; i + 256 <= n; i += 256)
+    {
+        const __m512i a = _mm512_loadu_si512((const void*)(src+i));
+        const __m512i b = _mm512_loadu_si512((const void*)(src+i+64));
+        const __m512i c = _mm512_loadu_si512((const void*)(src+i+128));
+        const __m512i d = _mm512_loadu_si512((const void*)(src+i+192));
+        _mm512_storeu_si512((void*)(dst+i), a);
+        _mm512_storeu_si512((void*)(dst+i+64), b);
+        _mm512_storeu_si512((void*)(dst+i+128), c);
+        _mm512_storeu_si512((void*)(dst+i+192), d);
+    }
+    copyAVX2(dst+i, src+i, n-i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void compositeAVX512(unsigned char* dst, const unsigned char* src, const unsigned char* alpha, size_t n)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i k256 = _mm512_set1_epi16(256), k128 = _mm512_set1_epi16(128);
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        const __m512i s = _mm512_loadu_si512((const void*)(src+i));
+        const __m512i d = _mm512_loadu_si512((const void*)(dst+i));
+        const __m512i a = _mm512_loadu_si512((const void*)(alpha+i));
+        __m512i alo = _mm512_unpacklo_epi8(a, zero), ahi = _mm512_unpackhi_epi8(a, zero);
+        alo = _mm512_add_epi16(alo, _mm512_srli_epi16(alo, 7));
+        ahi = _mm512_add_epi16(ahi, _mm512_srli_epi16(ahi, 7));
+        __m512i lo = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpacklo_epi8(s, zero), alo), _mm512_mullo_epi16(_mm512_unpacklo_epi8(d, zero), _mm512_sub_epi16(k256, alo))), k128);
+        __m512i hi = _mm512_add_epi16(_mm512_add_epi16(_mm512_mullo_epi16(_mm512_unpackhi_epi8(s, zero), ahi), _mm512_mullo_epi16(_mm512_unpackhi_epi8(d, zero), _mm512_sub_epi16(k256, ahi))), k128);
+        _mm512_storeu_si512((void*)(dst+i), _mm512_packus_epi16(_mm512_srli_epi16(lo, 8), _mm512_srli_epi16(hi, 8)));
+    }
+    compositeAVX2(dst+i, src+i, alpha+i, n-i);
+}
+//@}
+#endif
+
+//! returns the highest SIMD level supported by the running CPU.
+inline SimdLevel simdLevelSupported(void)
+{
+#ifdef CIMG_MATCHING_X86_DISPATCH
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SIMD_AVX512;
+    if(__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+    if(__builtin_cpu_supports("sse2")) return SIMD_SSE2;
+#endif
+    return SIMD_SCALAR;
+}
+
+///
+/// \brief pixelKernels
+/// returns the kernels compiled for \c level.
+/// Levels above \c simdLevelSupported() must not be requested.
+inline const PixelKernelTable& pixelKernels(const SimdLevel level)
+{
+    static const PixelKernelTable tables[SIMD_LEVELS] = {
+        {SIMD_SCALAR, rgbToGrayScalar, blendScalar, fillScalar, copyScalar, compositeScalar, rgbToChroma420Scalar, sumScalar, countEqualScalar, transformInliersScalar, selectAboveScalar},
+#ifdef CIMG_MATCHING_X86_DISPATCH
+        {SIMD_SSE2, rgbToGraySSE2, blendSSE2, fillSSE2, copySSE2, compositeSSE2, rgbToChroma420SSE2, sumSSE2, countEqualSSE2, transformInliersSSE2, selectAboveSSE2},
+        {SIMD_AVX2, rgbToGrayAVX2, blendAVX2, fillAVX2, copyAVX2, compositeAVX2, rgbToChroma420AVX2, sumAVX2, countEqualAVX2, transformInliersAVX2, selectAboveAVX2},
+        {SIMD_AVX512, rgbToGrayAVX512, blendAVX512, fillAVX512, copyAVX512, compositeAVX512, rgbToChroma420AVX2, sumAVX2, countEqualAVX2, transformInliersAVX2, selectAboveAVX2}
+#else
+        {SIMD_SCALAR, rgbToGrayScalar, blendScalar, fillScalar, copyScalar, compositeScalar, rgbToChroma420Scalar, sumScalar, countEqualScalar, transformInliersScalar, selectAboveScalar},
+        {SIMD_SCALAR, rgbToGrayScalar, blendScalar, fillScalar, copyScalar, compositeScalar, rgbToChroma420Scalar, sumScalar, countEqualScalar, transformInliersScalar, selectAboveScalar},
+        {SIMD_SCALAR, rgbToGrayScalar, blendScalar, fillScalar, copyScalar, compositeScalar, rgbToChroma420Scalar, sumScalar, countEqualScalar, transformInliersScalar, selectAboveScalar}
+#endif
+    };
+    return tables[level];
+}
+
+///
+/// \brief simdLevel
+/// returns the SIMD level selected at startup: the highest supported one,
+/// lowered by the environment variable \c CIMG_MATCHING_SIMD if set.
+inline SimdLevel simdLevel(void)
+{
+    static const SimdLevel level = []() -> SimdLevel {
+        SimdLevel supported = simdLevelSupported();
+        const char* env = std::getenv("CIMG_MATCHING_SIMD");
+        if(env)
+        {
+            for(int l = 0; l < SIMD_LEVELS; ++l)
+            {
+                if(std::string(env) == simdLevelName((SimdLevel)l))
+                {
+                    return (SimdLevel)l < supported ? (SimdLevel)l : supported;
+                }
+            }
+        }
+        return supported;
+    }();
+    return level;
+}
+
+//! returns the kernels of the SIMD level selected at startup.
+inline const PixelKernelTable& pixelKernels(void)
+{
+    static const PixelKernelTable& kernels = pixelKernels(simdLevel());
+    return kernels;
+}
+
+///
+/// \brief pixelKernelsVerify
+/// compares the kernels of \c level with the scalar ones on pseudo-random buffers
+/// of various lengths and alignments, and returns true if they agree bit by bit.
+inline bool pixelKernelsVerify(const SimdLevel level)
+{
+    const PixelKernelTable& ref = pixelKernels(SIMD_SCALAR);
+    const PixelKernelTable& test = pixelKernels(level);
+    const size_t sizeMax = 1100;
+    std::string buf(7*(sizeMax+8), '\0');
+    unsigned int seed = 12345u;
+    for(size_t i = 0; i < buf.size(); ++i)
+    {
+        seed = seed*1103515245u + 12345u;
+        buf[i] = (char)(seed >> 16);
+    }
+    const unsigned char* src = (const unsigned char*)buf.data();
+    std::string out0(sizeMax+8, '\0'), out1(sizeMax+8, '\0');
+    unsigned char* d0 = (unsigned char*)&out0[0];
+    unsigned char* d1 = (unsigned char*)&out1[0];
+    const unsigned int weights[] = {0, 1, 77, 128, 255, 256};
+    for(size_t n = 0; n <= sizeMax; n = n < 80 ? n+1 : n*3/2+7)
+    {
+        for(size_t o = 0; o < 3; ++o)
+        {
+            const unsigned char *a = src+o, *b = src+(sizeMax+8)+o, *c = src+2*(sizeMax+8)+o, *s = src+3*(sizeMax+8);
+            ref.rgbToGray(a, b, c, d0+o, n);
+            test.rgbToGray(a, b, c, d1+o, n);
+            if(std::memcmp(d0+o, d1+o, n)) return false;
+            for(size_t k = 0; k < sizeof(weights)/sizeof(weights[0]); ++k)
+            {
+                ref.blend(d0+o, a, b, n, weights[k]);
+                test.blend(d1+o, a, b, n, weights[k]);
+                if(std::memcmp(d0+o, d1+o, n)) return false;
+                std::memcpy(d0+o, s, n);
+                std::memcpy(d1+o, s, n);
+                ref.fill(d0+o, c[k], n, weights[k]);
+                test.fill(d1+o, c[k], n, weights[k]);
+                if(std::memcmp(d0+o, d1+o, n)) return false;
+            }
+            ref.copy(d0+o, c, n);
+            test.copy(d1+o, c, n);
+            if(std::memcmp(d0+o, d1+o, n)) return false;
+            ref.composite(d0+o, a, b, n);
+            test.composite(d1+o, a, b, n);
+            if(std::memcmp(d0+o, d1+o, n)) return false;
+            // the chroma of n/2 blocks, u in the first half of the output and v in the second
+            const unsigned char *e = src+4*(sizeMax+8)+o, *f = src+5*(sizeMax+8)+o, *g = src+6*(sizeMax+8)+o;
+            ref.rgbToChroma420(a, b, c, e, f, g, d0+o, d0+o+n/2, n/2);
+            test.rgbToChroma420(a, b, c, e, f, g, d1+o, d1+o+n/2, n/2);
+            if(std::memcmp(d0+o, d1+o, 2*(n/2))) return false;
+            // the reductions, on doubles of random magnitudes and on labels in [-1,1]
+            std::vector<double> x(n+o);
+            std::vector<int> labels(n+o);
+            for(size_t i = 0; i < n+o; ++i)
+            {
+                x[i] = ((int)a[i] - 128)*std::ldexp(1.0, (int)(b[i] % 40) - 20);
+                labels[i] = (int)(c[i] % 3) - 1;
+            }
+            if(ref.sum(x.data()+o, n) != test.sum(x.data()+o, n)) return false;
+            for(int value = -1; value <= 1; ++value)
+            {
+                if(ref.countEqual(labels.data()+o, value, n) != test.countEqual(labels.data()+o, value, n)) return false;
+            }
+            // the inliers of a homography, on points near their images
+            std::vector<float> p[4];
+            for(int k = 0; k < 4; ++k) p[k].resize(n+o);
+            const float h[9] = {1.02f, 0.03f, 5.5f, -0.02f, 0.97f, -3.25f, 1e-5f, -2e-5f, 1.0f};
+            for(size_t i = 0; i < n+o; ++i)
+            {
+                p[0][i] = 4.0f*a[i];
+                p[1][i] = 3.0f*b[i];
+                const float w = (h[6]*p[0][i] + h[7]*p[1][i]) + h[8];
+                p[2][i] = ((h[0]*p[0][i] + h[1]*p[1][i]) + h[2])/w + (c[i] % 16)*0.25f - 2.0f;
+                p[3][i] = ((h[3]*p[0][i] + h[4]*p[1][i]) + h[5])/w + (e[i] % 16)*0.25f - 2.0f;
+            }
+            std::vector<unsigned char> in0(n+o), in1(n+o);
+            if(ref.transformInliers(p[0].data()+o, p[1].data()+o, p[2].data()+o, p[3].data()+o, n, h, 2.25f, in0.data()+o) !=
+               test.transformInliers(p[0].data()+o, p[1].data()+o, p[2].data()+o, p[3].data()+o, n, h, 2.25f, in1.data()+o)) return false;
+            if(n > 0 && std::memcmp(in0.data()+o, in1.data()+o, n)) return false;
+            // the weights above a threshold, some of them not numbers
+            std::vector<float> weights(n+o);
+            for(size_t i = 0; i < n+o; ++i) weights[i] = b[i] == 255 ? std::nanf("") : a[i]/255.0f;
+            std::vector<unsigned int> sel0(n+o), sel1(n+o);
+            for(int t = 0; t <= 256; t += 64)
+            {
+                const size_t count = ref.selectAbove(weights.data()+o, n, t/256.0f, sel0.data());
+                if(test.selectAbove(weights.data()+o, n, t/256.0f, sel1.data()) != count) return false;
+                if(!std::equal(sel0.begin(), sel0.begin()+count, sel1.begin())) return false;
+            }
+        }
+    }
+    return true;
+}
+
+#endif
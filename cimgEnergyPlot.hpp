@@ -0,0 +1,263 @@
+#ifndef cimgEnergyPlot
+#define cimgEnergyPlot
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <CImg.h>
+
+//! An iteration of the energy plot.
+struct EnergyPlotSample
+{
+    double energy[3];       //!< The energy sums of the series.
+    int numFlips;           //!< The number of correspondences taken from the proposal, -1 if not plotted.
+    int numCorrespondences;
+};
+
+///
+/// \brief The EnergyPlot class
+/// plots the energy sums of the last \c capacity iterations, one column per iteration, the newest on the right:
+/// one series (black), or the current (red), proposed (blue) and fused (green) energies of the move-making;
+/// below them the number of flips, as a bar relative to the number of correspondences; and optionally the
+/// histogram of the energies of each iteration, as a column of gray levels, the lowest energies at the bottom.
+///
+/// The iterations are kept in a ring buffer, and so are the columns of the plot: appending one draws its column
+/// only, over the oldest one, and the two halves of the ring are put in order when the plot is asked for.
+/// The whole plot is redrawn from the ring buffer only when a sum leaves the vertical range, whose span then
+/// doubles, so a run redraws it a few times at most.
+class EnergyPlot
+{
+public:
+    //! Default constructor
+    explicit EnergyPlot(
+        const int capacity = 400,
+        const int height = 160,
+        const int histogramBins = 0
+    ):
+        _capacity(std::max(capacity, 2)),
+        _height(std::max(height, 16)),
+        _heightFlips(32),
+        _bins(std::max(histogramBins, 0)),
+        _samples(_capacity),
+        _histograms((size_t)_capacity*_bins),
+        _numSeries(0),
+        _lo(0),
+        _hi(0),
+        _histogramLo(0),
+        _histogramHi(1),
+        _numRedraws(0)
+    {
+        clear();
+    }
+
+    //! removes the iterations.
+    void clear(void)
+    {
+        _first = 0;
+        _size = 0;
+        _numIterations = 0;
+        _lo = _hi = 0;
+        _ring.assign(_capacity, _height + 1 + _heightFlips + (_bins > 0 ? 1 + _bins : 0), 1, 3).fill(255);
+        drawSeparators(0, _capacity-1);
+        _flagComposed = false;
+    }
+
+    //! sets the energies covered by the histogram; the values outside fall in the first or last bin.
+    void histogramRange(const double lo, const double hi)
+    {
+        _histogramLo = lo;
+        _histogramHi = hi > lo ? hi : lo + 1;
+    }
+
+    ///
+    /// \brief push
+    /// appends an iteration: the \c numSeries energy sums \c energy (at most 3), the number \c numFlips of
+    /// correspondences flipped, -1 for none, out of \c numCorrespondences, and the \c numValues energies
+    /// \c values of the histogram.
+    void push(
+        const double* energy,
+        const int numSeries,
+        const int numFlips,
+        const int numCorrespondences,
+        const double* values = 0,
+        const size_t numValues = 0
+    )
+    {
+        EnergyPlotSample sample;
+        const int n = std::min(std::max(numSeries, 1), 3);
+        for(int s = 0; s < 3; ++s) sample.energy[s] = s < n ? energy[s] : 0;
+        sample.numFlips = numFlips;
+        sample.numCorrespondences = numCorrespondences;
+
+        bool flagRedraw = n != _numSeries;
+        _numSeries = n;
+        for(int s = 0; s < n; ++s) flagRedraw |= include(sample.energy[s]);
+
+        const int slot = (_first + _size) % _capacity;
+        if(_size < _capacity) ++_size;
+        else _first = (_first + 1) % _capacity;
+        _samples[slot] = sample;
+        ++_numIterations;
+        if(_bins > 0) histogram(values, numValues, &_histograms[(size_t)slot*_bins]);
+
+        if(flagRedraw) redraw();
+        else drawColumn(slot, _size-1);
+        _flagComposed = false;
+    }
+
+    //! returns the plot, the oldest iteration on the left.
+    const cimg_library::CImg<unsigned char>& image(void) const
+    {
+        if(!_flagComposed) compose();
+        return _image;
+    }
+    //! returns the number of iterations held, at most the capacity.
+    int size(void) const {return _size;}
+    //! returns the iteration \c i held, 0 the oldest.
+    const EnergyPlotSample& sample(const int i) const {return _samples[(_first + i) % _capacity];}
+    //! returns the number of iterations appended since \c clear.
+    long long numberOfIterations(void) const {return _numIterations;}
+    //! returns the number of times the whole plot was redrawn.
+    long long numberOfRedraws(void) const {return _numRedraws;}
+    //! returns the energies at the bottom and the top of the plot.
+    double lo(void) const {return _lo;}
+    double hi(void) const {return _hi;}
+
+private:
+    //! extends the vertical range to \c v; returns true if it changed.
+    bool include(const double v)
+    {
+        if(!std::isfinite(v)) return false;
+        if(_size == 0 && _lo == _hi)
+        { // the first iteration sets the range, with room above
+            _lo = std::min(0.0, v);
+            _hi = std::max(_lo + std::fabs(v)*1.25, _lo + 1e-9);
+            return true;
+        }
+        if(v >= _lo && v <= _hi) return false;
+        while(v > _hi) _hi = _lo + 2*(_hi - _lo);
+        while(v < _lo) _lo = _hi - 2*(_hi - _lo);
+        return true;
+    }
+
+    //! returns the row of the energy \c v.
+    int row(const double v) const
+    {
+        const double t = std::isfinite(v) ? (v - _lo)/(_hi - _lo) : 0;
+        return _height-1 - (int)(std::min(std::max(t, 0.0), 1.0)*(_height-1) + 0.5);
+    }
+
+    //! computes the gray levels of the histogram of \c values into \c column, 255 for an empty bin, 0 for the fullest.
+    void histogram(const double* values, const size_t numValues, unsigned char* column) const
+    {
+        std::vector<int> counts(_bins, 0);
+        const double scale = _bins/(_histogramHi - _histogramLo);
+        for(size_t i = 0; i < numValues; ++i)
+        {
+            const double t = (values[i] - _histogramLo)*scale;
+            const int b = t <= 0 || !(t == t) ? 0 : t >= _bins ? _bins-1 : (int)t;
+            ++counts[b];
+        }
+        const int maxCount = std::max(*std::max_element(counts.begin(), counts.end()), 1);
+        for(int b = 0; b < _bins; ++b) column[b] = (unsigned char)(255 - (255*counts[b])/maxCount);
+    }
+
+    //! puts the columns of the ring in order into \c _image: the slot written next, the oldest, comes first.
+    void compose(void) const
+    {
+        const int next = (_first + _size) % _capacity;
+        _image.assign(_ring.width(), _ring.height(), 1, 3);
+        for(int c = 0; c < 3; ++c)
+        {
+            for(int y = 0; y < _ring.height(); ++y)
+            {
+                const unsigned char* src = _ring.data(0, y, 0, c);
+                unsigned char* dst = _image.data(0, y, 0, c);
+                std::memcpy(dst, src + next, _capacity - next);
+                std::memcpy(dst + _capacity - next, src, next);
+            }
+        }
+        _flagComposed = true;
+    }
+
+    void pixel(const int x, const int y, const unsigned char r, const unsigned char g, const unsigned char b)
+    {
+        const size_t plane = (size_t)_ring.width()*_ring.height();
+        unsigned char* p = _ring.data(x, y);
+        p[0] = r;
+        p[plane] = g;
+        p[2*plane] = b;
+    }
+
+    //! draws the separators between the plot and the strips, in the columns \c x0 to \c x1.
+    void drawSeparators(const int x0, const int x1)
+    {
+        for(int x = x0; x <= x1; ++x)
+        {
+            pixel(x, _height, 160, 160, 160);
+            if(_bins > 0) pixel(x, _height + 1 + _heightFlips, 160, 160, 160);
+        }
+    }
+
+    //! draws the iteration \c i held in the column \c x of the ring, joined to the iteration before.
+    void drawColumn(const int x, const int i)
+    {
+        static const unsigned char colors[4][3] = {{0, 0, 0}, {255, 0, 0}, {0, 0, 255}, {0, 160, 0}};
+        for(int y = 0; y < _ring.height(); ++y) pixel(x, y, 255, 255, 255);
+        drawSeparators(x, x);
+
+        const EnergyPlotSample& cur = sample(i);
+        for(int s = 0; s < _numSeries; ++s)
+        { // a vertical span from the row of the previous iteration, excluded, to the row of this one
+            const unsigned char* color = colors[_numSeries == 1 ? 0 : s+1];
+            const int y = row(cur.energy[s]);
+            const int yPrev = i > 0 ? row(sample(i-1).energy[s]) : y;
+            const int y0 = yPrev < y ? yPrev+1 : y, y1 = yPrev > y ? yPrev-1 : y;
+            for(int yy = y0; yy <= y1; ++yy) pixel(x, yy, color[0], color[1], color[2]);
+        }
+
+        if(cur.numFlips >= 0 && cur.numCorrespondences > 0)
+        {
+            const int bar = (int)((double)_heightFlips*std::min(cur.numFlips, cur.numCorrespondences)/cur.numCorrespondences + 0.5);
+            for(int k = 0; k < bar; ++k) pixel(x, _height + _heightFlips - k, 90, 90, 90);
+        }
+
+        if(_bins > 0)
+        {
+            const unsigned char* column = &_histograms[(size_t)((_first + i) % _capacity)*_bins];
+            const int yBottom = _ring.height()-1;
+            for(int b = 0; b < _bins; ++b) pixel(x, yBottom - b, column[b], column[b], column[b]);
+        }
+    }
+
+    //! redraws the plot from the ring buffer, each iteration in the column of its slot.
+    void redraw(void)
+    {
+        _ring.fill(255);
+        drawSeparators(0, _capacity-1);
+        for(int i = 0; i < _size; ++i) drawColumn((_first + i) % _capacity, i);
+        ++_numRedraws;
+    }
+
+    int _capacity;
+    int _height;                                //!< The height of the energy plot, without the strips.
+    int _heightFlips;                           //!< The height of the strip of flips.
+    int _bins;                                  //!< The number of bins of the histogram, 0 for no histogram strip.
+    std::vector<EnergyPlotSample> _samples;     //!< The ring buffer of the iterations.
+    std::vector<unsigned char> _histograms;     //!< The gray levels of the histograms, \c _bins per slot of \c _samples.
+    int _first;                                 //!< The slot of the oldest iteration.
+    int _size;
+    int _numSeries;
+    double _lo;
+    double _hi;
+    double _histogramLo;
+    double _histogramHi;
+    long long _numIterations;
+    long long _numRedraws;
+    cimg_library::CImg<unsigned char> _ring;            //!< The columns of the plot, in the slots of \c _samples.
+    mutable cimg_library::CImg<unsigned char> _image;   //!< The plot composed from \c _ring by \c image.
+    mutable bool _flagComposed;                         //!< A flag indicating \c _image is up to date.
+};
+
+#endif
@@ -0,0 +1,888 @@
+#ifndef cimgFrameEncoder
+#define cimgFrameEncoder
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cimgParallel.hpp"
+#include <CImg.h>
+#ifdef cimg_use_zlib
+#include <zlib.h>
+#endif
+
+///
+/// \brief Frame encoders
+/// write the rendered frames without going through the single-threaded CImg savers.
+/// Four codecs are built in, selected by the extension of the output:
+///   .ppm  raw binary PPM (P6, or P5 for grayscale frames), no compression.
+///   .qoi  the "Quite OK Image" format, a lossless format about as fast to write as a raw copy.
+///   .png  PNG with a configurable zlib level; without \c cimg_use_zlib the data are stored uncompressed.
+///   .jpg  baseline JPEG, lossy, without libjpeg; the format of the frames streamed over HTTP.
+/// Any other extension goes to \c cimg_library::CImg::save.
+
+enum FrameCodec
+{
+    CODEC_PPM,
+    CODEC_QOI,
+    CODEC_PNG,
+    CODEC_JPEG,
+    CODEC_CIMG      //!< Delegated to \c cimg_library::CImg::save.
+};
+
+//! returns the codec of the output \c path, from its extension.
+inline FrameCodec frameCodec(const std::string& path)
+{
+    const size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos || path.find('/', dot) != std::string::npos) return CODEC_CIMG;
+    std::string ext = path.substr(dot+1);
+    for(auto it = ext.begin(); it != ext.end(); ++it) *it = (char)std::tolower((unsigned char)*it);
+    if(ext == "ppm" || ext == "pgm" || ext == "pnm") return CODEC_PPM;
+    if(ext == "qoi") return CODEC_QOI;
+    if(ext == "png") return CODEC_PNG;
+    if(ext == "jpg" || ext == "jpeg") return CODEC_JPEG;
+    return CODEC_CIMG;
+}
+
+//! returns \c path with the zero-padded \c index inserted before its extension, e.g. out/frame00042.png.
+inline std::string numberedFramePath(const std::string& path, const long long index)
+{
+    char number[32];
+    std::snprintf(number, sizeof(number), "%05lld", index);
+    const size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos || path.find('/', dot) != std::string::npos) return path + number;
+    return path.substr(0, dot) + number + path.substr(dot);
+}
+
+//! returns the zlib level of the PNG outputs, 6 unless set by the environment variable \c CIMG_MATCHING_PNG_LEVEL.
+inline int defaultPngLevel(void)
+{
+    const char* env = std::getenv("CIMG_MATCHING_PNG_LEVEL");
+    return env ? std::min(std::max(std::atoi(env), 0), 9) : 6;
+}
+
+//! returns the value of the channel \c c of the pixel \c p, clamped to 8 bits. \c img is planar.
+template <typename T>
+inline unsigned char framePixel(const cimg_library::CImg<T>& img, const size_t p, const int c)
+{
+    const T v = img.data()[(size_t)c*img.width()*img.height() + p];
+    return v <= (T)0 ? 0 : v >= (T)255 ? 255 : (unsigned char)v;
+}
+
+//! returns the number of channels written for \c img: 1 for grayscale, 3 otherwise.
+template <typename T>
+inline int frameChannels(const cimg_library::CImg<T>& img)
+{
+    return img.spectrum() < 3 ? 1 : 3;
+}
+
+//! copies the row \c y of \c img, interleaved, to \c dst.
+template <typename T>
+void interleaveRow(const cimg_library::CImg<T>& img, const int y, unsigned char* dst)
+{
+    const int channels = frameChannels(img);
+    const size_t row = (size_t)y*img.width();
+    for(int c = 0; c < channels; ++c)
+    {
+        unsigned char* d = dst + c;
+        for(int x = 0; x < img.width(); ++x, d += channels) *d = framePixel(img, row+x, c);
+    }
+}
+
+///
+/// \brief encodePPM
+/// encodes \c img as a binary PPM (P6), or PGM (P5) if it has a single channel.
+template <typename T>
+void encodePPM(const cimg_library::CImg<T>& img, std::vector<unsigned char>& out)
+{
+    const int channels = frameChannels(img);
+    char header[64];
+    const int length = std::snprintf(header, sizeof(header), "P%d\n%d %d\n255\n", channels == 1 ? 5 : 6, img.width(), img.height());
+    const size_t stride = (size_t)img.width()*channels;
+    out.resize(length + stride*img.height());
+    std::copy(header, header+length, out.begin());
+    for(int y = 0; y < img.height(); ++y) interleaveRow(img, y, &out[length + y*stride]);
+}
+
+///
+/// \brief encodeQOI
+/// encodes \c img in the QOI format (https://qoiformat.org), with 3 channels and sRGB color space.
+/// Each pixel is written as a run of the previous pixel, an index into the 64 recently seen pixels,
+/// a small difference to the previous pixel, or in full.
+template <typename T>
+void encodeQOI(const cimg_library::CImg<T>& img, std::vector<unsigned char>& out)
+{
+    const int width = img.width(), height = img.height();
+    const bool gray = frameChannels(img) == 1;
+    out.clear();
+    out.reserve(14 + (size_t)width*height*4 + 8);
+    const unsigned char header[14] = {
+        'q', 'o', 'i', 'f',
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+        3, 0
+    };
+    out.insert(out.end(), header, header+14);
+
+    unsigned char index[64][3] = {{0}};
+    bool indexed[64] = {false};     // the decoder starts from transparent black, which no opaque pixel matches
+    unsigned char prev[3] = {0, 0, 0};
+    int run = 0;
+    const size_t numPixels = (size_t)width*height;
+    for(size_t p = 0; p < numPixels; ++p)
+    {
+        unsigned char px[3];
+        px[0] = framePixel(img, p, 0);
+        px[1] = gray ? px[0] : framePixel(img, p, 1);
+        px[2] = gray ? px[0] : framePixel(img, p, 2);
+        if(px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2])
+        {
+            if(++run == 62 || p+1 == numPixels)
+            {
+                out.push_back((unsigned char)(0xc0 | (run-1)));
+                run = 0;
+            }
+            continue;
+        }
+        if(run > 0)
+        {
+            out.push_back((unsigned char)(0xc0 | (run-1)));
+            run = 0;
+        }
+        const int hash = (px[0]*3 + px[1]*5 + px[2]*7 + 255*11) % 64;
+        if(indexed[hash] && index[hash][0] == px[0] && index[hash][1] == px[1] && index[hash][2] == px[2])
+        {
+            out.push_back((unsigned char)hash);
+        }
+        else
+        {
+            std::copy(px, px+3, index[hash]);
+            indexed[hash] = true;
+            const int dr = (signed char)(px[0]-prev[0]);
+            const int dg = (signed char)(px[1]-prev[1]);
+            const int db = (signed char)(px[2]-prev[2]);
+            const int dgr = dr-dg, dgb = db-dg;
+            if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+            {
+                out.push_back((unsigned char)(0x40 | (dr+2) << 4 | (dg+2) << 2 | (db+2)));
+            }
+            else if(dg >= -32 && dg <= 31 && dgr >= -8 && dgr <= 7 && dgb >= -8 && dgb <= 7)
+            {
+                out.push_back((unsigned char)(0x80 | (dg+32)));
+                out.push_back((unsigned char)((dgr+8) << 4 | (dgb+8)));
+            }
+            else
+            {
+                out.push_back(0xfe);
+                out.insert(out.end(), px, px+3);
+            }
+        }
+        std::copy(px, px+3, prev);
+    }
+    static const unsigned char end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out.insert(out.end(), end, end+8);
+}
+
+//! returns the CRC-32 of \c data, continuing \c crc, as used by the PNG chunks.
+inline unsigned int crc32Png(const unsigned char* data, const size_t size, unsigned int crc = 0)
+{
+    static unsigned int table[256];
+    static const bool init = [](){
+        for(unsigned int n = 0; n < 256; ++n)
+        {
+            unsigned int c = n;
+            for(int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)init;
+    crc = ~crc;
+    for(size_t i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+//! appends the PNG chunk \c type holding \c data to \c out.
+inline void appendPngChunk(std::vector<unsigned char>& out, const char type[4], const unsigned char* data, const size_t size)
+{
+    const unsigned char length[4] = {(unsigned char)(size >> 24), (unsigned char)(size >> 16), (unsigned char)(size >> 8), (unsigned char)size};
+    out.insert(out.end(), length, length+4);
+    const size_t start = out.size();
+    out.insert(out.end(), type, type+4);
+    if(size > 0) out.insert(out.end(), data, data+size);
+    const unsigned int crc = crc32Png(&out[start], size+4);
+    const unsigned char bytes[4] = {(unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc};
+    out.insert(out.end(), bytes, bytes+4);
+}
+
+//! wraps \c data in a zlib stream of stored (uncompressed) deflate blocks.
+inline void zlibStored(const std::vector<unsigned char>& data, std::vector<unsigned char>& out)
+{
+    const size_t block = 65535;
+    out.clear();
+    out.reserve(data.size() + 5*(data.size()/block+1) + 6);
+    out.push_back(0x78);
+    out.push_back(0x01);
+    size_t pos = 0;
+    do
+    {
+        const size_t n = std::min(block, data.size()-pos);
+        out.push_back(pos+n == data.size() ? 1 : 0);
+        out.push_back((unsigned char)n);
+        out.push_back((unsigned char)(n >> 8));
+        out.push_back((unsigned char)~n);
+        out.push_back((unsigned char)(~n >> 8));
+        out.insert(out.end(), data.begin()+pos, data.begin()+pos+n);
+        pos += n;
+    } while(pos < data.size());
+    unsigned int a = 1, b = 0;
+    for(size_t i = 0; i < data.size(); )
+    {
+        const size_t end = std::min(data.size(), i+5552);   // the largest run before the sums overflow
+        for(; i < end; ++i) {a += data[i]; b += a;}
+        a %= 65521;
+        b %= 65521;
+    }
+    const unsigned int adler = b << 16 | a;
+    out.push_back((unsigned char)(adler >> 24));
+    out.push_back((unsigned char)(adler >> 16));
+    out.push_back((unsigned char)(adler >> 8));
+    out.push_back((unsigned char)adler);
+}
+
+///
+/// \brief encodePNG
+/// encodes \c img as an 8-bit RGB (or grayscale) PNG compressed at the zlib \c level, from 0 to 9.
+/// At level 0 the rows are stored unfiltered; otherwise each row takes the filter whose output
+/// has the smallest sum of absolute values, the usual heuristic for natural images.
+template <typename T>
+void encodePNG(const cimg_library::CImg<T>& img, std::vector<unsigned char>& out, const int level = defaultPngLevel())
+{
+    const int width = img.width(), height = img.height();
+    const int channels = frameChannels(img);
+    const size_t stride = (size_t)width*channels;
+
+    // filtered rows, each preceded by its filter type
+    std::vector<unsigned char> raw((stride+1)*height);
+    std::vector<unsigned char> rowUp(stride, 0), rowCur(stride), candidate[4];
+    for(int f = 0; f < 4; ++f) candidate[f].resize(stride);
+    for(int y = 0; y < height; ++y, rowUp.swap(rowCur))
+    {
+        const unsigned char* up = &rowUp[0];
+        unsigned char* cur = &rowCur[0];
+        interleaveRow(img, y, cur);
+        unsigned char* dst = &raw[(stride+1)*y];
+        if(level <= 0)
+        {
+            dst[0] = 0;
+            std::copy(cur, cur+stride, dst+1);
+            continue;
+        }
+        // filters 1 (sub), 2 (up), 3 (average) and 4 (Paeth); filter 0 (none) is cur itself
+        long best = 0;
+        for(size_t i = 0; i < stride; ++i) best += cur[i] < 128 ? cur[i] : 256-cur[i];
+        int bestFilter = 0;
+        for(int f = 1; f <= 4; ++f)
+        {
+            unsigned char* c = &candidate[f-1][0];
+            long sum = 0;
+            for(size_t i = 0; i < stride; ++i)
+            {
+                const int a = i >= (size_t)channels ? cur[i-channels] : 0;
+                const int b = up[i];
+                const int d = i >= (size_t)channels ? up[i-channels] : 0;
+                int pred;
+                if(f == 1)      pred = a;
+                else if(f == 2) pred = b;
+                else if(f == 3) pred = (a+b)/2;
+                else
+                {
+                    const int p = a+b-d, pa = std::abs(p-a), pb = std::abs(p-b), pc = std::abs(p-d);
+                    pred = pa <= pb && pa <= pc ? a : pb <= pc ? b : d;
+                }
+                c[i] = (unsigned char)(cur[i]-pred);
+                sum += c[i] < 128 ? c[i] : 256-c[i];
+            }
+            if(sum < best)
+            {
+                best = sum;
+                bestFilter = f;
+            }
+        }
+        dst[0] = (unsigned char)bestFilter;
+        const unsigned char* src = bestFilter == 0 ? cur : &candidate[bestFilter-1][0];
+        std::copy(src, src+stride, dst+1);
+    }
+
+    std::vector<unsigned char> compressed;
+#ifdef cimg_use_zlib
+    if(level > 0)
+    {
+        uLongf size = compressBound((uLong)raw.size());
+        compressed.resize(size);
+        if(compress2(&compressed[0], &size, &raw[0], (uLong)raw.size(), std::min(level, 9)) == Z_OK) compressed.resize(size);
+        else compressed.clear();
+    }
+#endif
+    if(compressed.empty()) zlibStored(raw, compressed);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    const unsigned char ihdr[13] = {
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height,
+        8, (unsigned char)(channels == 1 ? 0 : 2), 0, 0, 0
+    };
+    out.clear();
+    out.reserve(compressed.size() + 64);
+    out.insert(out.end(), signature, signature+8);
+    appendPngChunk(out, "IHDR", ihdr, 13);
+    appendPngChunk(out, "IDAT", compressed.empty() ? 0 : &compressed[0], compressed.size());
+    appendPngChunk(out, "IEND", 0, 0);
+}
+
+//! The order of the coefficients of a JPEG block: the natural (row-major) index of the k-th zigzag coefficient.
+static const unsigned char _jpegZigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+//! The quantization tables of the JPEG standard (Annex K), luminance then chrominance, in natural order.
+static const unsigned char _jpegQuantization[2][64] = {
+    {16, 11, 10, 16,  24,  40,  51,  61,  12, 12, 14, 19,  26,  58,  60,  55,
+     14, 13, 16, 24,  40,  57,  69,  56,  14, 17, 22, 29,  51,  87,  80,  62,
+     18, 22, 37, 56,  68, 109, 103,  77,  24, 35, 55, 64,  81, 104, 113,  92,
+     49, 64, 78, 87, 103, 121, 120, 101,  72, 92, 95, 98, 112, 100, 103,  99},
+    {17, 18, 24, 47, 99, 99, 99, 99,  18, 21, 26, 66, 99, 99, 99, 99,
+     24, 26, 56, 99, 99, 99, 99, 99,  47, 66, 99, 99, 99, 99, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99,
+     99, 99, 99, 99, 99, 99, 99, 99,  99, 99, 99, 99, 99, 99, 99, 99}
+};
+
+//! The Huffman tables of the JPEG standard (Annex K): the number of codes of each length from 1 to 16, then the symbols.
+static const unsigned char _jpegDcCounts[2][16] = {
+    {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+    {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0}
+};
+static const unsigned char _jpegDcSymbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const unsigned char _jpegAcCounts[2][16] = {
+    {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d},
+    {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77}
+};
+static const unsigned char _jpegAcSymbols[2][162] = {
+    {0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+     0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+     0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+     0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+     0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+     0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+     0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+     0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+     0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+     0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+     0xf9, 0xfa},
+    {0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+     0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+     0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+     0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+     0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+     0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+     0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+     0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+     0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+     0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+     0xf9, 0xfa}
+};
+
+///
+/// \brief The JpegWriter class
+/// holds the state of \c encodeJPEG: the scaled quantization tables, the Huffman codes and the bit buffer
+/// of the entropy-coded data.
+class JpegWriter
+{
+public:
+    JpegWriter(std::vector<unsigned char>& out, const int quality):
+        _out(out),
+        _bits(0),
+        _numBits(0)
+    {
+        const int q = std::min(std::max(quality, 1), 100);
+        const int scale = q < 50 ? 5000/q : 200-2*q;
+        for(int t = 0; t < 2; ++t)
+        {
+            for(int i = 0; i < 64; ++i)
+            {
+                const int v = (_jpegQuantization[t][i]*scale + 50)/100;
+                _quantization[t][i] = (unsigned char)std::min(std::max(v, 1), 255);
+            }
+            huffmanCodes(_jpegDcCounts[t], _jpegDcSymbols, _dc[t]);
+            huffmanCodes(_jpegAcCounts[t], _jpegAcSymbols[t], _ac[t]);
+        }
+        for(int u = 0; u < 8; ++u)
+        {
+            for(int x = 0; x < 8; ++x)
+            {
+                _cosine[u][x] = (u == 0 ? std::sqrt(0.125) : 0.5)*std::cos((2*x+1)*u*3.14159265358979323846/16);
+            }
+        }
+    }
+
+    //! writes the markers preceding the entropy-coded data of a \c width x \c height image.
+    void header(const int width, const int height, const int numComponents)
+    {
+        static const unsigned char jfif[18] = {0xff, 0xd8, 0xff, 0xe0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1};
+        _out.insert(_out.end(), jfif, jfif+18);
+        _out.push_back(0); _out.push_back(0);
+        const int numTables = numComponents == 1 ? 1 : 2;
+
+        marker(0xdb, 65*numTables);
+        for(int t = 0; t < numTables; ++t)
+        {
+            _out.push_back((unsigned char)t);
+            for(int k = 0; k < 64; ++k) _out.push_back(_quantization[t][_jpegZigzag[k]]);
+        }
+
+        marker(0xc0, 6 + 3*numComponents);
+        const unsigned char frame[6] = {8, (unsigned char)(height >> 8), (unsigned char)height,
+                                        (unsigned char)(width >> 8), (unsigned char)width, (unsigned char)numComponents};
+        _out.insert(_out.end(), frame, frame+6);
+        for(int c = 0; c < numComponents; ++c)
+        {
+            _out.push_back((unsigned char)(c+1));
+            _out.push_back(c == 0 && numComponents > 1 ? 0x22 : 0x11);
+            _out.push_back(c == 0 ? 0 : 1);
+        }
+
+        marker(0xc4, numTables*(2*17 + 12 + 162));
+        for(int t = 0; t < numTables; ++t)
+        {
+            _out.push_back((unsigned char)t);
+            _out.insert(_out.end(), _jpegDcCounts[t], _jpegDcCounts[t]+16);
+            _out.insert(_out.end(), _jpegDcSymbols, _jpegDcSymbols+12);
+            _out.push_back((unsigned char)(0x10 | t));
+            _out.insert(_out.end(), _jpegAcCounts[t], _jpegAcCounts[t]+16);
+            _out.insert(_out.end(), _jpegAcSymbols[t], _jpegAcSymbols[t]+162);
+        }
+
+        marker(0xda, 4 + 2*numComponents);
+        _out.push_back((unsigned char)numComponents);
+        for(int c = 0; c < numComponents; ++c)
+        {
+            _out.push_back((unsigned char)(c+1));
+            _out.push_back(c == 0 ? 0x00 : 0x11);
+        }
+        _out.push_back(0); _out.push_back(63); _out.push_back(0);
+    }
+
+    ///
+    /// \brief block
+    /// transforms, quantizes with the table \c t (0 luminance, 1 chrominance) and writes the 8x8 samples
+    /// \c samples, centered on 0. \c dc is the DC coefficient of the previous block of the component.
+    void block(const float samples[64], const int t, int& dc)
+    {
+        // separable DCT: the rows, then the columns
+        double rows[64];
+        for(int y = 0; y < 8; ++y)
+        {
+            for(int u = 0; u < 8; ++u)
+            {
+                double sum = 0;
+                for(int x = 0; x < 8; ++x) sum += _cosine[u][x]*samples[8*y+x];
+                rows[8*y+u] = sum;
+            }
+        }
+        int coefficients[64];
+        for(int v = 0; v < 8; ++v)
+        {
+            for(int u = 0; u < 8; ++u)
+            {
+                double sum = 0;
+                for(int y = 0; y < 8; ++y) sum += _cosine[v][y]*rows[8*y+u];
+                const double q = sum/_quantization[t][8*v+u];
+                coefficients[8*v+u] = (int)(q < 0 ? q-0.5 : q+0.5);
+            }
+        }
+
+        const int diff = coefficients[0] - dc;
+        dc = coefficients[0];
+        const int category = magnitudeBits(diff);
+        write(_dc[t][category]);
+        writeMagnitude(diff, category);
+        int run = 0;
+        for(int k = 1; k < 64; ++k)
+        {
+            const int c = coefficients[_jpegZigzag[k]];
+            if(c == 0)
+            {
+                ++run;
+                continue;
+            }
+            for(; run >= 16; run -= 16) write(_ac[t][0xf0]);
+            const int bits = magnitudeBits(c);
+            write(_ac[t][(run << 4) | bits]);
+            writeMagnitude(c, bits);
+            run = 0;
+        }
+        if(run > 0) write(_ac[t][0x00]);
+    }
+
+    //! pads the last byte with ones and writes the end-of-image marker.
+    void finish(void)
+    {
+        if(_numBits > 0) write(HuffmanCode((1 << (8-_numBits)) - 1, 8-_numBits));
+        _out.push_back(0xff);
+        _out.push_back(0xd9);
+    }
+
+private:
+    struct HuffmanCode
+    {
+        HuffmanCode(const unsigned int c = 0, const int n = 0): code(c), length(n) {}
+        unsigned int code;
+        int length;
+    };
+
+    //! assigns the canonical codes, in the order of the symbols, to \c codes, indexed by symbol.
+    static void huffmanCodes(const unsigned char counts[16], const unsigned char* symbols, HuffmanCode codes[256])
+    {
+        unsigned int code = 0;
+        for(int length = 1, s = 0; length <= 16; ++length, code <<= 1)
+        {
+            for(int i = 0; i < counts[length-1]; ++i, ++code) codes[symbols[s++]] = HuffmanCode(code, length);
+        }
+    }
+
+    //! returns the number of bits of the magnitude of \c value, its JPEG category.
+    static int magnitudeBits(int value)
+    {
+        int bits = 0;
+        for(value = std::abs(value); value; value >>= 1) ++bits;
+        return bits;
+    }
+
+    void marker(const unsigned char type, const int length)
+    {
+        _out.push_back(0xff);
+        _out.push_back(type);
+        _out.push_back((unsigned char)((length+2) >> 8));
+        _out.push_back((unsigned char)(length+2));
+    }
+
+    //! writes the \c bits low bits of \c value, negative values in one's complement.
+    void writeMagnitude(const int value, const int bits)
+    {
+        if(bits > 0) write(HuffmanCode((unsigned int)(value < 0 ? value + (1 << bits) - 1 : value), bits));
+    }
+
+    //! appends \c code to the bit buffer, stuffing a zero after each 0xff byte.
+    void write(const HuffmanCode& code)
+    {
+        _bits = (_bits << code.length) | (code.code & ((1u << code.length) - 1));
+        _numBits += code.length;
+        while(_numBits >= 8)
+        {
+            const unsigned char byte = (unsigned char)(_bits >> (_numBits-8));
+            _out.push_back(byte);
+            if(byte == 0xff) _out.push_back(0);
+            _numBits -= 8;
+        }
+    }
+
+    std::vector<unsigned char>& _out;
+    unsigned char _quantization[2][64];     //!< The scaled tables, luminance and chrominance, in natural order.
+    HuffmanCode _dc[2][256];
+    HuffmanCode _ac[2][256];
+    double _cosine[8][8];                   //!< The DCT basis, scaled.
+    unsigned int _bits;                     //!< The bits not written yet, in the low \c _numBits bits.
+    int _numBits;
+};
+
+///
+/// \brief encodeJPEG
+/// encodes \c img as a baseline JPEG (JFIF) of the given \c quality, from 1 to 100, with the tables of
+/// the standard. Color frames are converted to YCbCr and their chroma subsampled 2x2; the blocks
+/// crossing the border repeat the last column and row.
+template <typename T>
+void encodeJPEG(const cimg_library::CImg<T>& img, std::vector<unsigned char>& out, const int quality = 85)
+{
+    const int width = img.width(), height = img.height();
+    const bool gray = frameChannels(img) == 1;
+    out.clear();
+    out.reserve((size_t)width*height/4 + 1024);
+    JpegWriter writer(out, quality);
+    writer.header(width, height, gray ? 1 : 3);
+
+    auto sample = [&](const int x, const int y, const int c) -> float
+    {
+        return framePixel(img, (size_t)std::min(y, height-1)*width + std::min(x, width-1), c);
+    };
+    float samples[64], cb[64], cr[64];
+    int dc[3] = {0, 0, 0};
+    const int mcu = gray ? 8 : 16;
+    for(int y0 = 0; y0 < height; y0 += mcu)
+    {
+        for(int x0 = 0; x0 < width; x0 += mcu)
+        {
+            if(gray)
+            {
+                for(int i = 0; i < 64; ++i) samples[i] = sample(x0 + i%8, y0 + i/8, 0) - 128;
+                writer.block(samples, 0, dc[0]);
+                continue;
+            }
+            std::fill(cb, cb+64, 0.f);
+            std::fill(cr, cr+64, 0.f);
+            for(int b = 0; b < 4; ++b)
+            {
+                const int bx = x0 + 8*(b%2), by = y0 + 8*(b/2);
+                for(int i = 0; i < 64; ++i)
+                {
+                    const int x = bx + i%8, y = by + i/8;
+                    const float r = sample(x, y, 0), g = sample(x, y, 1), bl = sample(x, y, 2);
+                    samples[i] = 0.299f*r + 0.587f*g + 0.114f*bl - 128;
+                    const int j = 8*((y-y0)/2) + (x-x0)/2;
+                    cb[j] += 0.25f*(-0.168736f*r - 0.331264f*g + 0.5f*bl);
+                    cr[j] += 0.25f*(0.5f*r - 0.418688f*g - 0.081312f*bl);
+                }
+                writer.block(samples, 0, dc[0]);
+            }
+            writer.block(cb, 1, dc[1]);
+            writer.block(cr, 1, dc[2]);
+        }
+    }
+    writer.finish();
+}
+
+///
+/// \brief encodeFrame
+/// encodes \c img with \c codec into \c out; returns false for \c CODEC_CIMG, which has no in-memory encoder.
+template <typename T>
+bool encodeFrame(
+    const cimg_library::CImg<T>& img,
+    const FrameCodec codec,
+    std::vector<unsigned char>& out,
+    const int pngLevel = defaultPngLevel()
+)
+{
+    switch(codec)
+    {
+    case CODEC_PPM: encodePPM(img, out); return true;
+    case CODEC_QOI: encodeQOI(img, out); return true;
+    case CODEC_PNG: encodePNG(img, out, pngLevel); return true;
+    case CODEC_JPEG: encodeJPEG(img, out); return true;
+    default: return false;
+    }
+}
+
+//! writes \c bytes to the file \c path.
+inline bool writeFile(const std::string& path, const std::vector<unsigned char>& bytes)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file) return false;
+    const bool ok = (bytes.empty() || std::fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size());
+    return std::fclose(file) == 0 && ok;
+}
+
+///
+/// \brief saveFrame
+/// saves \c img to \c path with the codec of its extension.
+template <typename T>
+bool saveFrame(
+    const cimg_library::CImg<T>& img,
+    const std::string& path,
+    const int pngLevel = defaultPngLevel()
+)
+{
+    std::vector<unsigned char> bytes;
+    if(encodeFrame(img, frameCodec(path), bytes, pngLevel)) return writeFile(path, bytes);
+    try
+    {
+        img.save(path.c_str());
+    }
+    catch(...)
+    {
+        return false;
+    }
+    return true;
+}
+
+///
+/// \brief The FrameEncoder class
+/// encodes frames on its own threads while the caller renders the next ones.
+/// The frames are written in the order they are pushed, whatever order their encoding finishes in.
+/// At most \c maxInFlight frames are held; \c push blocks beyond, so a slow disk throttles the renderer
+/// instead of filling the memory.
+template <typename T>
+class FrameEncoder
+{
+public:
+    //! Default constructor
+    explicit FrameEncoder(
+        const int pngLevel = defaultPngLevel(),
+        const int numThreads = numberOfThreads(),
+        const int maxInFlight = 0       //!< 0 for twice the number of threads.
+    ):
+        _pngLevel(pngLevel),
+        _maxInFlight(maxInFlight > 0 ? maxInFlight : 2*std::max(numThreads, 1)),
+        _inFlight(0),
+        _nextIndex(0),
+        _nextWrite(0),
+        _numFailed(0),
+        _bytes(0),
+        _flagWriting(false),
+        _stop(false)
+    {
+        for(int k = 0; k < std::max(numThreads, 1); ++k)
+        {
+            _threads.push_back(std::thread(&FrameEncoder::run, this));
+        }
+    }
+    //! Destructor: writes the pending frames, then stops the threads.
+    ~FrameEncoder(void)
+    {
+        finish();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cvWork.notify_all();
+        for(auto it = _threads.begin(); it != _threads.end(); ++it) it->join();
+    }
+
+    //! queues \c frame to be saved to \c path with the codec of its extension; returns its index.
+    long long push(const cimg_library::CImg<T>& frame, const std::string& path)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cvSpace.wait(lock, [this](){return _inFlight < _maxInFlight;});
+        ++_inFlight;
+        const long long index = _nextIndex++;
+        _queue.push_back(Job());
+        _queue.back().index = index;
+        _queue.back().path = path;
+        _queue.back().frame = frame;
+        lock.unlock();
+        _cvWork.notify_one();
+        return index;
+    }
+
+    //! waits until all the pushed frames are written.
+    void finish(void)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cvSpace.wait(lock, [this](){return _inFlight == 0;});
+    }
+
+    //! returns the number of frames pushed.
+    long long numberOfFrames(void) const {std::lock_guard<std::mutex> lock(_mutex); return _nextIndex;}
+    //! returns the number of frames which could not be written.
+    long long numberOfFailed(void) const {std::lock_guard<std::mutex> lock(_mutex); return _numFailed;}
+    //! returns the number of bytes written by the built-in codecs.
+    long long bytes(void) const {std::lock_guard<std::mutex> lock(_mutex); return _bytes;}
+
+private:
+    FrameEncoder(const FrameEncoder&);
+    FrameEncoder& operator=(const FrameEncoder&);
+
+    struct Job
+    {
+        Job(void): index(0), encoded(false), failed(false) {}
+        long long index;
+        std::string path;
+        cimg_library::CImg<T> frame;    //!< Kept for \c CODEC_CIMG, released once encoded otherwise.
+        std::vector<unsigned char> bytes;
+        bool encoded;
+        bool failed;                    //!< The encoding threw, nothing is written.
+    };
+
+    //! writes \c job; called by one thread at a time, in the order of the indices.
+    bool write(Job& job)
+    {
+        if(job.failed) return false;
+        if(!job.encoded)
+        {
+            try
+            {
+                job.frame.save(job.path.c_str());
+            }
+            catch(...)
+            {
+                return false;
+            }
+            return true;
+        }
+        return writeFile(job.path, job.bytes);
+    }
+
+    void run(void)
+    {
+        for(;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cvWork.wait(lock, [this](){return _stop || !_queue.empty();});
+                if(_queue.empty()) return;
+                std::swap(job, _queue.front());
+                _queue.pop_front();
+            }
+            try
+            {
+                job.encoded = encodeFrame(job.frame, frameCodec(job.path), job.bytes, _pngLevel);
+            }
+            catch(...)
+            { // e.g. out of memory: the frame fails, the thread keeps encoding the others
+                job.failed = true;
+            }
+            if(job.encoded || job.failed) job.frame.assign();
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::swap(_done[job.index], job);
+            if(_flagWriting) continue;
+            // this thread writes the frames that are next in order, the others keep encoding
+            _flagWriting = true;
+            while(!_done.empty() && _done.begin()->first == _nextWrite)
+            {
+                Job next;
+                std::swap(next, _done.begin()->second);
+                _done.erase(_done.begin());
+                lock.unlock();
+                const bool ok = write(next);
+                if(!ok) std::cerr << "cannot write " << next.path << std::endl;
+                lock.lock();
+                if(ok) _bytes += next.bytes.size();
+                else ++_numFailed;
+                ++_nextWrite;
+                --_inFlight;
+                _cvSpace.notify_all();
+            }
+            _flagWriting = false;
+        }
+    }
+
+    std::vector<std::thread> _threads;
+    mutable std::mutex _mutex;
+    std::condition_variable _cvWork;    //!< Notified when a frame is pushed or the encoder stops.
+    std::condition_variable _cvSpace;   //!< Notified when a frame is written.
+    std::deque<Job> _queue;             //!< Frames waiting to be encoded.
+    std::map<long long, Job> _done;     //!< Encoded frames waiting for the previous ones to be written.
+    const int _pngLevel;
+    const int _maxInFlight;
+    int _inFlight;                      //!< Frames pushed and not written yet.
+    long long _nextIndex;
+    long long _nextWrite;               //!< Index of the next frame to write.
+    long long _numFailed;
+    long long _bytes;
+    bool _flagWriting;                  //!< A flag indicating a thread is writing the frames in order.
+    bool _stop;
+};
+
+#endif
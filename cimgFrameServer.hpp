@@ -0,0 +1,446 @@
+#ifndef cimgFrameServer
+#define cimgFrameServer
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cimgFrameEncoder.hpp"
+#include <CImg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CIMG_MATCHING_SOCKETS
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+///
+/// \brief The FrameStatus struct
+/// summarizes the iteration a frame shows, for the JSON endpoint of the frame server.
+struct FrameStatus
+{
+    FrameStatus(void):
+        iteration(0),
+        numCorrespondences(0),
+        energyMin(0),
+        energyMax(0),
+        energyMean(0),
+        energyTotal(0)
+    {}
+
+    //! returns the status of \c iteration, with the summary of the \c energy of its correspondences.
+    static FrameStatus summary(const long long iteration, const int numCorrespondences, const std::vector<double>& energy)
+    {
+        FrameStatus status;
+        status.iteration = iteration;
+        status.numCorrespondences = numCorrespondences;
+        if(energy.empty()) return status;
+        status.energyMin = *std::min_element(energy.begin(), energy.end());
+        status.energyMax = *std::max_element(energy.begin(), energy.end());
+        for(size_t e = 0; e < energy.size(); ++e) status.energyTotal += energy[e];
+        status.energyMean = status.energyTotal/energy.size();
+        return status;
+    }
+
+    long long iteration;
+    int numCorrespondences;
+    double energyMin;
+    double energyMax;
+    double energyMean;
+    double energyTotal;
+};
+
+///
+/// \brief The FrameServer class
+/// serves the latest published frame over HTTP, so a viewer running in a container or on a remote
+/// machine can be watched from a browser instead of through a forwarded display. Endpoints:
+///   /             a page showing the stream and the status
+///   /frame.jpg    the latest frame as JPEG
+///   /frame.png    the latest frame as PNG
+///   /stream.mjpg  the frames as a multipart (MJPEG) stream, as they are published
+///   /status.json  the frame number, the iteration, the number of correspondences and the energy summary
+///
+/// \c publish only copies the frame. Each format of a frame is encoded once, by the first client
+/// asking for it, and the bytes are shared with all the others; a frame nobody asks for is never
+/// encoded. A stream client always gets the latest frame, skipping the ones published while it was
+/// sending, so a slow client delays neither the publisher nor the other clients.
+/// Each connection serves one request on its own thread, at most \c maxClients at once.
+/// The server listens on the loopback interface unless another address is given.
+class FrameServer
+{
+public:
+    //! Default constructor
+    explicit FrameServer(
+        const int jpegQuality = 80,
+        const int maxClients = 16
+    ):
+        _jpegQuality(jpegQuality),
+        _maxClients(maxClients > 0 ? maxClients : 1),
+        _listen(-1),
+        _port(0),
+        _numFrames(0),
+        _stop(false)
+    {}
+    //! Destructor: closes the connections and stops listening.
+    ~FrameServer(void) {stop();}
+
+    ///
+    /// \brief start
+    /// listens on \c port of \c address, 0 choosing a free port (see \c port).
+    bool start(const int port, const std::string& address = "127.0.0.1")
+    {
+        stop();
+#ifdef CIMG_MATCHING_SOCKETS
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((unsigned short)port);
+        if(::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+        {
+            std::cerr << "invalid address " << address << std::endl;
+            return false;
+        }
+        _listen = ::socket(AF_INET, SOCK_STREAM, 0);
+        const int yes = 1;
+        if(_listen < 0
+           || ::setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) != 0
+           || ::bind(_listen, (const sockaddr*)&addr, sizeof(addr)) != 0
+           || ::listen(_listen, 16) != 0)
+        {
+            std::cerr << "cannot listen on " << address << ":" << port << std::endl;
+            if(_listen >= 0) ::close(_listen);
+            _listen = -1;
+            return false;
+        }
+        socklen_t length = sizeof(addr);
+        ::getsockname(_listen, (sockaddr*)&addr, &length);
+        _port = ntohs(addr.sin_port);
+        _stop = false;
+        _thread = std::thread(&FrameServer::run, this);
+        return true;
+#else
+        (void)port; (void)address;
+        std::cerr << "sockets are not supported on this platform" << std::endl;
+        return false;
+#endif
+    }
+
+    //! stops listening and closes the connections.
+    void stop(void)
+    {
+#ifdef CIMG_MATCHING_SOCKETS
+        if(_listen < 0) return;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+            // wakes the clients blocked in send
+            for(auto it = _clients.begin(); it != _clients.end(); ++it) ::shutdown((*it)->socket, SHUT_RDWR);
+        }
+        _cvFrame.notify_all();
+        _thread.join();
+        for(auto it = _clients.begin(); it != _clients.end(); ++it)
+        {
+            (*it)->thread.join();
+            ::close((*it)->socket);
+        }
+        _clients.clear();
+        ::close(_listen);
+        _listen = -1;
+#endif
+    }
+
+    ///
+    /// \brief publish
+    /// makes \c frame, showing the iteration described by \c status, the frame served to the clients.
+    template <typename T>
+    void publish(const cimg_library::CImg<T>& frame, const FrameStatus& status)
+    {
+        std::shared_ptr<Frame> f = std::make_shared<Frame>();
+        f->image.assign(frame.width(), frame.height(), 1, frameChannels(frame));
+        const size_t plane = (size_t)frame.width()*frame.height();
+        for(int c = 0; c < f->image.spectrum(); ++c)
+        {
+            for(size_t p = 0; p < plane; ++p) f->image.data()[c*plane + p] = framePixel(frame, p, c);
+        }
+        f->status = status;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            f->number = ++_numFrames;
+            _latest = f;
+        }
+        _cvFrame.notify_all();
+    }
+
+    //! returns the port listened on.
+    int port(void) const {return _port;}
+    //! returns the number of frames published.
+    long long numberOfFrames(void) const {std::lock_guard<std::mutex> lock(_mutex); return _numFrames;}
+    //! returns the number of open connections.
+    int numberOfClients(void) const {std::lock_guard<std::mutex> lock(_mutex); return (int)_clients.size();}
+
+private:
+    FrameServer(const FrameServer&);
+    FrameServer& operator=(const FrameServer&);
+
+    //! A published frame and its encodings, made on demand.
+    struct Frame
+    {
+        Frame(void): number(0) {}
+
+        //! returns the frame encoded as JPEG (\c png false) or PNG, encoding it on the first call.
+        const std::vector<unsigned char>& encoded(const bool png, const int jpegQuality)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<unsigned char>& bytes = png ? this->png : jpeg;
+            if(bytes.empty())
+            {
+                if(png) encodePNG(image, bytes, 1);
+                else encodeJPEG(image, bytes, jpegQuality);
+            }
+            return bytes;
+        }
+
+        long long number;
+        FrameStatus status;
+        cimg_library::CImg<unsigned char> image;
+        std::mutex mutex;                   //!< Guards the encodings.
+        std::vector<unsigned char> jpeg;
+        std::vector<unsigned char> png;
+    };
+
+    //! A connection and the thread serving it.
+    struct Client
+    {
+        Client(const int s): socket(s), done(false) {}
+        int socket;
+        std::thread thread;
+        std::atomic<bool> done;
+    };
+
+#ifdef CIMG_MATCHING_SOCKETS
+    //! accepts the connections, reaping the finished ones, until \c stop.
+    void run(void)
+    {
+        for(;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if(_stop) break;
+            }
+            for(auto it = _clients.begin(); it != _clients.end();)
+            {
+                if(!(*it)->done) {++it; continue;}
+                (*it)->thread.join();
+                ::close((*it)->socket);
+                std::lock_guard<std::mutex> lock(_mutex);
+                it = _clients.erase(it);
+            }
+            pollfd p;
+            p.fd = _listen;
+            p.events = POLLIN;
+            if(::poll(&p, 1, 100) <= 0) continue;
+            const int s = ::accept(_listen, 0, 0);
+            if(s < 0) continue;
+#ifdef SO_NOSIGPIPE
+            const int yes = 1;
+            ::setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+            timeval timeout;
+            timeout.tv_sec = 5;
+            timeout.tv_usec = 0;
+            ::setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(_stop || (int)_clients.size() >= _maxClients)
+            {
+                sendText(s, "503 Service Unavailable", "text/plain", "too many clients\n");
+                ::close(s);
+                continue;
+            }
+            std::shared_ptr<Client> client = std::make_shared<Client>(s);
+            _clients.push_back(client);
+            client->thread = std::thread(&FrameServer::serve, this, client.get());
+        }
+    }
+
+    //! serves the request of \c client. The socket is closed once the thread is joined, so \c stop never shuts down a reused descriptor.
+    void serve(Client* client)
+    {
+        const int s = client->socket;
+        std::string request;
+        char buffer[1024];
+        while(request.find("\r\n\r\n") == std::string::npos && request.size() < 8192)
+        {
+            const ssize_t n = ::recv(s, buffer, sizeof(buffer), 0);
+            if(n <= 0) break;
+            request.append(buffer, n);
+        }
+        // "GET /path?query HTTP/1.1"
+        std::string method, path;
+        const size_t space = request.find(' ');
+        if(space != std::string::npos)
+        {
+            method = request.substr(0, space);
+            path = request.substr(space+1, request.find_first_of(" ?\r\n", space+1) - space - 1);
+        }
+
+        // a HEAD request is answered with the headers of its GET alone
+        const bool flagBody = method != "HEAD";
+        if(method != "GET" && method != "HEAD") sendText(s, "405 Method Not Allowed", "text/plain", "only GET is served\n");
+        else if(path == "/" || path == "/index.html") sendText(s, "200 OK", "text/html", indexPage(), flagBody);
+        else if(path == "/status.json") sendText(s, "200 OK", "application/json", statusJson(), flagBody);
+        else if(path == "/frame.jpg" || path == "/frame.png")
+        {
+            std::shared_ptr<Frame> frame = latest();
+            if(!frame) sendText(s, "503 Service Unavailable", "text/plain", "no frame yet\n", flagBody);
+            else
+            {
+                const bool png = path == "/frame.png";
+                const std::vector<unsigned char>& bytes = frame->encoded(png, _jpegQuality);
+                if(bytes.empty()) sendText(s, "503 Service Unavailable", "text/plain", "the frame could not be encoded\n", flagBody);
+                else if(sendAll(s, header("200 OK", png ? "image/png" : "image/jpeg", bytes.size())) && flagBody)
+                {
+                    sendAll(s, &bytes[0], bytes.size());
+                }
+            }
+        }
+        else if(path == "/stream.mjpg")
+        {
+            if(flagBody) stream(s);
+            else sendAll(s, streamHeader());
+        }
+        else sendText(s, "404 Not Found", "text/plain", "not found\n", flagBody);
+
+        ::shutdown(s, SHUT_WR);
+        client->done = true;
+    }
+
+    //! sends the frames to \c s as they are published, until the client leaves or the server stops.
+    void stream(const int s)
+    {
+        if(!sendAll(s, streamHeader())) return;
+        long long sent = 0;
+        for(;;)
+        {
+            std::shared_ptr<Frame> frame;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cvFrame.wait(lock, [&](){return _stop || (_latest && _latest->number != sent);});
+                if(_stop) return;
+                frame = _latest;
+            }
+            sent = frame->number;
+            const std::vector<unsigned char>& bytes = frame->encoded(false, _jpegQuality);
+            if(bytes.empty()) continue; // the frame could not be encoded, the stream waits for the next one
+            char part[128];
+            std::snprintf(part, sizeof(part), "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\n\r\n", (int)bytes.size());
+            if(!sendAll(s, part) || !sendAll(s, &bytes[0], bytes.size()) || !sendAll(s, "\r\n")) return;
+        }
+    }
+
+    std::shared_ptr<Frame> latest(void) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _latest;
+    }
+
+    std::string statusJson(void) const
+    {
+        std::shared_ptr<Frame> frame = latest();
+        const FrameStatus status = frame ? frame->status : FrameStatus();
+        char json[512];
+        std::snprintf(json, sizeof(json),
+                      "{\"frame\": %lld, \"width\": %d, \"height\": %d, \"iteration\": %lld, \"correspondences\": %d, "
+                      "\"energy\": {\"min\": %s, \"max\": %s, \"mean\": %s, \"total\": %s}, \"clients\": %d}\n",
+                      frame ? frame->number : 0LL, frame ? frame->image.width() : 0, frame ? frame->image.height() : 0,
+                      status.iteration, status.numCorrespondences,
+                      jsonNumber(status.energyMin).c_str(), jsonNumber(status.energyMax).c_str(),
+                      jsonNumber(status.energyMean).c_str(), jsonNumber(status.energyTotal).c_str(), numberOfClients());
+        return json;
+    }
+
+    //! returns \c value as a JSON number, null if it is infinite or NaN, which JSON cannot represent.
+    static std::string jsonNumber(const double value)
+    {
+        if(!std::isfinite(value)) return "null";
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.17g", value);
+        return text;
+    }
+
+    static std::string indexPage(void)
+    {
+        return "<!DOCTYPE html>\n<html><head><title>CImg matching</title></head><body>\n"
+               "<pre id=\"status\"></pre>\n<img src=\"/stream.mjpg\" alt=\"frame\">\n"
+               "<script>\nsetInterval(function(){fetch('/status.json').then(function(r){return r.text();})"
+               ".then(function(t){document.getElementById('status').textContent = t;});}, 1000);\n</script>\n"
+               "</body></html>\n";
+    }
+
+    static std::string header(const char* status, const char* type, const size_t length)
+    {
+        char text[256];
+        std::snprintf(text, sizeof(text), "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n"
+                                          "Cache-Control: no-cache\r\nConnection: close\r\n\r\n", status, type, (int)length);
+        return text;
+    }
+
+    static std::string streamHeader(void)
+    {
+        return "HTTP/1.0 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+               "Cache-Control: no-cache\r\nConnection: close\r\n\r\n";
+    }
+
+    //! sends a response of \c body, or only its headers if \c flagBody is false.
+    static bool sendText(const int s, const char* status, const char* type, const std::string& body, const bool flagBody = true)
+    {
+        return sendAll(s, flagBody ? header(status, type, body.size()) + body : header(status, type, body.size()));
+    }
+
+    static bool sendAll(const int s, const std::string& text)
+    {
+        return sendAll(s, (const unsigned char*)text.data(), text.size());
+    }
+
+    //! sends \c size bytes; returns false if the client has left.
+    static bool sendAll(const int s, const unsigned char* data, size_t size)
+    {
+        while(size > 0)
+        {
+            const ssize_t n = ::send(s, data, size, MSG_NOSIGNAL);
+            if(n <= 0) return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+#endif
+
+    const int _jpegQuality;
+    const int _maxClients;
+    int _listen;                                    //!< The listening socket, -1 when stopped.
+    int _port;
+    std::thread _thread;                            //!< Accepts the connections.
+    mutable std::mutex _mutex;
+    std::condition_variable _cvFrame;               //!< Notified when a frame is published or the server stops.
+    std::shared_ptr<Frame> _latest;
+    long long _numFrames;
+    std::list<std::shared_ptr<Client> > _clients;
+    bool _stop;
+};
+
+#endif
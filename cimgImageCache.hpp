@@ -0,0 +1,285 @@
+#ifndef cimgImageCache
+#define cimgImageCache
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include "cimgConvertColor.hpp"
+#include <CImg.h>
+
+///
+/// \brief loadReducedPNM
+/// decodes the pixel (\c factor x, \c factor y) of each block of \c factor x \c factor pixels of the binary PNM file
+/// \c path (P5 or P6, 8 bits) into \c img, reading only the rows it samples. \c factor is the smallest integer making
+/// the largest side of \c img at most \c size; \c width and \c height are set to the size of the full image.
+/// Returns false for the other files, which have to be decoded whole: the rows of a PNG or a TIFF file are compressed
+/// in sequence, so reaching a sampled row costs the decode of the rows before it.
+template <typename T>
+bool loadReducedPNM(
+    const std::string& path,
+    const int size,
+    cimg_library::CImg<T>& img,
+    int& width,
+    int& height,
+    int& factor
+)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    char magic[2] = {0, 0};
+    if(size <= 0 || !file.read(magic, 2) || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6')) return false;
+    // the width, the height and the maximum value, separated by whitespace and comments
+    long long fields[3];
+    for(int f = 0; f < 3; ++f)
+    {
+        int c = file.get();
+        while(c == '#' || std::isspace(c))
+        {
+            if(c == '#') while(c != '\n' && c != EOF) c = file.get();
+            c = file.get();
+        }
+        if(!std::isdigit(c)) return false;
+        fields[f] = 0;
+        for(; std::isdigit(c) && fields[f] < (1LL << 31); c = file.get()) fields[f] = 10*fields[f] + (c-'0');
+        if(!std::isspace(c)) return false;
+    }
+    if(fields[0] <= 0 || fields[1] <= 0 || fields[0] >= (1LL << 31) || fields[1] >= (1LL << 31) ||
+       fields[2] <= 0 || fields[2] > 255) return false;
+    width = (int)fields[0];
+    height = (int)fields[1];
+    factor = std::max(1, (std::max(width, height)+size-1)/size);
+    const int channels = magic[1] == '6' ? 3 : 1;
+    const std::streamoff data = file.tellg(), stride = (std::streamoff)width*channels;
+    img.assign(std::max(width/factor, 1), std::max(height/factor, 1), 1, channels);
+    std::vector<unsigned char> row((size_t)stride);
+    for(int y = 0; y < img.height(); ++y)
+    {
+        if(!file.seekg(data + (std::streamoff)y*factor*stride) || !file.read((char*)&row[0], stride)) return false;
+        for(int x = 0; x < img.width(); ++x)
+        {
+            for(int c = 0; c < channels; ++c) img(x, y, 0, c) = (T)row[(size_t)x*factor*channels + c];
+        }
+    }
+    return true;
+}
+
+///
+/// \brief The ImageCache class
+/// A process-wide cache of the decoded and grayscaled backgrounds shown by the viewers.
+/// An image is keyed by its path and the modification time and size of its file,
+/// so an image rewritten on disk is decoded again.
+/// The least recently used images are evicted when the cached pixels exceed the byte budget;
+/// the images are shared read-only, so an evicted image stays valid for the callers holding it.
+/// Concurrent requests for the same image wait for a single decode.
+template <typename T>
+class ImageCache
+{
+public:
+    typedef std::shared_ptr<const cimg_library::CImg<T> > ImagePtr;
+    typedef std::function<void(const cimg_library::CImg<T>&)> DecodedCallback;
+
+    //! Default constructor
+    explicit ImageCache(
+        const size_t budget = defaultBudget()
+    ):
+        _budget(budget),
+        _bytes(0),
+        _hits(0),
+        _misses(0)
+    {}
+
+    //! returns the cache shared by the process.
+    static ImageCache& instance(void)
+    {
+        static ImageCache cache;
+        return cache;
+    }
+
+    //! returns the budget in bytes, 256 MB unless set by the environment variable \c CIMG_MATCHING_IMAGE_CACHE_MB.
+    static size_t defaultBudget(void)
+    {
+        const char* env = std::getenv("CIMG_MATCHING_IMAGE_CACHE_MB");
+        return (env ? (size_t)std::strtoul(env, 0, 10) : 256) << 20;
+    }
+
+    //! returns the grayscaled RGB image of the file \c path, decoding it on a miss.
+    //! On a miss, \c decoded is called with the image as decoded, before the conversion.
+    ImagePtr get(const std::string& path, const DecodedCallback& decoded = DecodedCallback());
+    //! returns the image of the file \c path if it is cached, decoded and current, null otherwise; it is never decoded.
+    ImagePtr find(const std::string& path);
+
+    //! sets the budget in bytes and evicts the images beyond it.
+    void budget(const size_t budget){std::lock_guard<std::mutex> lock(_mutex); _budget = budget; evict();}
+    size_t budget(void) const {return _budget;}
+    //! returns the bytes of the cached pixels.
+    size_t bytes(void) const {std::lock_guard<std::mutex> lock(_mutex); return _bytes;}
+    //! returns the number of cached images.
+    size_t size(void) const {std::lock_guard<std::mutex> lock(_mutex); return _entries.size();}
+    //! returns the number of requests served without decoding.
+    long long hits(void) const {std::lock_guard<std::mutex> lock(_mutex); return _hits;}
+    //! returns the number of requests which decoded their image.
+    long long misses(void) const {std::lock_guard<std::mutex> lock(_mutex); return _misses;}
+    //! removes all the images and resets the counters.
+    void clear(void)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries.clear();
+        _index.clear();
+        _bytes = 0;
+        _hits = _misses = 0;
+    }
+
+private:
+    ImageCache(const ImageCache&);
+    ImageCache& operator=(const ImageCache&);
+
+    struct Entry
+    {
+        std::string path;
+        long long mtime;    //!< Modification time in nanoseconds.
+        long long size;     //!< File size in bytes.
+        size_t bytes;       //!< Bytes of the decoded pixels, 0 while decoding.
+        std::shared_future<ImagePtr> image;
+    };
+    typedef typename std::list<Entry>::iterator Iterator;
+
+    //! reads the modification time and the size of the file \c path.
+    static bool fileStamp(const std::string& path, long long& mtime, long long& size)
+    {
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0) return false;
+#if defined(__linux__)
+        mtime = (long long)st.st_mtim.tv_sec*1000000000LL + st.st_mtim.tv_nsec;
+#else
+        mtime = (long long)st.st_mtime*1000000000LL;
+#endif
+        size = (long long)st.st_size;
+        return true;
+    }
+
+    //! decodes the file \c path into a grayscaled RGB image.
+    static ImagePtr decode(const std::string& path, const DecodedCallback& decoded)
+    {
+        const cimg_library::CImg<T> img(path.c_str());
+        if(decoded) decoded(img);
+        return ImagePtr(new cimg_library::CImg<T>(getDisplayRGB(img)));
+    }
+
+    //! removes \c it; the caller holds \c _mutex.
+    void erase(const Iterator it)
+    {
+        _bytes -= it->bytes;
+        _index.erase(it->path);
+        _entries.erase(it);
+    }
+
+    //! evicts the least recently used decoded images beyond the budget, keeping the most recent one.
+    void evict(void)
+    {
+        Iterator it = _entries.end();
+        while(_bytes > _budget && it != _entries.begin() && --it != _entries.begin())
+        {
+            if(it->bytes > 0) erase(it++);
+        }
+    }
+
+    std::list<Entry> _entries;  //!< Entries from the most to the least recently used.
+    std::unordered_map<std::string, Iterator> _index;
+    mutable std::mutex _mutex;
+    size_t _budget;
+    size_t _bytes;
+    long long _hits;
+    long long _misses;
+};
+
+template <typename T>
+typename ImageCache<T>::ImagePtr ImageCache<T>::find(const std::string& path)
+{
+    long long mtime, size;
+    if(!fileStamp(path, mtime, size)) return ImagePtr();
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _index.find(path);
+    if(found == _index.end()) return ImagePtr();
+    Iterator it = found->second;
+    if(it->mtime != mtime || it->size != size || it->bytes == 0) return ImagePtr();
+    ++_hits;
+    _entries.splice(_entries.begin(), _entries, it);
+    return it->image.get();
+}
+
+template <typename T>
+typename ImageCache<T>::ImagePtr ImageCache<T>::get(const std::string& path, const DecodedCallback& decoded)
+{
+    long long mtime, size;
+    if(!fileStamp(path, mtime, size))
+    { // let the decoder report the missing file
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_misses;
+        }
+        return decode(path, decoded);
+    }
+
+    std::promise<ImagePtr> promise;
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto found = _index.find(path);
+    if(found != _index.end())
+    {
+        Iterator it = found->second;
+        if(it->mtime == mtime && it->size == size)
+        {
+            ++_hits;
+            _entries.splice(_entries.begin(), _entries, it);
+            std::shared_future<ImagePtr> image = it->image;
+            lock.unlock();
+            return image.get();
+        }
+        erase(it);
+    }
+    ++_misses;
+    Entry entry;
+    entry.path = path;
+    entry.mtime = mtime;
+    entry.size = size;
+    entry.bytes = 0;
+    entry.image = promise.get_future().share();
+    _entries.push_front(entry);
+    _index[path] = _entries.begin();
+    lock.unlock();
+
+    ImagePtr image;
+    try
+    {
+        image = decode(path, decoded);
+    }
+    catch(...)
+    {
+        promise.set_exception(std::current_exception());
+        lock.lock();
+        auto failed = _index.find(path);
+        if(failed != _index.end() && failed->second->mtime == mtime && failed->second->bytes == 0) erase(failed->second);
+        throw;
+    }
+    promise.set_value(image);
+
+    lock.lock();
+    auto ready = _index.find(path);
+    if(ready != _index.end() && ready->second->mtime == mtime && ready->second->bytes == 0)
+    {
+        ready->second->bytes = std::max<size_t>(image->size()*sizeof(T), 1);
+        _bytes += ready->second->bytes;
+        evict();
+    }
+    return image;
+}
+
+#endif
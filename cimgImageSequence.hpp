@@ -0,0 +1,242 @@
+#ifndef cimgImageSequence
+#define cimgImageSequence
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cimgConvertColor.hpp"
+#include <CImg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CIMG_MATCHING_DIRENT
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+///
+/// \brief listFrames
+/// lists the frames of a sequence: the image files of the directory \c path sorted by name, or the lines of the
+/// list file \c path, where empty lines and lines starting with '#' are skipped and relative paths are relative
+/// to the directory of the list. Directories are listed on POSIX systems only, elsewhere \c path is read as a list.
+/// Returns false if \c path cannot be read or lists no frame.
+inline bool listFrames(
+    const std::string& path,
+    std::vector<std::string>& frames
+)
+{
+    frames.clear();
+#ifdef CIMG_MATCHING_DIRENT
+    struct stat st;
+    if(stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        DIR* dir = opendir(path.c_str());
+        if(!dir)
+        {
+            std::cerr << "cannot read " << path << std::endl;
+            return false;
+        }
+        static const char* const extensions[] = {"bmp", "jpeg", "jpg", "pgm", "png", "pnm", "ppm", "tif", "tiff"};
+        const std::string prefix = path[path.size()-1] == '/' ? path : path + "/";
+        while(const dirent* entry = readdir(dir))
+        {
+            const std::string name = entry->d_name;
+            const size_t dot = name.find_last_of('.');
+            if(dot == std::string::npos || name[0] == '.') continue;
+            std::string ext = name.substr(dot+1);
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c){return (char)std::tolower(c);});
+            if(std::binary_search(extensions, extensions+9, ext)) frames.push_back(prefix + name);
+        }
+        closedir(dir);
+        std::sort(frames.begin(), frames.end());
+    }
+    else
+#endif
+    {
+        std::ifstream file(path.c_str());
+        if(!file)
+        {
+            std::cerr << "cannot read " << path << std::endl;
+            return false;
+        }
+        const size_t slash = path.find_last_of('/');
+        const std::string dir = slash == std::string::npos ? "" : path.substr(0, slash+1);
+        std::string line;
+        while(std::getline(file, line))
+        {
+            const size_t first = line.find_first_not_of(" \t\r");
+            if(first == std::string::npos || line[first] == '#') continue;
+            const std::string frame = line.substr(first, line.find_last_not_of(" \t\r")-first+1);
+            frames.push_back(frame[0] == '/' ? frame : dir + frame);
+        }
+    }
+    if(frames.empty())
+    {
+        std::cerr << "no frame in " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+///
+/// \brief The ImageSequence class
+/// The frames of a sequence, decoded and grayscaled as the backgrounds of the viewers by a background thread
+/// a few frames ahead of the one shown. The frames are kept in a ring of \c ahead+2 slots: the frame asked for
+/// last, the one after it to make a pair, and \c ahead more; advancing frees the slots behind, which the thread
+/// refills, so the memory is bounded whatever the length of the sequence. The frames bypass \c ImageCache,
+/// which they would flush. A frame asked for before it is prefetched, e.g. after a seek, is waited for.
+template <typename T>
+class ImageSequence
+{
+public:
+    typedef std::shared_ptr<const cimg_library::CImg<T> > ImagePtr;
+
+    //! Default constructor
+    ImageSequence(void):
+        _first(0),
+        _numReady(0),
+        _numWaited(0),
+        _stop(false)
+    {}
+    //! Destructor: stops the thread.
+    ~ImageSequence(void){close();}
+
+    //! starts prefetching the frames \c frames from the first one, \c ahead frames after the pair asked for;
+    //! returns false if there is none.
+    bool open(const std::vector<std::string>& frames, const int ahead = 4)
+    {
+        close();
+        if(frames.empty()) return false;
+        _frames = frames;
+        _first = 0;
+        _numReady = _numWaited = 0;
+        _slots.assign(std::max(ahead, 0)+2, Slot());
+        _stop = false;
+        _thread = std::thread(&ImageSequence::run, this);
+        return true;
+    }
+    //! stops the thread and releases the frames.
+    void close(void)
+    {
+        if(!_thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cvWork.notify_all();
+        _thread.join();
+        for(auto it = _slots.begin(); it != _slots.end(); ++it) *it = Slot();
+    }
+
+    //! returns the number of frames.
+    int size(void) const {return (int)_frames.size();}
+    //! returns the path of the frame \c k.
+    const std::string& path(const int k) const {return _frames[k];}
+    //! returns the number of frames kept, the frame asked for last and the next ones.
+    int capacity(void) const {return (int)_slots.size();}
+
+    ///
+    /// \brief frame
+    /// returns the frame \c k, waiting for it if it is not decoded yet, and moves the window of the frames kept
+    /// to \c k and the next ones. Returns an empty pointer if \c k is out of the sequence or cannot be decoded.
+    ImagePtr frame(const int k)
+    {
+        if(k < 0 || k >= size()) return ImagePtr();
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(k != _first)
+        {
+            _first = k;
+            _cvWork.notify_all();
+        }
+        Slot& slot = _slots[k % _slots.size()];
+        if(slot.index == k && slot.flagDone) ++_numReady;
+        else
+        {
+            ++_numWaited;
+            _cvDone.wait(lock, [&](){return slot.index == k && slot.flagDone;});
+        }
+        if(!slot.image) std::cerr << "cannot read " << _frames[k] << std::endl;
+        return slot.image;
+    }
+
+    //! returns the number of frames which were prefetched when they were asked for.
+    long long numberOfReady(void) const {std::lock_guard<std::mutex> lock(_mutex); return _numReady;}
+    //! returns the number of frames which were waited for.
+    long long numberOfWaited(void) const {std::lock_guard<std::mutex> lock(_mutex); return _numWaited;}
+
+private:
+    ImageSequence(const ImageSequence&);
+    ImageSequence& operator=(const ImageSequence&);
+
+    struct Slot
+    {
+        Slot(void): index(-1), flagDone(false) {}
+        int index;          //!< The frame in the slot, -1 for none.
+        bool flagDone;      //!< A flag indicating the frame is decoded, into \c image unless it failed.
+        ImagePtr image;
+    };
+
+    //! returns the first frame of the window which is not decoded nor being decoded, -1 for none; the caller holds \c _mutex.
+    int nextFrame(void) const
+    {
+        const int last = std::min(_first + (int)_slots.size(), size());
+        for(int k = _first; k < last; ++k)
+        {
+            if(_slots[k % _slots.size()].index != k) return k;
+        }
+        return -1;
+    }
+
+    void run(void)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for(;;)
+        {
+            _cvWork.wait(lock, [this](){return _stop || nextFrame() >= 0;});
+            if(_stop) return;
+            const int k = nextFrame();
+            Slot& slot = _slots[k % _slots.size()];
+            slot = Slot();
+            slot.index = k;
+            const std::string path = _frames[k];
+            lock.unlock();
+
+            ImagePtr image;
+            try
+            {
+                image.reset(new cimg_library::CImg<T>(getDisplayRGB(cimg_library::CImg<T>(path.c_str()))));
+            }
+            catch(const cimg_library::CImgException&)
+            { // reported by frame()
+            }
+
+            lock.lock();
+            // the frame is dropped if a seek gave its slot to another one meanwhile
+            if(slot.index == k)
+            {
+                slot.image = image;
+                slot.flagDone = true;
+                _cvDone.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::string> _frames;
+    std::vector<Slot> _slots;           //!< The frame \c k is in the slot \c k modulo their number.
+    int _first;                         //!< The first frame of the window kept, the one asked for last.
+    long long _numReady;
+    long long _numWaited;
+    std::thread _thread;
+    mutable std::mutex _mutex;
+    std::condition_variable _cvWork;    //!< Notified when the window moves or the sequence closes.
+    std::condition_variable _cvDone;    //!< Notified when a frame is decoded.
+    bool _stop;
+};
+
+#endif
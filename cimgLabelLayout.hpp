@@ -0,0 +1,323 @@
+#ifndef cimgLabelLayout
+#define cimgLabelLayout
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+#include "cimgMatchingSegments.hpp"
+#include "cimgPixelFormat.hpp"
+#include <CImg.h>
+
+//! The labels drawn next to the markers of the correspondences; 0 for none.
+enum PointLabel
+{
+    LABEL_INDEX = 1,    //!< The index of the correspondence.
+    LABEL_ENERGY = 2    //!< The energy of the correspondence.
+};
+
+//! The order in which the labels are placed; a label overlapping one placed before is culled.
+enum LabelPriority
+{
+    PRIORITY_ENERGY_HIGH,   //!< The highest energies first.
+    PRIORITY_ENERGY_LOW,    //!< The lowest energies first.
+    PRIORITY_INDEX          //!< The correspondences in order.
+};
+
+///
+/// \brief The LabelLayout class
+/// places rectangular labels next to their anchors without overlap, greedily: a label is placed at the first free
+/// position around its anchor, or culled. The placed labels are recorded in a screen-space occupancy grid of
+/// \c cellSize pixels, so testing a position costs the number of cells it covers, whatever the number of labels
+/// placed; the cells are marked whole, so labels closer than a cell may be culled.
+class LabelLayout
+{
+public:
+    //! Default constructor
+    explicit LabelLayout(const int cellSize = 4):
+        _cell(std::max(cellSize, 1)),
+        _width(0),
+        _height(0),
+        _columns(0),
+        _rows(0)
+    {}
+
+    //! starts a layout over an image of \c width x \c height pixels, all free.
+    void reset(const int width, const int height)
+    {
+        _width = width;
+        _height = height;
+        _columns = (width + _cell-1)/_cell;
+        _rows = (height + _cell-1)/_cell;
+        _occupied.assign((size_t)_columns*_rows, 0);
+    }
+
+    //! marks the rectangle \c r occupied, e.g. by a caption.
+    void occupy(const FrameRect& r)
+    {
+        const FrameRect c = cells(r.clipped(_width, _height));
+        if(!c.empty()) mark(c);
+    }
+
+    ///
+    /// \brief place
+    /// places a label of \c width x \c height pixels beside the anchor (\c x,\c y), at \c margin pixels to its right,
+    /// left, top or bottom, whichever is free first, and returns true with its rectangle in \c box;
+    /// returns false if none is free and within the image.
+    bool place(
+        const int x,
+        const int y,
+        const int width,
+        const int height,
+        const int margin,
+        FrameRect& box
+    )
+    {
+        for(int k = 0; k < 4; ++k)
+        {
+            const FrameRect r = candidate(k, x, y, width, height, margin);
+            if(!fits(r)) continue;
+            mark(cells(r));
+            box = r;
+            return true;
+        }
+        return false;
+    }
+
+    ///
+    /// \brief blocked
+    /// returns true if no label of \c width x \c height pixels or wider can be placed by \c place beside the anchor
+    /// (\c x,\c y): each position of a wider label covers the same position of this one, so a label can be
+    /// rejected with its smallest width, before its text is formatted and measured.
+    bool blocked(
+        const int x,
+        const int y,
+        const int width,
+        const int height,
+        const int margin
+    ) const
+    {
+        for(int k = 0; k < 4; ++k) if(fits(candidate(k, x, y, width, height, margin))) return false;
+        return true;
+    }
+
+private:
+    //! returns the position \c k of \c place: to the right, left, top or bottom of the anchor.
+    static FrameRect candidate(const int k, const int x, const int y, const int width, const int height, const int margin)
+    {
+        switch(k)
+        {
+        case 0: return FrameRect(x+margin, y-height/2, x+margin+width-1, y-height/2+height-1);
+        case 1: return FrameRect(x-margin-width+1, y-height/2, x-margin, y-height/2+height-1);
+        case 2: return FrameRect(x-width/2, y-margin-height+1, x-width/2+width-1, y-margin);
+        default: return FrameRect(x-width/2, y+margin, x-width/2+width-1, y+margin+height-1);
+        }
+    }
+    //! returns true if the rectangle \c r is within the image and free.
+    bool fits(const FrameRect& r) const
+    {
+        return r.x0 >= 0 && r.y0 >= 0 && r.x1 < _width && r.y1 < _height && isFree(cells(r));
+    }
+    //! returns the cells covered by the rectangle \c r of the image.
+    FrameRect cells(const FrameRect& r) const {return FrameRect(r.x0/_cell, r.y0/_cell, r.x1/_cell, r.y1/_cell);}
+    bool isFree(const FrameRect& c) const
+    {
+        for(int row = c.y0; row <= c.y1; ++row)
+        {
+            const unsigned char* p = &_occupied[(size_t)row*_columns];
+            for(int col = c.x0; col <= c.x1; ++col) if(p[col]) return false;
+        }
+        return true;
+    }
+    void mark(const FrameRect& c)
+    {
+        for(int row = c.y0; row <= c.y1; ++row) std::fill_n(&_occupied[(size_t)row*_columns + c.x0], c.width(), 1);
+    }
+
+    int _cell;                              //!< The size of a cell of the grid, in pixels.
+    int _width;                             //!< The size of the image.
+    int _height;
+    int _columns;                           //!< The size of the grid, in cells.
+    int _rows;
+    std::vector<unsigned char> _occupied;   //!< 1 for each cell covered by a label, row by row.
+};
+
+///
+/// \brief The GlyphCache class
+/// The printable ASCII characters of the CImg font at one size, drawn once as coverage masks; text is then drawn
+/// by blending the masks of its characters, without laying out and rasterizing the font at each call as
+/// \c CImg::draw_text does. It is read-only once built, so threads can share it.
+class GlyphCache
+{
+public:
+    //! builds the glyphs of the font of height \c fontSize.
+    explicit GlyphCache(const int fontSize = 13):
+        _height(std::max(fontSize, 1)),
+        _glyphs(127-32)
+    {
+        const unsigned char white[1] = {255};
+        for(int c = 32; c < 127; ++c)
+        {
+            // the glyph is drawn on a canvas larger than any character and cut a pixel after its ink
+            cimg_library::CImg<unsigned char> canvas(2*_height, _height, 1, 1, 0);
+            const char text[3] = {(char)c, c == '%' ? '%' : '\0', '\0'};
+            canvas.draw_text(0, 0, text, white, 0, 1, _height);
+            int width = 0;
+            for(int y = 0; y < canvas.height(); ++y)
+            {
+                for(int x = canvas.width()-1; x >= width; --x) if(canvas(x,y)) width = x+1;
+            }
+            _glyphs[c-32] = width > 0 ? canvas.get_crop(0, 0, std::min(width, canvas.width()-1), _height-1) :
+                                        cimg_library::CImg<unsigned char>(std::max(_height/3, 1), _height, 1, 1, 0);
+        }
+    }
+
+    //! returns the height of the text.
+    int height(void) const {return _height;}
+    //! returns the width of the narrowest character.
+    int minWidth(void) const
+    {
+        int width = _glyphs[0].width();
+        for(size_t k = 1; k < _glyphs.size(); ++k) width = std::min(width, _glyphs[k].width());
+        return width;
+    }
+    //! returns the width of \c text in pixels; the characters out of the printable ASCII are skipped.
+    int width(const char* text) const
+    {
+        int width = 0;
+        for(const char* p = text; *p; ++p) if(isPrintable(*p)) width += _glyphs[*p-32].width();
+        return width;
+    }
+    //! draws \c text with its top-left corner at (\c x,\c y) in the color \c colorFg, clipped to \c img.
+    template <typename T>
+    void draw(
+        cimg_library::CImg<T>& img,
+        const int x,
+        const int y,
+        const char* text,
+        const unsigned char colorFg[]
+    ) const;
+
+private:
+    static bool isPrintable(const char c){return c >= 32 && c < 127;}
+
+    int _height;
+    std::vector<cimg_library::CImg<unsigned char> > _glyphs;    //!< The coverage of each character from 32, 1 x \c _height.
+};
+
+template <typename T>
+void GlyphCache::draw(
+    cimg_library::CImg<T>& img,
+    const int x,
+    const int y,
+    const char* text,
+    const unsigned char colorFg[]
+) const
+{
+    const int spectrum = std::min(img.spectrum(), 3);
+    int xc = x;
+    for(const char* p = text; *p; ++p)
+    {
+        if(!isPrintable(*p)) continue;
+        const cimg_library::CImg<unsigned char>& glyph = _glyphs[*p-32];
+        const int gx0 = std::max(0, -xc), gx1 = std::min(glyph.width(), img.width()-xc);
+        const int gy0 = std::max(0, -y), gy1 = std::min(glyph.height(), img.height()-y);
+        for(int c = 0; c < spectrum; ++c)
+        {
+            const int fg = colorFg[c];
+            for(int gy = gy0; gy < gy1; ++gy)
+            {
+                const unsigned char* a = glyph.data(0, gy);
+                T* d = img.data(xc, y+gy, 0, c);
+                for(int gx = gx0; gx < gx1; ++gx)
+                {
+                    if(a[gx]) d[gx] = (T)((a[gx]*fg + (255-a[gx])*(int)d[gx] + 127)/255);
+                }
+            }
+        }
+        xc += glyph.width();
+    }
+}
+
+//! writes to \c text the label \c flags of \c segment.
+inline void labelText(
+    char* text,
+    const size_t size,
+    const MatchingSegment& segment,
+    const int flags
+)
+{
+    if((flags & LABEL_INDEX) && (flags & LABEL_ENERGY)) std::snprintf(text, size, "%d:%.3g", segment.index, segment.energy);
+    else if(flags & LABEL_INDEX) std::snprintf(text, size, "%d", segment.index);
+    else std::snprintf(text, size, "%.3g", segment.energy);
+}
+
+//! returns the glyphs of the labels, built at the first call.
+inline const GlyphCache& labelGlyphs(void)
+{
+    static const GlyphCache glyphs(13);
+    return glyphs;
+}
+
+///
+/// \brief drawLabels
+/// draws the labels \c flags (\c PointLabel) of the \c n \c segments next to their marker on the first image,
+/// placed in the \c priority order by \c layout; a label without a free position is culled. The positions are
+/// tested for all the segments, the texts formatted only for those not blocked, and only the labels placed are drawn. Returns the number of labels drawn.
+template <typename T>
+size_t drawLabels(
+    cimg_library::CImg<T>& img,
+    const MatchingSegment* segments,
+    const size_t n,
+    const int flags,
+    const LabelPriority priority,
+    const int radius,
+    const unsigned char colorFg[],
+    const unsigned char colorBg[],
+    LabelLayout& layout,
+    const GlyphCache& glyphs = labelGlyphs()
+)
+{
+    if(n == 0 || !(flags & (LABEL_INDEX | LABEL_ENERGY))) return 0;
+
+    // the segments are ordered by index; the energy orders are sorted once, O(n log n)
+    std::vector<unsigned int> order(n);
+    for(size_t k = 0; k < n; ++k) order[k] = (unsigned int)k;
+    if(priority != PRIORITY_INDEX)
+    {
+        const bool flagHigh = priority == PRIORITY_ENERGY_HIGH;
+        std::stable_sort(order.begin(), order.end(), [segments, flagHigh](const unsigned int a, const unsigned int b){
+            return flagHigh ? segments[a].energy > segments[b].energy : segments[a].energy < segments[b].energy;
+        });
+    }
+
+    // the labels are first tested at their smallest width, at least a character or "0:0", and only those still
+    // alive are formatted and measured; the texts are drawn only for those placed
+    const int minWidth = glyphs.minWidth()*((flags & LABEL_INDEX) && (flags & LABEL_ENERGY) ? 3 : 1) + 2;
+    std::vector<std::pair<FrameRect, unsigned int> > placed;
+    char text[64];
+    for(size_t k = 0; k < n; ++k)
+    {
+        const MatchingSegment& s = segments[order[k]];
+        if(layout.blocked(s.x0, s.y0, minWidth, glyphs.height(), radius+2)) continue;
+        labelText(text, sizeof(text), s, flags);
+        FrameRect box;
+        if(layout.place(s.x0, s.y0, glyphs.width(text)+2, glyphs.height(), radius+2, box)) placed.push_back(std::make_pair(box, order[k]));
+    }
+    for(size_t k = 0; k < placed.size(); ++k)
+    {
+        labelText(text, sizeof(text), segments[placed[k].second], flags);
+        const FrameRect& box = placed[k].first;
+        if(colorBg)
+        { // the box is a pixel wider than the text on both sides
+            for(int c = 0; c < std::min(img.spectrum(), 3); ++c)
+            {
+                for(int y = box.y0; y <= box.y1; ++y) std::fill_n(img.data(box.x0, y, 0, c), box.width(), (T)colorBg[c]);
+            }
+        }
+        glyphs.draw(img, box.x0+1, box.y0, text, colorFg);
+    }
+    return placed.size();
+}
+
+#endif
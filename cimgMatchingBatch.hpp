@@ -0,0 +1,216 @@
+#ifndef cimgMatchingBatch
+#define cimgMatchingBatch
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cimgFrameEncoder.hpp"
+#include "cimgMatchingViewer.hpp"
+#include "cimgMatchingIO.hpp"
+#include "cimgWorkStealing.hpp"
+#include <CImg.h>
+
+///
+/// \brief Batch rendering
+/// renders the matching results of many image pairs in one process.
+/// Each pair goes through two tasks on a \c WorkStealingPool: decode (images and matches)
+/// and render (one \c MatchingViewer per worker); the rendered image is then handed to a \c FrameEncoder,
+/// which encodes and writes it on its own threads while the workers render the next pairs.
+/// The images are decoded through \c ImageCache, so an image shared by several pairs is decoded once.
+/// A task submits the next stage of its pair to its own worker, and at most two pairs per worker
+/// are decoded or rendered at once, so the stages of different pairs overlap while the memory stays bounded.
+
+//! An entry of a batch manifest.
+struct BatchEntry
+{
+    std::string image0;     //!< The first image.
+    std::string image1;     //!< The second image.
+    std::string matches;    //!< The matches x0,y0,x1,y1,e, read by \c loadMatches.
+    std::string output;     //!< The rendered image, saved in the format given by its extension.
+};
+
+//! The summary of a batch run.
+struct BatchReport
+{
+    int numPairs;           //!< The number of entries.
+    int numFailed;          //!< The number of entries that could not be decoded, rendered or saved.
+    int numWorkers;
+    long long numSteals;    //!< The number of tasks run by another worker than the one which queued them.
+    long long numCacheHits;     //!< The number of images found in \c ImageCache.
+    long long numCacheMisses;   //!< The number of images decoded.
+    double seconds;
+    //! returns the throughput in rendered pairs per second.
+    double pairsPerSecond(void) const {return seconds > 0 ? (numPairs-numFailed)/seconds : 0.0;}
+};
+
+///
+/// \brief loadManifest
+/// reads the entries of a manifest: one entry per line, "image0 image1 matches output",
+/// separated by white spaces or commas. Empty lines and lines starting with '#' are skipped.
+/// Relative paths are relative to the directory of the manifest.
+inline bool loadManifest(
+    const std::string& path,
+    std::vector<BatchEntry>& entries
+)
+{
+    std::ifstream file(path.c_str());
+    if(!file)
+    {
+        std::cerr << "cannot read " << path << std::endl;
+        return false;
+    }
+    const size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "" : path.substr(0, slash+1);
+    auto resolve = [&dir](const std::string& p){return p.empty() || p[0] == '/' ? p : dir + p;};
+
+    entries.clear();
+    std::string line;
+    for(int l = 1; std::getline(file, line); ++l)
+    {
+        for(auto it = line.begin(); it != line.end(); ++it)
+        {
+            if(*it == ',' || *it == '\t' || *it == '\r') *it = ' ';
+        }
+        std::istringstream ss(line);
+        std::vector<std::string> fields;
+        std::string field;
+        while(ss >> field) fields.push_back(field);
+        if(fields.empty() || fields[0][0] == '#') continue;
+        if(fields.size() != 4)
+        {
+            std::cerr << path << ":" << l << ": expected image0 image1 matches output" << std::endl;
+            return false;
+        }
+        BatchEntry entry;
+        entry.image0 = resolve(fields[0]);
+        entry.image1 = resolve(fields[1]);
+        entry.matches = resolve(fields[2]);
+        entry.output = resolve(fields[3]);
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+///
+/// \brief renderBatch
+/// renders the matching result of each entry over its aligned image pair on \c numWorkers workers.
+/// The PNG outputs are compressed at the zlib level \c pngLevel.
+template <typename TI, typename TP>
+BatchReport renderBatch(
+    const std::vector<BatchEntry>& entries,
+    const int numWorkers = numberOfThreads(),
+    const int pngLevel = defaultPngLevel()
+)
+{
+    // the data of a pair handed from one stage to the next
+    struct Job
+    {
+        size_t index;
+        typename ImageCache<TI>::ImagePtr image0, image1;
+        cimg_library::CImg<TP> points0, points1;
+        cimg_library::CImg<int> correspondences;
+        std::vector<double> energy;
+    };
+    typedef std::shared_ptr<Job> JobPtr;
+
+    auto start = std::chrono::steady_clock::now();
+    ImageCache<TI>& cache = ImageCache<TI>::instance();
+    const long long hits0 = cache.hits(), misses0 = cache.misses();
+    FrameEncoder<TI> encoder(pngLevel, numWorkers);
+    WorkStealingPool pool(numWorkers);
+    std::vector<std::unique_ptr<MatchingViewer<TI,TP> > > viewers;
+    for(int k = 0; k < pool.numberOfWorkers(); ++k)
+    {
+        viewers.push_back(std::unique_ptr<MatchingViewer<TI,TP> >(new MatchingViewer<TI,TP>));
+    }
+    std::atomic<size_t> next(0);
+    std::atomic<int> numFailed(0);
+    std::mutex mutexLog;
+    auto fail = [&](const size_t n, const std::string& what){
+        ++numFailed;
+        std::lock_guard<std::mutex> lock(mutexLog);
+        std::cerr << "pair " << n << " (" << entries[n].output << "): " << what << std::endl;
+    };
+
+    // each finished pair admits the next entry; the stages are defined in reverse order
+    std::function<void(void)> admit;
+    // a stage never throws into the pool: a pair it cannot handle, e.g. an image of more than 4 channels, fails alone
+    auto render = [&](const JobPtr& job){
+        try
+        {
+            MatchingViewer<TI,TP>& view = *viewers[pool.currentWorker()];
+            view.images(*job->image0, *job->image1);
+            view.points(job->points0, job->points1);
+            view.correspondences(job->correspondences);
+            view.energy(job->energy);
+            job->image0.reset();
+            job->image1.reset();
+            encoder.push(view.drawMatching(view.imgAlign()), entries[job->index].output);
+        }
+        catch(const std::exception& e)
+        {
+            fail(job->index, std::string("cannot render: ") + e.what());
+        }
+        catch(...)
+        {
+            fail(job->index, "cannot render");
+        }
+        admit();
+    };
+    auto decode = [&](const JobPtr& job){
+        const BatchEntry& entry = entries[job->index];
+        bool ok = false;
+        try
+        {
+            job->image0 = cache.get(entry.image0);
+            job->image1 = cache.get(entry.image1);
+            ok = loadMatches(entry.matches, job->points0, job->points1, job->correspondences, job->energy);
+            if(!ok) fail(job->index, "cannot load the matches " + entry.matches);
+        }
+        catch(const std::exception& e)
+        {
+            fail(job->index, e.what());
+        }
+        catch(...)
+        {
+            fail(job->index, "cannot decode the images");
+        }
+        if(!ok)
+        {
+            admit();
+            return;
+        }
+        pool.submit([job, &render](){render(job);});
+    };
+    admit = [&](){
+        const size_t n = next++;
+        if(n >= entries.size()) return;
+        JobPtr job(new Job);
+        job->index = n;
+        pool.submit([job, &decode](){decode(job);});
+    };
+
+    for(int k = 0; k < 2*pool.numberOfWorkers(); ++k) admit();
+    pool.wait();
+    encoder.finish();
+
+    BatchReport report;
+    report.numPairs = (int)entries.size();
+    report.numFailed = numFailed + (int)encoder.numberOfFailed();
+    report.numWorkers = pool.numberOfWorkers();
+    report.numSteals = pool.numberOfSteals();
+    report.numCacheHits = cache.hits()-hits0;
+    report.numCacheMisses = cache.misses()-misses0;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+#endif
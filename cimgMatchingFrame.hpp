@@ -0,0 +1,215 @@
+#ifndef cimgMatchingFrame
+#define cimgMatchingFrame
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cimgLabelLayout.hpp"
+#include "cimgMatchingSegments.hpp"
+#include <CImg.h>
+
+static const unsigned char _colorPt[3] = {255, 0, 0};     //!< Color for points
+static const unsigned char _colorLine[3] = {0, 0, 255};   //!< Color for lines
+static const unsigned char _colorLineCurrent[3] = {255, 0, 0};   //!< Color for lines of current correspondences
+static const unsigned char _colorLineNew[3] = {0, 0, 255};   //!< Color for lines of new correspondences
+static const unsigned char _colorTextBg[3] = {255, 255, 255};     //!< Color for background of text area
+static const unsigned char _colorTextFg[3] = {0, 0, 0};     //!< Color for foreground of text area
+
+///
+/// \brief The MatchingStyle struct
+/// The colors and sizes a frame is drawn with. The colors are held by value.
+struct MatchingStyle
+{
+    unsigned char colorPt[3];           //!< Color of the markers.
+    unsigned char colorLine[2][3];      //!< Color of the lines, indexed by the label of the correspondence.
+    unsigned char colorTextFg[3];       //!< Color of the caption text.
+    unsigned char colorTextBg[3];       //!< Color of the caption background.
+    int radius;                         //!< Radius of the markers; the lines are \c radius/2 thick.
+    bool flagMarkers;                   //!< A flag indicating the markers are drawn.
+    int fontSize;                       //!< Height of the caption, 0 for no caption.
+    int pointLabels;                    //!< The labels drawn next to the markers (\c PointLabel), 0 for none.
+    LabelPriority labelPriority;        //!< The order in which the labels are placed, those overlapping culled.
+
+    //! Default constructor
+    MatchingStyle(
+        const unsigned char colorPt_[] = _colorPt,
+        const unsigned char colorLine0[] = _colorLine,
+        const unsigned char colorLine1[] = _colorLine
+    ):
+        radius(4),
+        flagMarkers(true),
+        fontSize(25),
+        pointLabels(0),
+        labelPriority(PRIORITY_ENERGY_HIGH)
+    {
+        std::copy(colorPt_, colorPt_+3, colorPt);
+        std::copy(colorLine0, colorLine0+3, colorLine[0]);
+        std::copy(colorLine1, colorLine1+3, colorLine[1]);
+        std::copy(_colorTextFg, _colorTextFg+3, colorTextFg);
+        std::copy(_colorTextBg, _colorTextBg+3, colorTextBg);
+    }
+};
+
+///
+/// \brief The MatchingFrame struct
+/// An immutable description of a frame: what \c drawMatchingFrame draws, held by value,
+/// so that frames recorded at different iterations can be rendered concurrently.
+template <typename TP>
+struct MatchingFrame
+{
+    cimg_library::CImgList<TP> points;          //!< points(0), points(1): the point sets on the two images.
+    cimg_library::CImg<int> correspondences;    //!< The point-to-point correspondences.
+    std::vector<double> energy;                 //!< Energy of each correspondence.
+    std::vector<unsigned char> labels;          //!< Line color of each correspondence, empty for all 0.
+    int numDraw;                                //!< The last correspondence drawn and captioned.
+    std::string title;                          //!< Title drawn at the bottom, empty for none.
+    MatchingStyle style;
+
+    //! Default constructor
+    MatchingFrame(void):
+        points(2),
+        numDraw(-1)
+    {}
+    //! describes the correspondences up to \c numDraw of \c points0 and \c points1.
+    MatchingFrame(
+        const cimg_library::CImg<TP>& points0,
+        const cimg_library::CImg<TP>& points1,
+        const cimg_library::CImg<int>& correspondences_,
+        const std::vector<double>& energy_,
+        const int numDraw_
+    ):
+        points(points0, points1),
+        correspondences(correspondences_),
+        energy(energy_),
+        numDraw(numDraw_)
+    {}
+};
+
+///
+/// \brief drawMatchingCaption
+/// draws the caption of the correspondence \c numDraw, between the points \c c0 and \c c1, and the title \c strTitle.
+template <typename TI>
+void drawMatchingCaption(
+    cimg_library::CImg<TI>& img,
+    const int numDraw,
+    const int c0,
+    const int c1,
+    const double energy,
+    const std::string& strTitle,
+    const MatchingStyle& style = MatchingStyle()
+)
+{
+    if(style.fontSize <= 0) return;
+
+    /// draw energy
+    int fontsize = style.fontSize;
+    std::stringstream ss;
+    ss << "correspondence#";
+    if(numDraw>=0)
+    {
+        ss << numDraw << " = (";
+        if(c0>=0)   ss << "p" << c0;
+        else        ss << "-";
+        ss << ",";
+        if(c1>=0)   ss << "q" << c1;
+        else        ss << "-";
+        ss << ") = " << energy;
+    }
+    img.draw_text(0, 0, ss.str().c_str(), style.colorTextFg, style.colorTextBg, 1, fontsize);
+
+    /// draw title
+    if(strTitle.length()>0)
+    {
+        img.draw_text( (img.width()-strTitle.length()*fontsize)/2, img.height()-fontsize*2, strTitle.c_str(), style.colorTextFg, style.colorTextBg, 1, fontsize*2);
+    }
+}
+
+//! appends to \c rects the rectangles of an image of \c width x \c height pixels, offset by \c dy, that
+//! \c drawMatchingCaption may draw in, with a title if \c flagTitle is true.
+inline void captionRects(
+    std::vector<FrameRect>& rects,
+    const int width,
+    const int height,
+    const bool flagTitle,
+    const MatchingStyle& style = MatchingStyle(),
+    const int dy = 0
+)
+{
+    if(style.fontSize <= 0) return;
+    rects.push_back(FrameRect(0, dy, width-1, dy + std::min(2*style.fontSize, height)-1));
+    if(flagTitle) rects.push_back(FrameRect(0, dy + std::max(height-2*style.fontSize, 0), width-1, dy+height-1));
+}
+
+///
+/// \brief drawMatchingLabels
+/// draws the labels \c style.pointLabels of the first \c n \c segments next to their markers, out of the caption,
+/// with a title if \c flagTitle is true; the labels overlapping others of higher priority are culled.
+/// Returns the number of labels drawn.
+template <typename TI>
+size_t drawMatchingLabels(
+    cimg_library::CImg<TI>& img,
+    const MatchingSegment* segments,
+    const size_t n,
+    const bool flagTitle,
+    const MatchingStyle& style
+)
+{
+    if(style.pointLabels == 0 || n == 0) return 0;
+    LabelLayout layout;
+    layout.reset(img.width(), img.height());
+    std::vector<FrameRect> caption;
+    captionRects(caption, img.width(), img.height(), flagTitle, style);
+    for(size_t k = 0; k < caption.size(); ++k) layout.occupy(caption[k]);
+    return drawLabels(img, segments, n, style.pointLabels, style.labelPriority, style.radius,
+                      style.colorTextFg, style.colorTextBg, layout);
+}
+
+///
+/// \brief drawMatchingFrame
+/// draws \c frame on \c img, the second image being drawn at the x offset \c offset.
+/// It reads nothing but its arguments, so frames can be drawn on distinct images concurrently.
+template <typename TI, typename TP>
+void drawMatchingFrame(
+    cimg_library::CImg<TI>& img,
+    const MatchingFrame<TP>& frame,
+    const int offset
+)
+{
+    const int numCorrespondences = frame.correspondences.width();
+    std::vector<MatchingSegment> segments;
+    if(frame.energy.size() >= (size_t)numCorrespondences)
+    {
+        resolveSegments(segments, frame.points(0), frame.points(1), frame.correspondences, frame.energy, offset);
+    }
+    else
+    {
+        resolveSegments(segments, frame.points(0), frame.points(1), frame.correspondences, std::vector<double>(numCorrespondences, 0.0), offset);
+    }
+    if(!frame.labels.empty())
+    {
+        for(auto it = segments.begin(); it != segments.end(); ++it) it->label = frame.labels[it->index] != 0;
+    }
+
+    /// draw matching
+    const unsigned char* colorLines[] = {frame.style.colorLine[0], frame.style.colorLine[1]};
+    const size_t n = numberOfSegments(segments, frame.numDraw);
+    if(n > 0)
+    {
+        drawSegments(img, &segments[0], &segments[0]+n, frame.style.colorPt, colorLines, frame.style.radius, frame.style.flagMarkers);
+        drawMatchingLabels(img, &segments[0], n, !frame.title.empty(), frame.style);
+    }
+
+    /// draw caption
+    int c0 = -1, c1 = -1;
+    double e = 0.0;
+    if(frame.numDraw>=0 && frame.numDraw<numCorrespondences)
+    {
+        c0 = frame.correspondences(frame.numDraw,0);
+        c1 = frame.correspondences(frame.numDraw,1);
+        e = frame.numDraw < (int)frame.energy.size() ? frame.energy[frame.numDraw] : 0.0;
+    }
+    drawMatchingCaption(img, frame.numDraw, c0, c1, e, frame.title, frame.style);
+}
+
+#endif
@@ -0,0 +1,566 @@
+#ifndef cimgMatchingIO
+#define cimgMatchingIO
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "cimgParallel.hpp"
+#include <CImg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CIMG_MATCHING_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+///
+/// \brief Loaders of point sets, correspondences and energies
+/// Two file formats are read; the format is detected from the first bytes of the file.
+///
+/// Text (CSV): one record per line, values separated by commas, semicolons or white spaces.
+///   points:           x,y
+///   correspondences:  i0,i1
+///   energy:           e
+///   matches:          x0,y0,x1,y1,e
+/// Empty lines and lines not starting with a number (e.g. a header or a '#' comment) are skipped.
+/// A value nan or inf is an error, reported with its line, rather than a line skipped.
+///
+/// Binary: a 16-byte little-endian header followed by the values, row by row as CImg stores them
+/// (all x then all y for points, all i0 then all i1 for correspondences).
+///   char[4]  magic "CMVB"
+///   uint8    scalar type: 'i' (int32), 'f' (float32) or 'd' (float64)
+///   uint8    number of rows: 2 for points and correspondences, 1 for energy, 5 for matches
+///   uint16   reserved (0)
+///   uint64   number of records
+///
+/// Text files are split into one chunk per thread at line boundaries; each thread counts its records,
+/// then parses them directly into the destination buffer at its offset.
+
+static const char _matchingBinaryMagic[4] = {'C', 'M', 'V', 'B'};   //!< Magic number of the binary format
+
+///
+/// \brief The MappedFile class
+/// A read-only view of a whole file, memory-mapped when the platform allows it.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path):
+        _data(0),
+        _size(0),
+        _mapped(false)
+    {
+#ifdef CIMG_MATCHING_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return;
+        struct stat st;
+        st.st_size = 0;
+        if(::fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void* p = ::mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED)
+            {
+                ::madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                _data = (const char*)p;
+                _size = (size_t)st.st_size;
+                _mapped = true;
+            }
+        }
+        ::close(fd);
+        if(_mapped || st.st_size == 0) return;
+#endif
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if(!file) return;
+        std::fseek(file, 0, SEEK_END);
+        const long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        if(size > 0)
+        {
+            _buffer.resize((size_t)size);
+            _size = std::fread(&_buffer[0], 1, (size_t)size, file);
+            _data = &_buffer[0];
+        }
+        std::fclose(file);
+    }
+    ~MappedFile(void)
+    {
+#ifdef CIMG_MATCHING_MMAP
+        if(_mapped) ::munmap((void*)_data, _size);
+#endif
+    }
+
+    //! returns true if the file has been read and is not empty.
+    bool isOpen(void) const {return _data != 0;}
+    const char* data(void) const {return _data;}
+    size_t size(void) const {return _size;}
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* _data;
+    size_t _size;
+    bool _mapped;
+    std::vector<char> _buffer;
+};
+
+//------------------------------------------
+//
+//! \name Text parsing
+//@{
+
+//! returns true if \c c may start a number.
+inline bool isNumberStart(const char c)
+{
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+//! returns true if \c c separates two values of a record.
+inline bool isSeparator(const char c)
+{
+    return c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r';
+}
+
+//! returns the length of the value nan, inf or infinity at \c p, signed and in any case, 0 if there is none.
+inline size_t nonFiniteLength(const char* p, const char* end)
+{
+    static const char* const words[] = {"infinity", "inf", "nan"};
+    const char* q = p;
+    if(q < end && (*q == '-' || *q == '+')) ++q;
+    for(int w = 0; w < 3; ++w)
+    {
+        const size_t n = std::strlen(words[w]);
+        if((size_t)(end-q) < n) continue;
+        size_t i = 0;
+        while(i < n && (q[i] | 0x20) == words[w][i]) ++i;
+        if(i == n && (q+n == end || isSeparator(q[n]))) return (size_t)(q+n-p);
+    }
+    return 0;
+}
+
+//! returns the number [p,q) parsed by \c strtod.
+inline double parseNumberLibrary(const char* p, const char* q)
+{
+    char buf[128];
+    const size_t len = (size_t)(q-p);
+    if(len >= sizeof(buf)) return std::strtod(std::string(p, q).c_str(), 0);
+    std::memcpy(buf, p, len);
+    buf[len] = '\0';
+    return std::strtod(buf, 0);
+}
+
+///
+/// \brief parseNumber
+/// parses a decimal number at \c p, not beyond \c end, and advances \c p past it.
+/// Numbers whose mantissa fits the 53 bits of a double and whose power of ten is exact are parsed without a
+/// library call, rounded once as \c strtod does; the others are handed to \c strtod, as are nan and inf,
+/// left to the caller to reject. Returns false if no number is found.
+inline bool parseNumber(const char*& p, const char* end, double& value)
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const size_t lenNonFinite = nonFiniteLength(p, end);
+    if(lenNonFinite > 0)
+    {
+        value = parseNumberLibrary(p, p+lenNonFinite);
+        p += lenNonFinite;
+        return true;
+    }
+    const char* q = p;
+    bool negative = false;
+    if(q < end && (*q == '-' || *q == '+')) negative = (*q++ == '-');
+    unsigned long long mantissa = 0;
+    int digits = 0, scale = 0;
+    for(; q < end && *q >= '0' && *q <= '9'; ++q, ++digits) mantissa = mantissa*10 + (*q-'0');
+    if(q < end && *q == '.')
+    {
+        for(++q; q < end && *q >= '0' && *q <= '9'; ++q, ++digits, --scale) mantissa = mantissa*10 + (*q-'0');
+    }
+    if(digits == 0) return false;
+    if(q < end && (*q == 'e' || *q == 'E'))
+    {
+        const char* r = q+1;
+        bool negativeExp = false;
+        if(r < end && (*r == '-' || *r == '+')) negativeExp = (*r++ == '-');
+        if(r < end && *r >= '0' && *r <= '9')
+        {
+            int e = 0;
+            for(; r < end && *r >= '0' && *r <= '9'; ++r) e = std::min(e*10 + (*r-'0'), 10000);
+            scale += negativeExp ? -e : e;
+            q = r;
+        }
+    }
+    // beyond 19 digits the mantissa may have wrapped
+    if(digits > 19 || mantissa > (1ull << 53) || scale < -22 || scale > 22)
+    {
+        value = parseNumberLibrary(p, q);
+    }
+    else
+    {
+        value = (double)mantissa;
+        value = scale < 0 ? value/pow10[-scale] : value*pow10[scale];
+        if(negative) value = -value;
+    }
+    p = q;
+    return true;
+}
+
+//! returns true if the line [p,end) holds a record, i.e. its first non-blank character starts a number,
+//! or its first value is nan or inf.
+inline bool isRecord(const char* p, const char* end)
+{
+    while(p < end && isSeparator(*p)) ++p;
+    return p < end && (isNumberStart(*p) || nonFiniteLength(p, end) > 0);
+}
+
+///
+/// \brief parseText
+/// parses the records of a text file into \c rows x \c count values,
+/// the value r of the record m being stored at \c dst(m, r).
+/// \c dst is resized by \c resize(count) before the values are written.
+/// Returns false if a record is malformed or holds a value nan or infinite, described with the line of the
+/// first one in \c error.
+template <typename T, typename Resize>
+bool parseText(
+    const MappedFile& file,
+    const int rows,
+    T* (*dstRow)(void*, int),
+    void* dst,
+    Resize resize,
+    std::string& error
+)
+{
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    const int numChunks = file.size() < (1u << 20) ? 1 : numberOfThreads()*4;
+
+    // split at line boundaries
+    std::vector<const char*> bounds(numChunks+1, end);
+    bounds[0] = begin;
+    for(int k = 1; k < numChunks; ++k)
+    {
+        const char* p = begin + file.size()/numChunks*k;
+        p = std::max(p, bounds[k-1]);
+        const char* nl = (const char*)std::memchr(p, '\n', end-p);
+        bounds[k] = nl ? nl+1 : end;
+    }
+
+    // count the records and the lines of each chunk
+    std::vector<long long> offsets(numChunks+1, 0), lines(numChunks+1, 0);
+    parallelFor(numChunks, [&](const int k){
+        long long n = 0, l = 0;
+        for(const char* p = bounds[k]; p < bounds[k+1]; ++l)
+        {
+            const char* nl = (const char*)std::memchr(p, '\n', bounds[k+1]-p);
+            const char* eol = nl ? nl : bounds[k+1];
+            n += isRecord(p, eol);
+            p = eol+1;
+        }
+        offsets[k+1] = n;
+        lines[k+1] = l;
+    });
+    for(int k = 0; k < numChunks; ++k)
+    {
+        offsets[k+1] += offsets[k];
+        lines[k+1] += lines[k];
+    }
+    const long long count = offsets[numChunks];
+    resize((size_t)count);
+
+    // parse each chunk at its offset, keeping its first error: 1 for a malformed record, 2 for a value not finite
+    std::vector<char> errors(numChunks, 0);
+    std::vector<long long> errorLines(numChunks, 0);
+    parallelFor(numChunks, [&](const int k){
+        std::vector<T*> row(rows);
+        for(int r = 0; r < rows; ++r) row[r] = dstRow(dst, r);
+        long long m = offsets[k], l = lines[k];
+        for(const char* p = bounds[k]; p < bounds[k+1]; ++l)
+        {
+            const char* nl = (const char*)std::memchr(p, '\n', bounds[k+1]-p);
+            const char* eol = nl ? nl : bounds[k+1];
+            if(isRecord(p, eol))
+            {
+                for(int r = 0; r < rows; ++r)
+                {
+                    while(p < eol && isSeparator(*p)) ++p;
+                    double v;
+                    const char e = !parseNumber(p, eol, v) ? 1 : !std::isfinite(v) ? 2 : 0;
+                    if(e != 0)
+                    {
+                        if(errors[k] == 0)
+                        {
+                            errors[k] = e;
+                            errorLines[k] = l+1;
+                        }
+                        v = 0;
+                    }
+                    row[r][m] = (T)v;
+                }
+                ++m;
+            }
+            p = eol+1;
+        }
+    });
+    for(int k = 0; k < numChunks; ++k)
+    {
+        if(errors[k] == 0) continue;
+        error = std::string(errors[k] == 1 ? "malformed record" : "value not finite") + " at line " + std::to_string(errorLines[k]);
+        return false;
+    }
+    return true;
+}
+//@}
+
+//------------------------------------------
+//
+//! \name Binary parsing
+//@{
+
+//! returns true if \c file starts with the header of the binary format.
+inline bool isMatchingBinary(const MappedFile& file)
+{
+    return file.size() >= 16 && std::memcmp(file.data(), _matchingBinaryMagic, 4) == 0;
+}
+
+//! reads a little-endian unsigned integer of \c n bytes.
+inline unsigned long long readLittleEndian(const char* p, const int n)
+{
+    unsigned long long v = 0;
+    for(int k = n-1; k >= 0; --k) v = (v << 8) | (unsigned char)p[k];
+    return v;
+}
+
+//! returns true if the platform stores integers and floats in little-endian order.
+inline bool isLittleEndian(void)
+{
+    const unsigned int one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+//! converts \c count little-endian values of the type \c S at \c src into \c dst.
+template <typename S, typename T>
+void convertBinary(const char* src, T* dst, const size_t count)
+{
+    if(sizeof(S) == sizeof(T) && (S)0.5 == (T)0.5 && isLittleEndian())
+    {
+        std::memcpy(dst, src, count*sizeof(T));
+        return;
+    }
+    const int numChunks = count < (1u << 20) ? 1 : numberOfThreads();
+    parallelFor(numChunks, [&](const int k){
+        const size_t b = count/numChunks*k, e = k+1 == numChunks ? count : count/numChunks*(k+1);
+        for(size_t i = b; i < e; ++i)
+        {
+            const unsigned long long bits = readLittleEndian(src + i*sizeof(S), sizeof(S));
+            S v;
+            if(sizeof(S) == 4)
+            {
+                const unsigned int b32 = (unsigned int)bits;
+                std::memcpy(&v, &b32, sizeof(S));
+            }
+            else
+            {
+                std::memcpy(&v, &bits, sizeof(S));
+            }
+            dst[i] = (T)v;
+        }
+    });
+}
+
+///
+/// \brief parseBinary
+/// reads the values of a binary file into \c rows rows.
+/// \c dst is resized by \c resize(count) before the values are written.
+template <typename T, typename Resize>
+bool parseBinary(
+    const MappedFile& file,
+    const int rows,
+    T* (*dstRow)(void*, int),
+    void* dst,
+    Resize resize
+)
+{
+    const char* header = file.data();
+    const char type = header[4];
+    const int fileRows = (unsigned char)header[5];
+    const unsigned long long count = readLittleEndian(header+8, 8);
+    const size_t bytes = type == 'd' ? 8 : 4;
+    // the count is checked against the file before it is multiplied, so a forged header cannot wrap the size;
+    // the records are the columns of a CImg, whose dimensions are int
+    if(fileRows != rows || rows <= 0 || (type != 'i' && type != 'f' && type != 'd') ||
+       count > (file.size()-16)/(rows*bytes) || count > (unsigned long long)INT_MAX)
+    {
+        return false;
+    }
+    resize((size_t)count);
+    for(int r = 0; r < rows; ++r)
+    {
+        const char* src = header + 16 + count*r*bytes;
+        if(type == 'i')         convertBinary<int>(src, dstRow(dst, r), (size_t)count);
+        else if(type == 'f')    convertBinary<float>(src, dstRow(dst, r), (size_t)count);
+        else                    convertBinary<double>(src, dstRow(dst, r), (size_t)count);
+    }
+    return true;
+}
+//@}
+
+//------------------------------------------
+//
+//! \name Loaders
+//@{
+
+//! returns row \c r of a \c cimg_library::CImg<T>.
+template <typename T>
+T* cimgRow(void* img, int r)
+{
+    return ((cimg_library::CImg<T>*)img)->data(0, r);
+}
+
+//! returns the data of a \c std::vector<T>.
+template <typename T>
+T* vectorRow(void* vec, int)
+{
+    std::vector<T>& v = *(std::vector<T>*)vec;
+    return v.empty() ? 0 : &v[0];
+}
+
+///
+/// \brief loadRows
+/// loads a text or binary file into a \c cimg_library::CImg<T> of \c rows rows, one column per record.
+template <typename T>
+bool loadRows(
+    const std::string& path,
+    const int rows,
+    cimg_library::CImg<T>& dst
+)
+{
+    MappedFile file(path);
+    if(!file.isOpen())
+    {
+        std::cerr << "cannot read " << path << std::endl;
+        return false;
+    }
+    auto resize = [&dst, rows](const size_t count){
+        if(count > 0)   dst.assign((unsigned int)count, rows);
+        else            dst.assign();
+    };
+    std::string error = "malformed records";
+    const bool ok = isMatchingBinary(file) ?
+                parseBinary<T>(file, rows, cimgRow<T>, &dst, resize) :
+                parseText<T>(file, rows, cimgRow<T>, &dst, resize, error);
+    if(!ok) std::cerr << error << " in " << path << std::endl;
+    return ok;
+}
+
+//! loads a point set: \c points(m,0) and \c points(m,1) are the coordinates of the m-th point.
+template <typename TP>
+bool loadPoints(
+    const std::string& path,
+    cimg_library::CImg<TP>& points
+)
+{
+    return loadRows(path, 2, points);
+}
+
+//! loads point-to-point correspondences: \c correspondences(m,0/1) index the two point sets.
+inline bool loadCorrespondences(
+    const std::string& path,
+    cimg_library::CImg<int>& correspondences
+)
+{
+    return loadRows(path, 2, correspondences);
+}
+
+//! loads the energy of each correspondence.
+inline bool loadEnergy(
+    const std::string& path,
+    std::vector<double>& energy
+)
+{
+    MappedFile file(path);
+    if(!file.isOpen())
+    {
+        std::cerr << "cannot read " << path << std::endl;
+        return false;
+    }
+    auto resize = [&energy](const size_t count){energy.resize(count);};
+    std::string error = "malformed records";
+    const bool ok = isMatchingBinary(file) ?
+                parseBinary<double>(file, 1, vectorRow<double>, &energy, resize) :
+                parseText<double>(file, 1, vectorRow<double>, &energy, resize, error);
+    if(!ok) std::cerr << error << " in " << path << std::endl;
+    return ok;
+}
+
+///
+/// \brief loadMatches
+/// loads a matching result stored as one record per match: x0,y0,x1,y1,e.
+/// The m-th match becomes the m-th point of both point sets and the correspondence (m,m).
+template <typename TP>
+bool loadMatches(
+    const std::string& path,
+    cimg_library::CImg<TP>& points0,
+    cimg_library::CImg<TP>& points1,
+    cimg_library::CImg<int>& correspondences,
+    std::vector<double>& energy
+)
+{
+    cimg_library::CImg<double> records;
+    if(!loadRows(path, 5, records)) return false;
+    const int n = records.width();
+    points0.assign(n, 2);
+    points1.assign(n, 2);
+    correspondences.assign(n, 2);
+    energy.resize(n);
+    for(int m = 0; m < n; ++m)
+    {
+        points0(m,0) = (TP)records(m,0);
+        points0(m,1) = (TP)records(m,1);
+        points1(m,0) = (TP)records(m,2);
+        points1(m,1) = (TP)records(m,3);
+        correspondences(m,0) = m;
+        correspondences(m,1) = m;
+        energy[m] = records(m,4);
+    }
+    return true;
+}
+
+///
+/// \brief saveRows
+/// saves \c rows x \c count values of the type \c S (int, float or double) in the binary format,
+/// the value r of the record m being read at \c src[r*count+m].
+template <typename S>
+bool saveRows(
+    const std::string& path,
+    const S* src,
+    const int rows,
+    const size_t count
+)
+{
+    assert(
+        isLittleEndian() &&
+        "The binary format is written on little-endian platforms only."
+    );
+    char header[16] = {0};
+    std::memcpy(header, _matchingBinaryMagic, 4);
+    header[4] = sizeof(S) == 8 ? 'd' : (S)0.5 == 0 ? 'i' : 'f';
+    header[5] = (char)rows;
+    for(int k = 0; k < 8; ++k) header[8+k] = (char)((unsigned long long)count >> (8*k));
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file) return false;
+    bool ok = std::fwrite(header, 1, 16, file) == 16 &&
+              std::fwrite(src, sizeof(S), rows*count, file) == rows*count;
+    return std::fclose(file) == 0 && ok;
+}
+//@}
+
+#endif
@@ -0,0 +1,475 @@
+#ifndef cimgMatchingSegments
+#define cimgMatchingSegments
+
+#include <algorithm>
+#include <vector>
+#include "cimgDrawLineThick.hpp"
+#include "cimgPixelKernels.hpp"
+#include <CImg.h>
+
+///
+/// \brief The MatchingSegment struct
+/// A point-to-point correspondence resolved into drawing coordinates.
+/// Segments are stored in a packed array ordered by \c index, so that
+/// every panel and every frame can reuse them without looking up the
+/// point sets again. The ends are kept in 24.8 fixed point, converted once from
+/// subpixel points, and rounded to the nearest pixel.
+struct MatchingSegment
+{
+    int x0;         //!< x coordinate on the first image.
+    int y0;         //!< y coordinate on the first image.
+    int x1;         //!< x coordinate on the second image, including the offset.
+    int y1;         //!< y coordinate on the second image.
+    int fx0;        //!< x coordinate on the first image in 24.8 fixed point.
+    int fy0;        //!< y coordinate on the first image in 24.8 fixed point.
+    int fx1;        //!< x coordinate on the second image in 24.8 fixed point, including the offset.
+    int fy1;        //!< y coordinate on the second image in 24.8 fixed point.
+    double energy;  //!< Energy of the correspondence.
+    int label;      //!< Label selecting the line color (e.g. 0: current, 1: new).
+    int index;      //!< Index of the correspondence.
+};
+
+//! sets the ends of \c s to (fx0,fy0) and (fx1,fy1) in 24.8 fixed point, and to the pixels nearest to them.
+inline void segmentEnds(
+    MatchingSegment& s,
+    const int fx0,
+    const int fy0,
+    const int fx1,
+    const int fy1
+)
+{
+    s.fx0 = fx0; s.fy0 = fy0; s.fx1 = fx1; s.fy1 = fy1;
+    s.x0 = fromSubpixel(fx0); s.y0 = fromSubpixel(fy0);
+    s.x1 = fromSubpixel(fx1); s.y1 = fromSubpixel(fy1);
+}
+
+//! sets the ends of \c s to the points (x0,y0) and (x1,y1) of the images, converted to 24.8 fixed point,
+//! the second one shifted by \c offset pixels.
+template <typename TP>
+inline void segmentEnds(
+    MatchingSegment& s,
+    const TP x0,
+    const TP y0,
+    const TP x1,
+    const TP y1,
+    const int offset
+)
+{
+    segmentEnds(s, toSubpixel(x0), toSubpixel(y0), toSubpixel(x1) + offset*(1 << subpixelBits), toSubpixel(y1));
+}
+
+///
+/// \brief resolveSegments
+/// resolves the \c numCorrespondences valid correspondences from the points \c c0[m] to the points \c c1[m]
+/// into \c segments, e.g. a row of correspondences stored with others.
+/// Correspondences referring to a point out of \c points0 or \c points1 are dropped.
+/// The filter is branch-free; every entry is written and only the valid ones are kept.
+template <typename TP>
+void resolveSegments(
+    std::vector<MatchingSegment>& segments,
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const int* c0,
+    const int* c1,
+    const int numCorrespondences,
+    const double* energy,
+    const int offset,
+    const int label = 0
+)
+{
+    if(numCorrespondences == 0 || points0.width() == 0 || points1.width() == 0)
+    {
+        segments.clear();
+        return;
+    }
+    assert(
+        points0.height() == 2 &&
+        points1.height() == 2 &&
+        "The dimensionality of the point sets must be 2."
+    );
+
+    const TP *px0 = points0.data(0,0), *py0 = points0.data(0,1);
+    const TP *px1 = points1.data(0,0), *py1 = points1.data(0,1);
+    const unsigned int w0 = points0.width(), w1 = points1.width();
+
+    segments.resize(numCorrespondences);
+    MatchingSegment* s = &segments[0];
+    int k = 0;
+    for(int m = 0; m < numCorrespondences; ++m)
+    {
+        // negative indices wrap around and fail the range check
+        const unsigned int i0 = c0[m], i1 = c1[m];
+        const bool valid = i0 < w0 && i1 < w1;
+        const unsigned int j0 = valid ? i0 : 0, j1 = valid ? i1 : 0;
+        segmentEnds(s[k], px0[j0], py0[j0], px1[j1], py1[j1], offset);
+        s[k].energy = energy[m];
+        s[k].label = label;
+        s[k].index = m;
+        k += valid;
+    }
+    segments.resize(k);
+}
+
+///
+/// \brief resolveSegments
+/// resolves the valid correspondences \c correspondences(m,0/1) into \c segments.
+/// Correspondences referring to a point out of \c points0 or \c points1 are dropped.
+template <typename TP>
+void resolveSegments(
+    std::vector<MatchingSegment>& segments,
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const cimg_library::CImg<int>& correspondences,
+    const std::vector<double>& energy,
+    const int offset,
+    const int label = 0
+)
+{
+    const int numCorrespondences = correspondences.width();
+    if(numCorrespondences == 0)
+    {
+        segments.clear();
+        return;
+    }
+    assert(
+        correspondences.height() == 2 &&
+        "The correspondences must have two points."
+    );
+    assert(
+        energy.size() >= (size_t)numCorrespondences &&
+        "Each point-to-point correspondences must be assigned its energy."
+    );
+    resolveSegments(segments, points0, points1, correspondences.data(0,0), correspondences.data(0,1),
+                    numCorrespondences, &energy[0], offset, label);
+}
+
+///
+/// \brief resolveSegments
+/// resolves the fused correspondences into \c segments.
+/// The second point is taken from \c correspondencesNew when \c correspondencesFusion(m,1)==1,
+/// and from \c correspondencesCurrent otherwise. The label is set to 1 and 0, respectively.
+template <typename TP>
+void resolveSegments(
+    std::vector<MatchingSegment>& segments,
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const cimg_library::CImg<int>& correspondencesCurrent,
+    const cimg_library::CImg<int>& correspondencesNew,
+    const cimg_library::CImg<int>& correspondencesFusion,
+    const std::vector<double>& energyFusion,
+    const int offset
+)
+{
+    const int numCorrespondences = correspondencesFusion.width();
+    if(numCorrespondences == 0 || points0.width() == 0 || points1.width() == 0)
+    {
+        segments.clear();
+        return;
+    }
+    assert(
+        correspondencesCurrent.width() >= numCorrespondences &&
+        correspondencesNew.width() >= numCorrespondences &&
+        "The fused correspondences must not outnumber the current and new ones."
+    );
+    assert(
+        energyFusion.size() >= (size_t)numCorrespondences &&
+        "Each point-to-point correspondences must be assigned its energy."
+    );
+
+    const int *cf0 = correspondencesFusion.data(0,0), *cf1 = correspondencesFusion.data(0,1);
+    const int *cc1 = correspondencesCurrent.data(0,1), *cn1 = correspondencesNew.data(0,1);
+    const TP *px0 = points0.data(0,0), *py0 = points0.data(0,1);
+    const TP *px1 = points1.data(0,0), *py1 = points1.data(0,1);
+    const unsigned int w0 = points0.width(), w1 = points1.width();
+
+    segments.resize(numCorrespondences);
+    MatchingSegment* s = &segments[0];
+    int k = 0;
+    for(int m = 0; m < numCorrespondences; ++m)
+    {
+        const int flagFusion = (cf1[m] == 1);
+        const unsigned int i0 = cf0[m], i1 = flagFusion ? cn1[m] : cc1[m];
+        const bool valid = i0 < w0 && i1 < w1;
+        const unsigned int j0 = valid ? i0 : 0, j1 = valid ? i1 : 0;
+        segmentEnds(s[k], px0[j0], py0[j0], px1[j1], py1[j1], offset);
+        s[k].energy = energyFusion[m];
+        s[k].label = flagFusion;
+        s[k].index = m;
+        k += valid;
+    }
+    segments.resize(k);
+}
+
+///
+/// \brief resolveSegments
+/// resolves the correspondences fused from the \c proposals.height() proposals into \c segments.
+/// The correspondence \c m goes from the point \c c0[m] to the point \c proposals(m,labels[m]) of the proposal
+/// it was fused from, labeled \c labels[m]; labels beyond the proposals mean no correspondence.
+/// Only the selected proposal of each correspondence is read.
+template <typename TP>
+void resolveSegments(
+    std::vector<MatchingSegment>& segments,
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const int* c0,
+    const cimg_library::CImg<int>& proposals,
+    const unsigned char* labels,
+    const double* energy,
+    const int offset
+)
+{
+    const int numCorrespondences = proposals.width();
+    if(numCorrespondences == 0 || proposals.height() == 0 || points0.width() == 0 || points1.width() == 0)
+    {
+        segments.clear();
+        return;
+    }
+
+    const int* target = proposals.data();
+    const TP *px0 = points0.data(0,0), *py0 = points0.data(0,1);
+    const TP *px1 = points1.data(0,0), *py1 = points1.data(0,1);
+    const unsigned int w0 = points0.width(), w1 = points1.width(), numProposals = proposals.height();
+
+    segments.resize(numCorrespondences);
+    MatchingSegment* s = &segments[0];
+    int k = 0;
+    for(int m = 0; m < numCorrespondences; ++m)
+    {
+        const unsigned int l = labels[m];
+        const bool fused = l < numProposals;
+        const unsigned int i0 = c0[m], i1 = target[(size_t)(fused ? l : 0)*numCorrespondences + m];
+        const bool valid = fused && i0 < w0 && i1 < w1;
+        const unsigned int j0 = valid ? i0 : 0, j1 = valid ? i1 : 0;
+        segmentEnds(s[k], px0[j0], py0[j0], px1[j1], py1[j1], offset);
+        s[k].energy = energy[m];
+        s[k].label = (int)l;
+        s[k].index = m;
+        k += valid;
+    }
+    segments.resize(k);
+}
+
+//! returns the number of segments whose correspondence index is not greater than \c numDraw.
+inline size_t numberOfSegments(
+    const std::vector<MatchingSegment>& segments,
+    const int numDraw
+)
+{
+    return std::upper_bound(segments.begin(), segments.end(), numDraw,
+        [](const int n, const MatchingSegment& segment){return n < segment.index;}) - segments.begin();
+}
+
+///
+/// \brief diffSegments
+/// appends to \c changed the segments that differ between \c previous and \c segments, both ordered by index:
+/// the previous version of the removed and changed ones, then the new version of the added and changed ones
+/// at the same position, so that \c changed covers every pixel the difference may touch.
+/// The energies are compared only if \c flagEnergy is true, i.e. if they set the drawing order.
+/// Returns the number of correspondences removed, added or changed.
+inline size_t diffSegments(
+    std::vector<MatchingSegment>& changed,
+    const MatchingSegment* previous,
+    const size_t numPrevious,
+    const MatchingSegment* segments,
+    const size_t numSegments,
+    const bool flagEnergy
+)
+{
+    size_t i = 0, j = 0, numChanges = 0;
+    while(i < numPrevious || j < numSegments)
+    {
+        const MatchingSegment* a = i < numPrevious ? previous+i : 0;
+        const MatchingSegment* b = j < numSegments ? segments+j : 0;
+        if(a && b && a->index == b->index)
+        {
+            ++i; ++j;
+            if(a->fx0 == b->fx0 && a->fy0 == b->fy0 && a->fx1 == b->fx1 && a->fy1 == b->fy1 &&
+               a->label == b->label && (!flagEnergy || a->energy == b->energy)) continue;
+            changed.push_back(*a);
+            changed.push_back(*b);
+        }
+        else if(a && (!b || a->index < b->index))
+        { // removed
+            changed.push_back(*a);
+            ++i;
+        }
+        else
+        { // added
+            changed.push_back(*b);
+            ++j;
+        }
+        ++numChanges;
+    }
+    return numChanges;
+}
+
+///
+/// \brief The SegmentOrder enum
+/// The order in which \c orderSegments arranges the segments for progressive drawing.
+enum SegmentOrder
+{
+    ORDER_INDEX,    //!< By correspondence index.
+    ORDER_ENERGY,   //!< From the highest to the lowest energy.
+    ORDER_SPATIAL   //!< A stratified sample: one segment per cell of a grid over the first image, round after round.
+};
+
+///
+/// \brief orderSegments
+/// copies the segments whose correspondence index is not greater than \c numDraw into \c ordered, in the order \c order,
+/// so that any prefix of \c ordered is a representative partial frame.
+inline void orderSegments(
+    std::vector<MatchingSegment>& ordered,
+    const std::vector<MatchingSegment>& segments,
+    const int numDraw,
+    const SegmentOrder order
+)
+{
+    const size_t n = numberOfSegments(segments, numDraw);
+    ordered.assign(segments.begin(), segments.begin()+n);
+    if(order == ORDER_ENERGY)
+    {
+        std::stable_sort(ordered.begin(), ordered.end(),
+            [](const MatchingSegment& a, const MatchingSegment& b){return a.energy > b.energy;});
+    }
+    else if(order == ORDER_SPATIAL && n > 0)
+    {
+        // bucket the segments by grid cell, then take one segment of each cell per round
+        const int grid = 16;
+        int xmin = segments[0].x0, xmax = xmin, ymin = segments[0].y0, ymax = ymin;
+        for(size_t m = 0; m < n; ++m)
+        {
+            xmin = std::min(xmin, segments[m].x0); xmax = std::max(xmax, segments[m].x0);
+            ymin = std::min(ymin, segments[m].y0); ymax = std::max(ymax, segments[m].y0);
+        }
+        const long long w = xmax-xmin+1, h = ymax-ymin+1;
+        std::vector<int> cell(n);
+        std::vector<size_t> start(grid*grid+1, 0);
+        for(size_t m = 0; m < n; ++m)
+        {
+            cell[m] = (int)((segments[m].y0-ymin)*grid/h)*grid + (int)((segments[m].x0-xmin)*grid/w);
+            ++start[cell[m]+1];
+        }
+        for(int c = 0; c < grid*grid; ++c) start[c+1] += start[c];
+        std::vector<size_t> bucket(n), fill(start.begin(), start.end()-1);
+        for(size_t m = 0; m < n; ++m) bucket[fill[cell[m]]++] = m;
+        std::vector<size_t> next(start.begin(), start.end()-1);
+        for(size_t k = 0; k < n; )
+        {
+            for(int c = 0; c < grid*grid; ++c)
+            {
+                if(next[c] < start[c+1]) ordered[k++] = segments[bucket[next[c]++]];
+            }
+        }
+    }
+}
+
+///
+/// \brief drawSegments
+/// draws the segments [\c first, \c last) through the generic \c cimg_library::CImg drawing functions.
+/// \c colorLine is indexed by the label of each segment.
+/// The markers at both ends are omitted when \c flagMarkers is false.
+template <typename T>
+void drawSegments(
+    cimg_library::CImg<T>& img,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const int radius,
+    const bool flagMarkers,
+    const PixelFormatGeneric<T>&
+)
+{
+    for(const MatchingSegment* it = first; it != last; ++it)
+    {
+        draw_line_thick(img, it->x0, it->y0, it->x1, it->y1, colorLine[it->label], radius/2);
+        if(!flagMarkers) continue;
+        img.draw_circle(it->x0, it->y0, radius, colorPt, 1.f);
+        img.draw_circle(it->x1, it->y1, radius, colorPt, 1.f);
+    }
+}
+
+///
+/// \brief drawSegments
+/// draws the segments [\c first, \c last) on a canvas of the pixel format \c F, at their subpixel ends.
+template <typename F>
+void drawSegments(
+    const PixelCanvas<F>& canvas,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const int radius = 4,
+    const bool flagMarkers = true
+)
+{
+    const PixelColor<F> cPt(colorPt);
+    for(const MatchingSegment* it = first; it != last; ++it)
+    {
+        drawCapsuleSubpixel(canvas, it->fx0, it->fy0, it->fx1, it->fy1, radius/2, PixelColor<F>(colorLine[it->label]), 256);
+        if(!flagMarkers) continue;
+        drawDiscSubpixel(canvas, it->fx0, it->fy0, radius, cPt, 256);
+        drawDiscSubpixel(canvas, it->fx1, it->fy1, radius, cPt, 256);
+    }
+}
+
+//! draws the segments on \c img through the pixel format \c F when \c img is stored in that format.
+template <typename T, typename F>
+void drawSegments(
+    cimg_library::CImg<T>& img,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const int radius,
+    const bool flagMarkers,
+    const F&
+)
+{
+    if(hasPixelFormat<F>(img))
+    {
+        drawSegments(pixelCanvas<F>(img), first, last, colorPt, colorLine, radius, flagMarkers);
+    }
+    else
+    {
+        drawSegments(img, first, last, colorPt, colorLine, radius, flagMarkers, PixelFormatGeneric<T>());
+    }
+}
+
+///
+/// \brief drawSegments
+/// draws the segments [\c first, \c last) on \c img.
+/// The pixel format is selected from \c T by \c PixelFormatOf.
+template <typename T>
+void drawSegments(
+    cimg_library::CImg<T>& img,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const int radius = 4,
+    const bool flagMarkers = true
+)
+{
+    drawSegments(img, first, last, colorPt, colorLine, radius, flagMarkers, typename PixelFormatOf<T>::type());
+}
+
+///
+/// \brief drawSegments
+/// draws the segments whose correspondence index is not greater than \c numDraw.
+/// \c colorLine is indexed by the label of each segment.
+template <typename T>
+void drawSegments(
+    cimg_library::CImg<T>& img,
+    const std::vector<MatchingSegment>& segments,
+    const int numDraw,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const int radius = 4
+)
+{
+    const size_t n = numberOfSegments(segments, numDraw);
+    if(n > 0) drawSegments(img, &segments[0], &segments[0]+n, colorPt, colorLine, radius);
+}
+
+#endif
@@ -1,18 +1,32 @@
 #ifndef cimgMatchingViewer
 #define cimgMatchingViewer
 
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
 #include <string>
+#include <sstream>
+#include <vector>
+#include "cimgBrowseScheduler.hpp"
 #include "cimgConvertColor.hpp"
+#include "cimgCpuDispatch.hpp"
 #include "cimgDrawLineThick.hpp"
+#include "cimgEnergyPlot.hpp"
+#include "cimgFrameServer.hpp"
+#include "cimgImageCache.hpp"
+#include "cimgImageSequence.hpp"
+#include "cimgLabelLayout.hpp"
+#include "cimgMatchingFrame.hpp"
+#include "cimgMatchingSegments.hpp"
+#include "cimgParallel.hpp"
+#include "cimgProgressiveRenderer.hpp"
+#include "cimgRegionDisplay.hpp"
+#include "cimgSoftAssignment.hpp"
+#include "cimgTransformRansac.hpp"
 #include <CImg.h>
 
-static const unsigned char _colorPt[3] = {255, 0, 0};     //!< Color for points
-static const unsigned char _colorLine[3] = {0, 0, 255};   //!< Color for lines
-static const unsigned char _colorLineCurrent[3] = {255, 0, 0};   //!< Color for lines of current correspondences
-static const unsigned char _colorLineNew[3] = {0, 0, 255};   //!< Color for lines of new correspondences
-static const unsigned char _colorTextBg[3] = {255, 255, 255};     //!< Color for background of text area
-static const unsigned char _colorTextFg[3] = {0, 0, 0};     //!< Color for foreground of text area
-
 template <typename TI, typename TP>
 class MatchingViewer
 {
@@ -31,7 +45,25 @@ public:
         _points(2),
         _flagDisplay(0),
         _alpha(1.0),
-        _flagDebug(flagDebug)/*,
+        _imagesRevision(0),
+        _flagPreview(false),
+        _previewSize(512),
+        _sequenceIndex(-1),
+        _segmentsDirty(true),
+        _flagDebug(flagDebug),
+        _frameBudget(40.0),
+        _renderOrder(ORDER_ENERGY),
+        _redrawRatio(0.5),
+        _flagAsync(false),
+        _flagRefining(false),
+        _numRendered(0),
+        _pointLabels(0),
+        _labelPriority(PRIORITY_ENERGY_HIGH),
+        _frameServer(0),
+        _numServed(0),
+        _flagHeadless(false),
+        _flagPlot(false),
+        _flagTrans(false)/*,
         _colorPt{255, 0, 0},
         _colorLine{0, 0, 255},
         _colorTextBg{255, 255, 255},
@@ -59,6 +91,7 @@ private:
     cimg_library::CImgList<TI> _imagesDispRaw;
     cimg_library::CImgList<TI> _imagesDisp;
     double _alpha; //!< Alpha value for merging the two images \c _imagesRaw(0) and \c _imagesRaw(1).
+    unsigned long long _imagesRevision; //!< Incremented each time \c _imagesDispRaw(0) may have changed.
 public:
     //! sets the blending parameter.
     void alpha(double alpha = 1.0){_alpha = alpha;}
@@ -71,28 +104,94 @@ public:
     cimg_library::CImg<TI> image(const int n) const {return _imagesRaw(n);}
     cimg_library::CImg<TI>& image(const int n){return _imagesRaw(n);}
     //! sets \c n-th image \c _imagesRaw(n).
-    void image(const int n, const cimg_library::CImg<TI>& _image){_imagesRaw(n) = _image; imagesUpdate();}
+    void image(const int n, const cimg_library::CImg<TI>& _image){_imagesRaw(n) = _image; imagesUpdate(); _segmentsDirty = true;}
 
     //! returns a list of the images \c _imagesRaw.
     cimg_library::CImgList<TI> images(void) const {return _imagesRaw;}
     cimg_library::CImgList<TI>& images(void){return _imagesRaw;}
     //! sets a list of the images \c _imagesRaw.
-    void images(const cimg_library::CImgList<TI>& _images){_imagesRaw = _images; imagesUpdate();}
+    void images(const cimg_library::CImgList<TI>& _images){_imagesRaw = _images; imagesUpdate(); _segmentsDirty = true;}
     //! sets a list of the images \c _imagesRaw.
-    void images(const cimg_library::CImg<TI>& _image0, const cimg_library::CImg<TI>& _image1){image(0, _image0); image(1, _image1); imagesUpdate();}
+    void images(const cimg_library::CImg<TI>& _image0, const cimg_library::CImg<TI>& _image1){_imagesRaw(0) = _image0; _imagesRaw(1) = _image1; imagesUpdate(); _segmentsDirty = true;}
     //! sets a list of the images \c _imagesRaw.
     void images(const std::vector<std::string>& strImage);
 
-    //! returns the aligning image \c _imagesDispRaw(0).
-    cimg_library::CImg<TI> imgAlign(void) const {return _imagesDispRaw(0);}
-    cimg_library::CImg<TI>& imgAlign(void){return _imagesDispRaw(0);}
+    //! returns the aligning image \c _imagesDispRaw(0); the non-const access counts as a change of the image.
+    const cimg_library::CImg<TI>& imgAlign(void) const {return _imagesDispRaw(0);}
+    cimg_library::CImg<TI>& imgAlign(void){++_imagesRevision; return _imagesDispRaw(0);}
+    //! returns the revision of \c _imagesDispRaw(0), which the renderers compare instead of its pixels.
+    unsigned long long imagesRevision(void) const {return _imagesRevision;}
     //! returns the merging image \c _imagesDispRaw(1).
     cimg_library::CImg<TI> imgMerge(void) const {return _imagesDispRaw(1);}
     cimg_library::CImg<TI>& imgMerge(void){return _imagesDispRaw(1);}
-    void imagesAlign(void){_imagesDispRaw(0) = _imagesRaw.images(0,1).get_append('x');;}
-    void imagesMerge(void){_imagesDispRaw(1) = _alpha*_imagesRaw(0)+(1.0-_alpha)*_imagesRaw(1);}
+    void imagesAlign(void){_imagesDispRaw(0) = _imagesRaw.images(0,1).get_append('x'); ++_imagesRevision;}
+    void imagesMerge(void){_imagesDispRaw(1) = blendImages(_imagesRaw(0), _imagesRaw(1), _alpha);}
     void imagesUpdate(void);//{imagesAlign(); imagesMerge();}
 
+    // asynchronous loading
+private:
+    struct ImagePreview
+    {
+        cimg_library::CImg<TI> image;   //!< The downsampled grayscaled RGB image.
+        int factor;                     //!< The downsampling factor.
+        int width;                      //!< The width of the full-resolution image.
+        int height;                     //!< The height of the full-resolution image.
+    };
+    std::future<typename ImageCache<TI>::ImagePtr> _imagesLoading[2]; //!< The images being decoded by \c imagesAsync.
+    std::shared_future<ImagePreview> _imagesPreview[2]; //!< Their previews: binary PNM files are sampled before their decode, the others (PNG, TIFF, ...) once decoded.
+    cimg_library::CImgList<TP> _pointsFull; //!< The full-resolution points while the previews are installed.
+    bool _flagPreview; //!< A flag indicating the previews are installed.
+    int _previewSize; //!< The largest side of the previews, 0 for no preview.
+public:
+    //! sets the largest side of the previews.
+    void previewSize(const int previewSize){_previewSize = previewSize;}
+    int previewSize(void) const {return _previewSize;}
+    //! starts decoding the images \c strImage, both at the same time on background threads;
+    //! the images held by the image cache are not decoded, and installed at once if both are.
+    void imagesAsync(const std::vector<std::string>& strImage);
+    //! returns true while the images started by \c imagesAsync are not installed.
+    bool imagesPending(void) const {return _imagesLoading[0].valid();}
+    //! installs the previews of the pending images and scales the points to them. Returns false if there is no preview.
+    bool imagesPreview(void);
+    //! waits for the pending images and installs them in place of the previews.
+    void imagesWait(void);
+    //! displays \c frame, rendered on the previews, in a window of the size of the full-resolution frame.
+    void displayPreview(const cimg_library::CImg<TI>& frame);
+
+    // image sequence
+private:
+    ImageSequence<TI> _sequence; //!< The frames of the sequence, prefetched in the background.
+    int _sequenceIndex; //!< The first frame of the pair installed from \c _sequence, -1 for none.
+public:
+    //! starts prefetching the frames \c strFrames of a sequence, \c ahead frames after the pair shown;
+    //! returns false if there are fewer than two frames.
+    bool sequence(const std::vector<std::string>& strFrames, const int ahead = 4)
+    {
+        _sequenceIndex = -1;
+        return strFrames.size() >= 2 && _sequence.open(strFrames, ahead);
+    }
+    //! returns the frames of the sequence, e.g. to read how many were prefetched in time.
+    const ImageSequence<TI>& sequence(void) const {return _sequence;}
+    //! returns the first frame of the pair installed, -1 for none.
+    int sequenceIndex(void) const {return _sequenceIndex;}
+    ///
+    /// \brief sequenceFrame
+    /// installs the frames \c k and \c k+1 of the sequence as the images. From the pair \c k-1, the frame \c k
+    /// already converted in the right half of the aligned image is moved to its left half, and only the frame \c k+1
+    /// is copied. Returns false if a frame is out of the sequence or cannot be read.
+    bool sequenceFrame(const int k);
+    ///
+    /// \brief displaySequence
+    /// plays the pairs of the sequence from the one installed, \c fps pairs per second, until the window is closed.
+    /// \c tracks(k) is called once the pair \c k is installed, to set its points, correspondences and energy.
+    /// Each pair is drawn within 3/4 of its period and the correspondences left are drawn only if it is paused.
+    /// SPACE pauses, the arrows step when paused, HOME goes back to the first pair, Q and ESC quit; the playback
+    /// pauses at the last pair.
+    void displaySequence(
+        const std::function<void(const int)>& tracks,
+        const double fps = 25.0
+    );
+
     // points
 private:
     ///
@@ -107,13 +206,13 @@ public:
     cimg_library::CImg<TP> point(const int n) const {return _points(n);}
     cimg_library::CImg<TP>& point(const int n){return _points(n);}
     //! sets \c n-th point set \c _points(n).
-    void point(const int n, const cimg_library::CImg<TP>& point){_points(n) = point;}
+    void point(const int n, const cimg_library::CImg<TP>& point){_points(n) = point; _segmentsDirty = true;}
 
     //! returns a set of point sets \c _points.
     cimg_library::CImgList<TP> points(void) const {return _points;}
     cimg_library::CImgList<TP>& points(void){return _points;}
     //! sets a set of point sets \c _points.
-    void points(const cimg_library::CImgList<TP>& points){_points = points;}
+    void points(const cimg_library::CImgList<TP>& points){_points = points; _segmentsDirty = true;}
     //! sets a set of point sets \c _points.
     void points(const cimg_library::CImg<TP>& point0, const cimg_library::CImg<TP>& point1){point(0, point0); point(1, point1);}
 
@@ -127,7 +226,7 @@ public:
     cimg_library::CImg<int> correspondences(void) const {return _correspondences;}
     cimg_library::CImg<int>& correspondences(void){return _correspondences;}
     //! sets the set of point-to-point correspondences.
-    void correspondences(const cimg_library::CImg<int>& correspondences){_correspondences = correspondences;}
+    void correspondences(const cimg_library::CImg<int>& correspondences){_correspondences = correspondences; _segmentsDirty = true;}
 
     // energy
 private:
@@ -136,11 +235,21 @@ public:
     //! returns the number of point-to-point correspondences.
     int numberOfEnergy(void) const {return _energy.size();}
     //! sets a set of energy \c _energy
-    void energy(const std::vector<double>& energy){_energy = energy;}
+    void energy(const std::vector<double>& energy){_energy = energy; _segmentsDirty = true;}
     //! sets a set of energy \c _energy
     std::vector<double> energy() const {return _energy;}
     std::vector<double>& energy(){return _energy;}
 
+    // resolved segments
+private:
+    std::vector<MatchingSegment> _segments; //!< The valid correspondences resolved into drawing coordinates.
+protected:
+    bool _segmentsDirty; //!< A flag indicating the resolved segments are out of date, set by the setters of the derived viewers too.
+public:
+    //! returns the resolved segments, resolving them if any input has been set since the last update.
+    const std::vector<MatchingSegment>& segments(void){if(_segmentsDirty) segmentsUpdate(); return _segments;}
+    //! resolves \c _correspondences and \c _energy into \c _segments.
+    void segmentsUpdate(void);
 
     // variables for display
 private:
@@ -149,16 +258,196 @@ public:
     void flagDebug(const bool &flagDebug){_flagDebug = flagDebug;}
     bool flagDebug(void) const {return _flagDebug;}
 
+    // progressive rendering
+private:
+    double _frameBudget; //!< The time budget of a frame in milliseconds, 0 for no limit.
+    SegmentOrder _renderOrder; //!< The order in which the correspondences are drawn within the budget.
+    double _redrawRatio; //!< The largest fraction of the correspondences changed, and of the frame restored, redrawn from the previous frame.
+    ProgressiveRenderer<TI> _renderer; //!< The renderer of the frames shown by \c displayUpdate.
+    bool _flagAsync; //!< A flag indicating \c displayUpdate returns after the first step of its frame.
+    bool _flagRefining; //!< A flag indicating the frame of \c displayUpdate is not complete and published yet.
+    int _numRendered; //!< The correspondence up to which the frame of \c displayUpdate is drawn.
+public:
+    //! sets the time budget of a frame in milliseconds; the rest of the frame is drawn by the next idle ticks.
+    void frameBudget(const double frameBudget){_frameBudget = frameBudget;}
+    double frameBudget(void) const {return _frameBudget;}
+    //! sets the order in which the correspondences are drawn.
+    void renderOrder(const SegmentOrder renderOrder){_renderOrder = renderOrder;}
+    SegmentOrder renderOrder(void) const {return _renderOrder;}
+    //! sets the largest fraction of the correspondences redrawn when only some changed since the previous frame;
+    //! beyond it the frame is redrawn whole, always if 0.
+    void redrawRatio(const double redrawRatio){_redrawRatio = redrawRatio;}
+    double redrawRatio(void) const {return _redrawRatio;}
+    //! returns the renderer of the frames, e.g. to read the statistics of its last update.
+    const ProgressiveRenderer<TI>& renderer(void) const {return _renderer;}
+    //! makes the non-debug \c displayUpdate return after the first step of its frame if \c flagAsync; the caller then
+    //! completes the frame with \c displayRefine between its own work, or leaves the rest to the next \c displayUpdate.
+    void displayAsync(const bool flagAsync){_flagAsync = flagAsync;}
+    bool displayAsync(void) const {return _flagAsync;}
+    //! draws the next step of the frame of \c displayUpdate within the budget, shows it if it changed and publishes
+    //! it once complete. Returns true when the frame is complete, at once if there is none.
+    bool displayRefine(void);
+
+    // partial display updates
+private:
+    RegionDisplay _regionDisplay; //!< Shows the frames on \c _dispEnergy, sending only their changed rectangles.
+    std::vector<FrameRect> _dirtyRects; //!< The rectangles of the frame changed since it was last shown.
+public:
+    //! returns the display of the frames, e.g. to turn on its verification or read its statistics.
+    RegionDisplay& regionDisplay(void){return _regionDisplay;}
+
+    // labels
+private:
+    int _pointLabels; //!< The labels drawn next to the markers of the correspondences (\c PointLabel), 0 for none.
+    LabelPriority _labelPriority; //!< The order in which the labels are placed, those overlapping culled.
+public:
+    //! draws the labels \c pointLabels (\c LABEL_INDEX, \c LABEL_ENERGY or both, 0 for none) next to the markers,
+    //! placed in the order \c priority; the labels overlapping others placed before are not drawn.
+    void pointLabels(const int pointLabels, const LabelPriority priority = PRIORITY_ENERGY_HIGH)
+    {
+        _pointLabels = pointLabels;
+        _labelPriority = priority;
+    }
+    int pointLabels(void) const {return _pointLabels;}
+    //! returns the style of the frames, with the labels.
+    MatchingStyle labelStyle(void) const
+    {
+        MatchingStyle style;
+        style.pointLabels = _pointLabels;
+        style.labelPriority = _labelPriority;
+        return style;
+    }
+
+    // remote monitoring
+private:
+    FrameServer* _frameServer; //!< The server the completed frames are published to, if any.
+    long long _numServed; //!< The number of frames published to \c _frameServer, reported as the iteration.
+    bool _flagHeadless; //!< A flag indicating no display is opened, the frames are only published to \c _frameServer.
+public:
+    //! publishes each frame completed by \c displayUpdate to \c frameServer, 0 for none; the viewer does not own it.
+    void frameServer(FrameServer* frameServer){_frameServer = frameServer;}
+    FrameServer* frameServer(void) const {return _frameServer;}
+    //! opens no display if \c flagHeadless, e.g. without a screen: each \c displayUpdate renders its frame complete
+    //! and publishes it to the frame server without waiting for input, in the debug mode too.
+    void headless(const bool flagHeadless){_flagHeadless = flagHeadless;}
+    bool headless(void) const {return _flagHeadless;}
+    //! publishes \c frame, showing \c numCorrespondences correspondences of the given \c energy, to the frame server if any.
+    template <typename T>
+    void serveFrame(
+        const cimg_library::CImg<T>& frame,
+        const int numCorrespondences,
+        const std::vector<double>& energy
+    )
+    {
+        if(_frameServer) _frameServer->publish(frame, FrameStatus::summary(++_numServed, numCorrespondences, energy));
+    }
+
     // displays
 private:
     cimg_library::CImgDisplay _dispEnergy; //!< Display for showing energy of point-to-point correspondences.
     cimg_library::CImgDisplay _dispTrans; //!< Display for showing the transformation between two point sets.
+    cimg_library::CImgDisplay _dispPlot; //!< Display for showing the energy plot.
 public:
     //! gets \c _dispEnergy
     cimg_library::CImgDisplay dispEnergy(void) const {return _dispEnergy;}
     cimg_library::CImgDisplay& dispEnergy(void){return _dispEnergy;}
     //! sets \c _dispEnergy
     void dispEnergy(const cimg_library::CImgDisplay& dispEnergy){_dispEnergy = dispEnergy;}
+    //! gets \c _dispTrans
+    cimg_library::CImgDisplay& dispTrans(void){return _dispTrans;}
+    //! gets \c _dispPlot
+    cimg_library::CImgDisplay& dispPlot(void){return _dispPlot;}
+
+    // energy plot
+private:
+    EnergyPlot _plot; //!< The energy sums of the last iterations, shown on \c _dispPlot.
+    bool _flagPlot; //!< A flag indicating the energy plot is updated by \c displayUpdate.
+public:
+    ///
+    /// \brief energyPlot
+    /// shows the energy sums of the last \c capacity iterations on \c _dispPlot, updated by each \c displayUpdate,
+    /// with the histogram of the energies of each iteration over [\c histogramLo, \c histogramHi] if \c histogramBins > 0.
+    void energyPlot(
+        const bool flagPlot,
+        const int histogramBins = 0,
+        const double histogramLo = 0.0,
+        const double histogramHi = 1.0,
+        const int capacity = 400
+    )
+    {
+        _flagPlot = flagPlot;
+        _plot = EnergyPlot(capacity, 160, histogramBins);
+        _plot.histogramRange(histogramLo, histogramHi);
+        if(!flagPlot) _dispPlot.assign();
+    }
+    bool flagPlot(void) const {return _flagPlot;}
+    const EnergyPlot& energyPlot(void) const {return _plot;}
+    ///
+    /// \brief plotUpdate
+    /// appends an iteration to the energy plot and shows it: the sums of the \c numSeries \c energies,
+    /// \c numFlips flips out of \c numCorrespondences (-1 for none), and the histogram of the last series.
+    void plotUpdate(
+        const std::vector<double>* const energies[],
+        const int numSeries,
+        const int numFlips,
+        const int numCorrespondences
+    );
+
+    // transformation
+private:
+    bool _flagTrans; //!< A flag indicating the transformation is estimated and shown on \c _dispTrans by \c displayUpdate.
+    RansacOptions _ransacOptions; //!< The parameters of the estimation.
+    PackedMatches _matches; //!< The valid correspondences of the last estimation, packed.
+    RansacResult _ransac; //!< The last estimation.
+public:
+    ///
+    /// \brief transformView
+    /// estimates the transformation from image 0 to image 1 with RANSAC in each \c displayUpdate and shows
+    /// image 1 warped onto image 0 on \c _dispTrans, the matches in green if inliers and in red otherwise.
+    void transformView(
+        const bool flagTrans,
+        const RansacOptions& options = RansacOptions()
+    )
+    {
+        _flagTrans = flagTrans;
+        _ransacOptions = options;
+        if(!flagTrans) _dispTrans.assign();
+    }
+    bool flagTrans(void) const {return _flagTrans;}
+    //! returns the matches of the last estimation.
+    const PackedMatches& packedMatches(void) const {return _matches;}
+    //! returns the last estimation.
+    const RansacResult& ransacResult(void) const {return _ransac;}
+    //! packs the points of the valid correspondences of \c correspondences into \c matches.
+    void packMatches(
+        const cimg_library::CImg<int>& correspondences,
+        PackedMatches& matches
+    ) const;
+    //! returns image 1 warped onto image 0 by \c result and blended with image 0, the \c matches marked as inliers or outliers.
+    cimg_library::CImg<TI> transformOverlay(
+        const PackedMatches& matches,
+        const RansacResult& result
+    ) const;
+    //! estimates the transformation of \c correspondences and shows its overlay on \c _dispTrans.
+    void transformUpdate(const cimg_library::CImg<int>& correspondences);
+
+    // soft assignment
+public:
+    ///
+    /// \brief drawSoftAssignment
+    /// returns the aligned images with the nonzeros of the soft assignment \c assignment, from the points of image 0
+    /// to those of image 1, drawn by \c style; the weights below \c style.threshold are skipped. The number of
+    /// segments drawn is written to \c numSegments unless it is 0.
+    cimg_library::CImg<TI> drawSoftAssignment(
+        const SoftAssignment& assignment,
+        const SoftStyle& style = SoftStyle(),
+        size_t* numSegments = 0
+    ) const;
+    //! shows \c assignment drawn by \c style on \c _dispEnergy until the window is closed.
+    void displaySoftAssignment(
+        const SoftAssignment& assignment,
+        const SoftStyle& style = SoftStyle()
+    );
 
 private:
     int _flagDisplay; //!< The flag indicating which display is shown.
@@ -169,6 +458,28 @@ public:
         const cimg_library::CImg<int>& correspondences,
         const std::vector<double>& energy
     );
+    //! returns the frame drawn so far by \c displayUpdate, captioned with the correspondence \c numDraw.
+    cimg_library::CImg<TI> renderedFrame(const int numDraw) const;
+    //! shows \c frame on \c _dispEnergy, of which only the rectangles \c rects changed; \c rects is cleared.
+    void displayFrame(const cimg_library::CImg<TI>& frame, std::vector<FrameRect>& rects);
+    //! shows the frame drawn so far by \c displayUpdate on \c _dispEnergy.
+    void showRenderedFrame(const int numDraw);
+    //! returns the points \c c0, \c c1 and the energy \c energy of the correspondence \c numDraw, -1 and 0 if out of range.
+    void correspondenceCaption(
+        const int numDraw,
+        int& c0,
+        int& c1,
+        double& energy
+    ) const;
+    //! draws the caption of the correspondence \c numDraw and the title \c strTitle on \c img.
+    void drawCaption(
+        cimg_library::CImg<TI>& img,
+        const int numDraw,
+        const int c0,
+        const int c1,
+        const double energy,
+        const std::string strTitle = ""
+    ) const;
     cimg_library::CImg<TI> drawMatching(
         const cimg_library::CImg<TI>& _img,
         const unsigned char colorPt[] = _colorPt,
@@ -181,6 +492,7 @@ public:
         const unsigned char colorLine[] = _colorLine,
         const std::string strTitle = ""
     );
+    //! draws the given correspondences instead of \c _correspondences, leaving the viewer unchanged.
     cimg_library::CImg<TI> drawMatching(
         const cimg_library::CImg<TI>& _img,
         const cimg_library::CImg<int>& correspondences,
@@ -189,7 +501,33 @@ public:
         const unsigned char colorPt[] = _colorPt,
         const unsigned char colorLine[] = _colorLine,
         const std::string strTitle = ""
-    );
+    ) const;
+
+    // reentrant rendering
+    //! returns a description of the current matching, drawn up to the correspondence \c numDraw.
+    MatchingFrame<TP> frame(const int numDraw) const;
+    //! returns a description of the current matching with all the correspondences drawn.
+    MatchingFrame<TP> frame(void) const {return frame(_correspondences.width());}
+    //! fills \c canvas with the aligned images and draws \c frame on it. The viewer is only read.
+    void render(
+        const MatchingFrame<TP>& frame,
+        cimg_library::CImg<TI>& canvas
+    ) const;
+    //! returns the aligned images with \c frame drawn on them.
+    cimg_library::CImg<TI> render(const MatchingFrame<TP>& frame) const;
+    //! renders each of \c frames on its own canvas, in parallel.
+    std::vector<cimg_library::CImg<TI> > render(const std::vector<MatchingFrame<TP> >& frames) const;
+    cimg_library::CImg<TI> drawMatching(
+        const cimg_library::CImg<TI>& _img,
+        const std::vector<MatchingSegment>& segments,
+        const int numDraw,
+        const int c0,
+        const int c1,
+        const double energy,
+        const unsigned char colorPt[],
+        const unsigned char* const colorLine[],
+        const std::string strTitle = ""
+    ) const;
     //@}
 };
 //------------------------------------------
@@ -206,85 +544,484 @@ void MatchingViewer<TI,TP>::imagesUpdate(void)
     imagesMerge();
 }
 
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::segmentsUpdate(void)
+{
+    resolveSegments(_segments, _points(0), _points(1), _correspondences, _energy, _imagesRaw(0).width());
+    _segmentsDirty = false;
+}
+
 template <typename TI, typename TP>
 void MatchingViewer<TI,TP>::images(const std::vector<std::string>& strImage)
+{
+    imagesAsync(strImage);
+    imagesWait();
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::imagesAsync(const std::vector<std::string>& strImage)
 {
     assert(
         _imagesRaw.size() == strImage.size() &&
         "The number of the given images must be same as one of the prepared image objects."
     );
+    if(imagesPending()) imagesWait();
 
-    cimg_library::CImg<TI> _img;
+    // the images the cache holds are neither sampled nor decoded
+    typename ImageCache<TI>::ImagePtr cached[2];
+    for(int n = 0; n < strImage.size(); ++n) cached[n] = ImageCache<TI>::instance().find(strImage[n]);
+    if(cached[0] && cached[1])
+    {
+        for(int n = 0; n < 2; ++n) _imagesRaw(n) = *cached[n];
+        imagesUpdate();
+        _segmentsDirty = true;
+        return;
+    }
+
+    const int previewSize = _previewSize;
     for(int n = 0; n < strImage.size(); ++n)
     {
-        _img = cimg_library::CImg<TI>( strImage[n].c_str() );
-        if(_img.spectrum() == 3)
+        std::shared_ptr<std::promise<ImagePreview> > preview(new std::promise<ImagePreview>);
+        _imagesPreview[n] = preview->get_future().share();
+        const std::string path = strImage[n];
+        const typename ImageCache<TI>::ImagePtr imageCached = cached[n];
+        _imagesLoading[n] = std::async(std::launch::async, [path, imageCached, preview, previewSize]() -> typename ImageCache<TI>::ImagePtr {
+            // the preview is a nearest-neighbor downsample, converted on the fly when decoded here
+            bool flagPreview = false;
+            auto makePreview = [&](const cimg_library::CImg<TI>& img, const bool flagConvert){
+                if(flagPreview) return;
+                ImagePreview p;
+                p.width = img.width();
+                p.height = img.height();
+                p.factor = previewSize > 0 ? std::max(1, (std::max(p.width, p.height)+previewSize-1)/previewSize) : 1;
+                if(previewSize > 0)
+                {
+                    p.image = p.factor > 1 ? img.get_resize(p.width/p.factor, p.height/p.factor, -100, -100, 1) : img;
+                    if(flagConvert) p.image = getDisplayRGB(p.image);
+                }
+                preview->set_value(p);
+                flagPreview = true;
+            };
+            if(imageCached)
+            { // only the other image is decoded
+                makePreview(*imageCached, false);
+                return imageCached;
+            }
+            try
+            {
+                // a binary PNM file is sampled first, from a fraction of its rows, so the preview does not wait for the decode
+                ImagePreview p;
+                if(previewSize > 0 && loadReducedPNM(path, previewSize, p.image, p.width, p.height, p.factor))
+                {
+                    p.image = getDisplayRGB(p.image);
+                    preview->set_value(p);
+                    flagPreview = true;
+                }
+                typename ImageCache<TI>::ImagePtr image = ImageCache<TI>::instance().get(path,
+                    [&](const cimg_library::CImg<TI>& img){makePreview(img, true);});
+                if(!flagPreview) makePreview(*image, false);
+                return image;
+            }
+            catch(...)
+            {
+                if(!flagPreview) preview->set_exception(std::current_exception());
+                throw;
+            }
+        });
+    }
+}
+
+template <typename TI, typename TP>
+bool MatchingViewer<TI,TP>::imagesPreview(void)
+{
+    if(!imagesPending() || _flagPreview || _previewSize <= 0) return false;
+    ImagePreview previews[2];
+    try
+    {
+        for(int n = 0; n < 2; ++n) previews[n] = _imagesPreview[n].get();
+    }
+    catch(...)
+    { // reported by imagesWait
+        return false;
+    }
+    _pointsFull = _points;
+    for(int n = 0; n < 2; ++n)
+    {
+        _imagesRaw(n) = previews[n].image;
+        for(int k = 0; k < _points(n).height(); ++k)
         {
-            image(n, cimg_library::CImg<TI>( getGrayscaledRGB( _img ) ));
+            for(int m = 0; m < _points(n).width(); ++m)
+            {
+                _points(n)(m,k) /= previews[n].factor;
+            }
         }
-        else
+    }
+    imagesUpdate();
+    _segmentsDirty = true;
+    _flagPreview = true;
+    return true;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::imagesWait(void)
+{
+    if(!imagesPending()) return;
+    typename ImageCache<TI>::ImagePtr images[2];
+    std::exception_ptr error;
+    for(int n = 0; n < 2; ++n)
+    {
+        try
         {
-            image(n, cimg_library::CImg<TI>( getGraytoRGB( _img ) ));
+            images[n] = _imagesLoading[n].get();
         }
+        catch(...)
+        {
+            error = std::current_exception();
+        }
+        _imagesPreview[n] = std::shared_future<ImagePreview>();
+    }
+    if(_flagPreview)
+    {
+        _points = _pointsFull;
+        _pointsFull.assign();
+        _flagPreview = false;
+    }
+    if(error) std::rethrow_exception(error);
+    for(int n = 0; n < 2; ++n)
+    {
+        _imagesRaw(n) = *images[n];
     }
     imagesUpdate();
+    _segmentsDirty = true;
 }
 
 template <typename TI, typename TP>
-void MatchingViewer<TI,TP>::displayUpdate(void)
+void MatchingViewer<TI,TP>::displayPreview(const cimg_library::CImg<TI>& frame)
 {
-    cimg_library::CImg<TI> imgShow(_imagesDispRaw(0));
-
-    if(!_flagDebug)
-    { // non-debug mode
-        _dispEnergy.wait(300);
-        drawMatching( imgShow ).display(_dispEnergy);
+    if(_flagHeadless) return;
+    if(_dispEnergy.is_empty() && _flagPreview)
+    {
+        const ImagePreview& p0 = _imagesPreview[0].get();
+        const ImagePreview& p1 = _imagesPreview[1].get();
+        const double sx = (double)(p0.width+p1.width)/(p0.image.width()+p1.image.width());
+        const double sy = (double)std::max(p0.height, p1.height)/std::max(p0.image.height(), p1.image.height());
+        _dispEnergy.assign((int)(frame.width()*sx+0.5), (int)(frame.height()*sy+0.5));
     }
-    else
-    { // debug mode
-        int numPointCur = 0, numPointPrev;
-        bool _flag = true;
-        drawMatching( imgShow, numPointCur ).display(_dispEnergy);
-        while(_flag)
+    frame.display(_dispEnergy);
+    _regionDisplay.invalidate();
+}
+
+template <typename TI, typename TP>
+bool MatchingViewer<TI,TP>::sequenceFrame(const int k)
+{
+    if(k < 0 || k+1 >= _sequence.size()) return false;
+    const typename ImageSequence<TI>::ImagePtr image0 = _sequence.frame(k);
+    const typename ImageSequence<TI>::ImagePtr image1 = _sequence.frame(k+1);
+    if(!image0 || !image1) return false;
+    if(imagesPending()) imagesWait();
+
+    cimg_library::CImg<TI>& imgAlign = _imagesDispRaw(0);
+    const int w = image1->width(), h = image1->height();
+    if(k == _sequenceIndex+1 && image0->is_sameXYZC(_imagesRaw(1)) && image0->is_sameXYZC(*image1) &&
+       imgAlign.width() == 2*w && imgAlign.height() == h && imgAlign.spectrum() == image1->spectrum())
+    { // the frame k is the right half of the aligned image of the pair k-1
+        for(int c = 0; c < imgAlign.spectrum(); ++c)
         {
-            // check any user input
-            _dispEnergy.wait();
-            // retrieve the input
-            if(_dispEnergy.wheel()!=0)
+            for(int y = 0; y < h; ++y)
             {
-                numPointCur += _dispEnergy.wheel();
-                _dispEnergy.set_wheel();
+                TI* row = imgAlign.data(0, y, 0, c);
+                std::copy(row+w, row+2*w, row);
+                std::copy(image1->data(0, y, 0, c), image1->data(0, y, 0, c)+w, row+w);
             }
+        }
+        _imagesRaw(0).swap(_imagesRaw(1));
+        _imagesRaw(1) = *image1;
+        imagesMerge();
+        ++_imagesRevision;
+    }
+    else
+    {
+        _imagesRaw(0) = *image0;
+        _imagesRaw(1) = *image1;
+        imagesUpdate();
+    }
+    _sequenceIndex = k;
+    _segmentsDirty = true;
+    return true;
+}
 
-            if(_dispEnergy.is_keyARROWDOWN() || _dispEnergy.is_keyARROWLEFT())
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::displaySequence(
+    const std::function<void(const int)>& tracks,
+    const double fps
+)
+{
+    const int numPairs = _sequence.size()-1;
+    if(numPairs < 1) return;
+    _flagRefining = false;
+    const unsigned int period = fps > 0 ? (unsigned int)(1000.0/fps + 0.5) : 0;
+    const unsigned char* colorLines[] = {_colorLine};
+    int k = std::max(_sequenceIndex, 0);
+    bool flagPause = false;
+    for(;;)
+    {
+        if(k != _sequenceIndex)
+        {
+            if(!sequenceFrame(k)) return;
+            tracks(k);
+            segmentsUpdate();
+            if(_flagPlot)
             {
-                --numPointCur;
+                const std::vector<double>* energies[] = {&_energy};
+                plotUpdate(energies, 1, -1, _correspondences.width());
             }
-            if(_dispEnergy.is_keyARROWUP() || _dispEnergy.is_keyARROWRIGHT())
+            transformUpdate(_correspondences);
+
+            // the pair is refined within its period and shown as drawn at its end
+            const int numDraw = _correspondences.width();
+            const auto start = std::chrono::steady_clock::now();
+            _renderer.begin(_imagesDispRaw(0), _imagesRevision, _segments, numDraw, _renderOrder, _colorPt, colorLines, period > 0 ? 0.5*period : _frameBudget);
+            bool flagDone;
+            do
             {
-                ++numPointCur;
+                flagDone = _renderer.step();
             }
-            if(_dispEnergy.is_keyQ() || _dispEnergy.is_keyESC())
-            {
-                _flag = false;
+            while(!flagDone && (_flagHeadless || period == 0 ||
+                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count() < 0.75*period));
+            showRenderedFrame(numDraw);
+            if(_renderer.done()) serveFrame(renderedFrame(numDraw), numDraw, _energy);
+            if(_flagHeadless)
+            { // each pair is served complete, once, every period
+                const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+                if(k+1 >= numPairs) return;
+                if(elapsed < period) cimg_library::cimg::sleep((unsigned int)(period-elapsed));
+                ++k;
+                continue;
             }
+            _dispEnergy.set_title("Frames %d and %d of %d", k, k+1, numPairs+1);
+        }
+        if(_dispEnergy.is_closed()) return;
+
+        // the pairs follow each other every period, the keys are read in between; a paused pair is completed
+        if(flagPause && !_renderer.done())
+        {
+            _renderer.step();
+            showRenderedFrame(_correspondences.width());
+        }
+        else if(flagPause) _dispEnergy.wait();
+        else _dispEnergy.wait(period);
+        if(_dispEnergy.is_keyQ() || _dispEnergy.is_keyESC()) return;
+        if(_dispEnergy.is_keySPACE()) flagPause = !flagPause;
+        if(flagPause)
+        {
+            if(_dispEnergy.is_keyARROWLEFT() || _dispEnergy.is_keyARROWDOWN()) k = std::max(k-1, 0);
+            if(_dispEnergy.is_keyARROWRIGHT() || _dispEnergy.is_keyARROWUP()) k = std::min(k+1, numPairs-1);
+        }
+        else if(k+1 < numPairs) ++k;
+        else flagPause = true;
+        if(_dispEnergy.is_keyHOME()) k = 0;
+        _dispEnergy.set_key();
+    }
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::displayUpdate(void)
+{
+    if(imagesPreview() && !_flagHeadless)
+    { // show the matching on the previews until the images are decoded
+        segmentsUpdate();
+        displayPreview( drawMatching( _imagesDispRaw(0) ) );
+    }
+    imagesWait();
+    segmentsUpdate();
+    const unsigned char* colorLines[] = {_colorLine};
+    if(_flagPlot)
+    {
+        const std::vector<double>* energies[] = {&_energy};
+        plotUpdate(energies, 1, -1, _correspondences.width());
+    }
+    transformUpdate(_correspondences);
 
-            // update the image
-            else
-            { // update the image
-                numPointCur = std::min(_correspondences.width()-1,numPointCur);
-                numPointCur = std::max(numPointCur, -1);
-                if(numPointCur != numPointPrev)
+    if(!_flagDebug || _flagHeadless)
+    { // non-debug mode: refine the frame until it is complete, or only its first step if asynchronous
+        const int numDraw = _correspondences.width();
+        if(!_flagHeadless && !_flagAsync) _dispEnergy.wait(300);
+        // redraw only the changed correspondences over the previous frame if they are few
+        if(!_renderer.update(_imagesDispRaw(0), _imagesRevision, _segments, numDraw, _renderOrder, _colorPt, colorLines, _redrawRatio))
+        {
+            _renderer.begin(_imagesDispRaw(0), _imagesRevision, _segments, numDraw, _renderOrder, _colorPt, colorLines, _frameBudget);
+        }
+        _numRendered = numDraw;
+        _flagRefining = true;
+        bool flagDone;
+        do
+        {
+            flagDone = displayRefine();
+        }
+        while(!flagDone && !_flagAsync && (_flagHeadless || !_dispEnergy.is_closed()));
+    }
+    else
+    { // debug mode: the input is merged into one target, rendered at most once per refresh
+        _flagRefining = false;
+        BrowseScheduler browse(-1, _correspondences.width()-1);
+        browse.target(0);
+        const double budget = browse.budget(_frameBudget);
+        int numPointCur = browse.target();
+        _renderer.begin(_imagesDispRaw(0), _imagesRevision, _segments, numPointCur, _renderOrder, _colorPt, colorLines, budget);
+        browse.rendered();
+        _renderer.step();
+        showRenderedFrame(numPointCur);
+        for(;;)
+        {
+            // wait for an event only when the frame shown is complete and current
+            browse.poll(_dispEnergy, _renderer.done() && browse.target() == numPointCur);
+            if(browse.quit()) break;
+            if(browse.target() != numPointCur && browse.due())
+            { // the render of the previous target is dropped, complete or not
+                numPointCur = browse.target();
+                if(!_renderer.update(_imagesDispRaw(0), _imagesRevision, _segments, numPointCur, _renderOrder, _colorPt, colorLines, _redrawRatio))
                 {
-                    imgShow = _imagesDispRaw(0);
-                    drawMatching(imgShow, numPointCur).display( _dispEnergy );
-                    numPointPrev = numPointCur;
+                    _renderer.begin(_imagesDispRaw(0), _imagesRevision, _segments, numPointCur, _renderOrder, _colorPt, colorLines, budget);
                 }
+                browse.rendered();
+            }
+            else if(_renderer.done())
+            { // the new target waits for the next refresh
+                cimg_library::cimg::sleep(browse.delay());
+                continue;
             }
+            _renderer.step();
+            showRenderedFrame(numPointCur);
         }
     }
 }
 
+template <typename TI, typename TP>
+bool MatchingViewer<TI,TP>::displayRefine(void)
+{
+    if(!_flagRefining) return true;
+    const bool flagDone = _renderer.step();
+    // the low-detail frame shown while the full-detail one is drawn behind it is not sent again
+    if(_renderer.changed()) showRenderedFrame(_numRendered);
+    if(!flagDone) return false;
+    serveFrame(renderedFrame(_numRendered), _numRendered, _energy);
+    _flagRefining = false;
+    return true;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::plotUpdate(
+    const std::vector<double>* const energies[],
+    const int numSeries,
+    const int numFlips,
+    const int numCorrespondences
+)
+{
+    const PixelKernelTable& kernels = pixelKernels();
+    double sums[3] = {0, 0, 0};
+    for(int s = 0; s < numSeries && s < 3; ++s) sums[s] = kernels.sum(energies[s]->data(), energies[s]->size());
+    const std::vector<double>& last = *energies[std::min(numSeries, 3)-1];
+    _plot.push(sums, numSeries, numFlips, numCorrespondences, last.data(), last.size());
+    if(_flagHeadless) return;
+
+    if(_dispPlot.is_empty()) _dispPlot.assign(_plot.image(), "Energy");
+    else if(!_dispPlot.is_closed()) _plot.image().display(_dispPlot);
+    _dispPlot.set_title("Energy %g to %g, iteration %lld", _plot.lo(), _plot.hi(), _plot.numberOfIterations());
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::packMatches(
+    const cimg_library::CImg<int>& correspondences,
+    PackedMatches& matches
+) const
+{
+    matches.clear();
+    const int numCorrespondences = correspondences.height() > 1 ? correspondences.width() : 0;
+    const unsigned int w0 = _points(0).width(), w1 = _points(1).width();
+    for(int m = 0; m < numCorrespondences; ++m)
+    {
+        // negative indices wrap around and fail the range check
+        const unsigned int i0 = correspondences(m,0), i1 = correspondences(m,1);
+        if(i0 >= w0 || i1 >= w1) continue;
+        matches.push_back((float)_points(0)(i0,0), (float)_points(0)(i0,1), (float)_points(1)(i1,0), (float)_points(1)(i1,1), m);
+    }
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewer<TI,TP>::transformOverlay(
+    const PackedMatches& matches,
+    const RansacResult& result
+) const
+{
+    static const unsigned char colorInlier[3] = {0, 255, 0}, colorOutlier[3] = {255, 0, 0};
+    const cimg_library::CImg<TI>& img0 = _imagesRaw(0);
+    cimg_library::CImg<TI> overlay = result.valid ?
+                blendImages(img0, warpBilinear(_imagesRaw(1), result.transform, img0), 0.5) : img0;
+    // the outliers first, so the inliers stay visible where they overlap
+    for(int flagInlier = 0; flagInlier < 2; ++flagInlier)
+    {
+        const unsigned char* color = flagInlier ? colorInlier : colorOutlier;
+        for(size_t i = 0; i < matches.size(); ++i)
+        {
+            if((result.valid && result.inliers[i]) != (flagInlier == 1)) continue;
+            const int x = (int)matches.x0[i], y = (int)matches.y0[i];
+            overlay.draw_rectangle(x-1, y-1, x+1, y+1, color);
+        }
+    }
+    return overlay;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::transformUpdate(const cimg_library::CImg<int>& correspondences)
+{
+    if(!_flagTrans) return;
+    packMatches(correspondences, _matches);
+    _ransac = estimateTransform(_matches, _ransacOptions);
+    const cimg_library::CImg<TI> overlay = transformOverlay(_matches, _ransac);
+    if(_flagHeadless) return;
+    if(_dispTrans.is_empty()) _dispTrans.assign(overlay, "Transformation");
+    else if(!_dispTrans.is_closed()) overlay.display(_dispTrans);
+    _dispTrans.set_title("%s: %d/%d inliers, %d hypotheses", _ransacOptions.model == TRANSFORM_AFFINE ? "Affine" : "Homography",
+                         _ransac.numInliers, (int)_matches.size(), _ransac.numHypotheses);
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewer<TI,TP>::drawSoftAssignment(
+    const SoftAssignment& assignment,
+    const SoftStyle& style,
+    size_t* numSegments
+) const
+{
+    cimg_library::CImg<TI> canvas = _imagesDispRaw(0);
+    const size_t n = ::drawSoftAssignment(canvas, _points(0), _points(1), assignment, style, _imagesRaw(0).width());
+    if(numSegments) *numSegments = n;
+    return canvas;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::displaySoftAssignment(
+    const SoftAssignment& assignment,
+    const SoftStyle& style
+)
+{
+    imagesWait();
+    size_t numSegments = 0;
+    const cimg_library::CImg<TI> frame = drawSoftAssignment(assignment, style, &numSegments);
+    _dirtyRects.assign(1, FrameRect(0, 0, frame.width()-1, frame.height()-1));
+    displayFrame(frame, _dirtyRects);
+    if(_flagHeadless)
+    {
+        serveFrame(frame, (int)numSegments, std::vector<double>());
+        return;
+    }
+    _dispEnergy.set_title("%lu of %lu weights above %g", (unsigned long)numSegments,
+                          (unsigned long)assignment.numberOfNonzeros(), style.threshold);
+    while(!_dispEnergy.is_closed() && !_dispEnergy.is_keyQ() && !_dispEnergy.is_keyESC())
+    {
+        _dispEnergy.wait();
+    }
+}
+
 template <typename TI, typename TP>
 void MatchingViewer<TI,TP>::displayUpdate(
     const cimg_library::CImg<int>& correspondences,
@@ -314,57 +1051,112 @@ cimg_library::CImg<TI> MatchingViewer<TI,TP>::drawMatching(
     const unsigned char colorLine[],
     const std::string strTitle
 )
+{
+    const unsigned char* colorLines[] = {colorLine};
+    int c0, c1;
+    double e;
+    correspondenceCaption(numDraw, c0, c1, e);
+    return drawMatching(_img, segments(), numDraw, c0, c1, e, colorPt, colorLines, strTitle);
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewer<TI,TP>::drawMatching(
+    const cimg_library::CImg<TI> &_img,
+    const std::vector<MatchingSegment>& segments,
+    const int numDraw,
+    const int c0,
+    const int c1,
+    const double energy,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const std::string strTitle
+) const
 {
     cimg_library::CImg<TI> img(_img);
-    int offset = _imagesRaw(0).width();
-    int radius = 4;
-    int x0, y0, x1, y1;
-    int i0, i1;
 
     /// draw matching
-    for(int m = 0; m <= numDraw; ++m)
+    drawSegments(img, segments, numDraw, colorPt, colorLine);
+
+    drawCaption(img, numDraw, c0, c1, energy, strTitle);
+    return img;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::correspondenceCaption(
+    const int numDraw,
+    int& c0,
+    int& c1,
+    double& energy
+) const
+{
+    c0 = c1 = -1;
+    energy = 0.0;
+    if(numDraw>=0 && numDraw<_correspondences.width())
     {
-        i0 = _correspondences(m,0);
-        i1 = _correspondences(m,1);
-        if(i0>=0 && i0< _points(0).width() && i1>=0 && i1<_points(1).width())
-        {
-            x0 = _points(0)(i0,0);
-            y0 = _points(0)(i0,1);
-            x1 = _points(1)(i1,0)+offset;
-            y1 = _points(1)(i1,1);
-            draw_line_thick(img, x0, y0, x1, y1, colorLine, radius/2);
-            img.draw_circle(x0, y0, radius, colorPt, 1.f);
-            img.draw_circle(x1, y1, radius, colorPt, 1.f);
-//            img.draw_triangle(x1, y1-radius, x1-radius, y1+radius, x1+radius, y1+radius, _colorPt);
-        }
+        c0 = _correspondences(numDraw,0);
+        c1 = _correspondences(numDraw,1);
+        energy = _energy[numDraw];
     }
+}
 
-    /// draw energy
-    int fontsize = 25;
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewer<TI,TP>::renderedFrame(const int numDraw) const
+{
     int c0, c1;
-    std::stringstream ss;
-    ss << "correspondence#";
-    if(numDraw>=0)
+    double e;
+    correspondenceCaption(numDraw, c0, c1, e);
+    cimg_library::CImg<TI> img(_renderer.image());
+    if(_pointLabels && _renderer.done())
+    { // the labels of a complete frame only, not of the segments drawn so far
+        drawMatchingLabels(img, _segments.data(), numberOfSegments(_segments, numDraw), false, labelStyle());
+    }
+    drawCaption(img, numDraw, c0, c1, e);
+    return img;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::displayFrame(const cimg_library::CImg<TI>& frame, std::vector<FrameRect>& rects)
+{
+    if(_flagHeadless)
     {
-        c0 = _correspondences(numDraw,0);
-        c1 = _correspondences(numDraw,1);
-        ss << numDraw << " = (";
-        if(c0>=0)   ss << "p" << c0;
-        else        ss << "-";
-        ss << ",";
-        if(c1>=0)   ss << "q" << c1;
-        else        ss << "-";
-        ss << ") = " << _energy[numDraw];
+        rects.clear();
+        return;
     }
-    img.draw_text(0, 0, ss.str().c_str(), _colorTextFg, _colorTextBg, 1, fontsize);
+    _regionDisplay.show(_dispEnergy, frame, rects);
+    rects.clear();
+    if(_regionDisplay.verification())
+    {
+        std::cerr << "frame " << _regionDisplay.numberOfFrames() << ": " << _regionDisplay.numberOfRects() << " rectangles, "
+                  << _regionDisplay.numberOfBytes() << " bytes, " << _regionDisplay.numberOfMismatches() << " pixels differ" << std::endl;
+    }
+}
 
-    /// draw title
-    if(strTitle.length()>0)
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::showRenderedFrame(const int numDraw)
+{
+    const cimg_library::CImg<TI>& img = _renderer.image();
+    _renderer.takeDirtyRects(_dirtyRects);
+    if(_flagHeadless)
     {
-        img.draw_text( (img.width()-strTitle.length()*fontsize)/2, img.height()-fontsize*2, strTitle.c_str(), _colorTextFg, _colorTextBg, 1, fontsize*2);
+        _dirtyRects.clear();
+        return;
     }
+    captionRects(_dirtyRects, img.width(), img.height(), false);
+    if(_pointLabels) _dirtyRects.assign(1, FrameRect(0, 0, img.width()-1, img.height()-1)); // the labels may move anywhere
+    displayFrame(renderedFrame(numDraw), _dirtyRects);
+}
 
-    return img;
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::drawCaption(
+    cimg_library::CImg<TI>& img,
+    const int numDraw,
+    const int c0,
+    const int c1,
+    const double energy,
+    const std::string strTitle
+) const
+{
+    drawMatchingCaption(img, numDraw, c0, c1, energy, strTitle);
 }
 
 template <typename TI, typename TP>
@@ -376,11 +1168,50 @@ cimg_library::CImg<TI> MatchingViewer<TI,TP>::drawMatching(
     const unsigned char colorPt[],
     const unsigned char colorLine[],
     const std::string strTitle
-)
+) const
 {
-    _correspondences = correspondences;
-    _energy = energy;
-    return drawMatching(_img, numDraw, colorPt, colorLine, strTitle);
+    MatchingFrame<TP> f(_points(0), _points(1), correspondences, energy, numDraw);
+    f.style = MatchingStyle(colorPt, colorLine, colorLine);
+    f.title = strTitle;
+    cimg_library::CImg<TI> img(_img);
+    drawMatchingFrame(img, f, _imagesRaw(0).width());
+    return img;
+}
+
+template <typename TI, typename TP>
+MatchingFrame<TP> MatchingViewer<TI,TP>::frame(const int numDraw) const
+{
+    MatchingFrame<TP> f(_points(0), _points(1), _correspondences, _energy, numDraw);
+    f.style = labelStyle();
+    return f;
+}
+
+template <typename TI, typename TP>
+void MatchingViewer<TI,TP>::render(
+    const MatchingFrame<TP>& frame,
+    cimg_library::CImg<TI>& canvas
+) const
+{
+    canvas = _imagesDispRaw(0);
+    drawMatchingFrame(canvas, frame, _imagesRaw(0).width());
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewer<TI,TP>::render(const MatchingFrame<TP>& frame) const
+{
+    cimg_library::CImg<TI> canvas;
+    render(frame, canvas);
+    return canvas;
+}
+
+template <typename TI, typename TP>
+std::vector<cimg_library::CImg<TI> > MatchingViewer<TI,TP>::render(const std::vector<MatchingFrame<TP> >& frames) const
+{
+    std::vector<cimg_library::CImg<TI> > canvases(frames.size());
+    parallelFor((int)frames.size(), [&](const int f){
+        render(frames[f], canvases[f]);
+    });
+    return canvases;
 }
 
 template <typename TI, typename TP>
@@ -391,7 +1222,10 @@ class MatchingViewerMoveMaking :public MatchingViewer<TI,TP>{
     //@{
 public:
     //! Default constructor
-    MatchingViewerMoveMaking(){}
+    MatchingViewerMoveMaking():
+        _flagRefining(false),
+        _numRendered(0)
+    {}
     //! Destructor
     ~MatchingViewerMoveMaking(void){}
     //@}
@@ -420,6 +1254,7 @@ public:
         _correspondencesCurrent = correspondencesCurrent;
         _correspondencesNew = correspondencesNew;
         _correspondencesFusion = correspondencesFusion;
+        MatchingViewer<TI,TP>::_segmentsDirty = true;
     }
 
     // energy
@@ -440,6 +1275,7 @@ public:
         _energyCurrent = energyCurrent;
         _energyNew = energyNew;
         _energyFusion = energyFusion;
+        MatchingViewer<TI,TP>::_segmentsDirty = true;
     }
     //! gets a set of energy \c _energy
     std::vector<double> energy(const int e) const
@@ -449,6 +1285,15 @@ public:
         else            return _energyFusion;
     }
 
+    // resolved segments
+private:
+    std::vector<MatchingSegment> _segmentsCurrent; //!< Resolved segments of \c _correspondencesCurrent.
+    std::vector<MatchingSegment> _segmentsNew; //!< Resolved segments of \c _correspondencesNew.
+    std::vector<MatchingSegment> _segmentsFusion; //!< Resolved segments of \c _correspondencesFusion.
+public:
+    //! resolves the current, new and fused correspondences into segments shared by all the panels.
+    void segmentsUpdate(void);
+
     // displays
     void displayUpdate(void);
     void displayUpdate(
@@ -459,6 +1304,8 @@ public:
         const std::vector<double>& energyNew,
         const std::vector<double>& energyFusion
     );
+    //! draws the next step of the panels of \c displayUpdate, as \c MatchingViewer::displayRefine does for its frame.
+    bool displayRefine(void);
 
     cimg_library::CImg<TI> drawMatching(
         const cimg_library::CImg<TI>& _img,
@@ -471,7 +1318,80 @@ public:
         const unsigned char colorLineCurrent[] = _colorLineCurrent,
         const unsigned char colorLineNew[] = _colorLineNew,
         const std::string strTitle = ""
+    ) const;
+
+    // reentrant rendering
+    ///
+    /// \brief fusionFrame
+    /// describes the fused correspondences: the m-th one links \c correspondencesFusion(m,0) to
+    /// \c correspondencesNew(m,1) if \c correspondencesFusion(m,1)==1, to \c correspondencesCurrent(m,1) otherwise.
+    static MatchingFrame<TP> fusionFrame(
+        const cimg_library::CImg<TP>& points0,
+        const cimg_library::CImg<TP>& points1,
+        const cimg_library::CImg<int>& correspondencesCurrent,
+        const cimg_library::CImg<int>& correspondencesNew,
+        const cimg_library::CImg<int>& correspondencesFusion,
+        const std::vector<double>& energyFusion,
+        const int numDraw
     );
+    //! returns the descriptions of the current, new and fused panels, drawn up to the correspondence \c numDraw.
+    std::vector<MatchingFrame<TP> > panelFrames(const int numDraw) const;
+    //! returns the panels \c panels drawn on the aligned images, stacked. The viewer is only read.
+    cimg_library::CImg<TI> renderPanels(const std::vector<MatchingFrame<TP> >& panels) const;
+
+    // panels
+private:
+    ProgressiveRenderer<TI> _renderers[3]; //!< The renderers of the current, new and fused panels.
+    bool _flagRefining; //!< A flag indicating the panels of \c displayUpdate are not complete and published yet.
+    int _numRendered; //!< The correspondence up to which the panels of \c displayUpdate are drawn.
+public:
+    //! returns the segments of the panel \c p: 0 current, 1 new, 2 fused.
+    const std::vector<MatchingSegment>& panelSegments(const int p) const {return p == 0 ? _segmentsCurrent : p == 1 ? _segmentsNew : _segmentsFusion;}
+    //! returns the segments of the panel \c p, resolving them if any input has been set since the last update.
+    const std::vector<MatchingSegment>& panelSegments(const int p)
+    {
+        if(MatchingViewer<TI,TP>::_segmentsDirty) segmentsUpdate();
+        return p == 0 ? _segmentsCurrent : p == 1 ? _segmentsNew : _segmentsFusion;
+    }
+    //! returns the line colors of the panel \c p, indexed by the segment labels.
+    static const unsigned char* const* panelColors(const int p)
+    {
+        static const unsigned char* const colors[3][2] = {
+            {_colorLineCurrent, _colorLineCurrent},
+            {_colorLineNew, _colorLineNew},
+            {_colorLineCurrent, _colorLineNew}
+        };
+        return colors[p];
+    }
+    //! returns the title of the panel \c p.
+    static const char* panelTitle(const int p){return p == 0 ? "Current matching" : p == 1 ? "Proposed matching" : "Fused matching";}
+    //! returns the points and the energy of the correspondence \c numDraw in the panel \c p, -1 and 0 if out of range.
+    void panelCaption(
+        const int p,
+        const int numDraw,
+        int& c0,
+        int& c1,
+        double& energy
+    ) const;
+    //! draws the panel \c p on \c _img.
+    cimg_library::CImg<TI> updateImage(
+        const int p,
+        const cimg_library::CImg<TI>& _img,
+        const int numDraw
+    );
+    //! starts drawing the panels of the correspondences up to \c numDraw within \c budget, the frame budget if negative;
+    //! if \c flagUpdate is true, a complete panel is updated instead when few of its correspondences changed.
+    void panelsBegin(const int numDraw, const bool flagUpdate = false, const double budget = -1);
+    //! draws the next segments of the panels; returns true when they are complete.
+    bool panelsStep(void);
+    //! returns true when the panels are complete.
+    bool panelsDone(void) const {return _renderers[0].done() && _renderers[1].done() && _renderers[2].done();}
+    //! returns true if a panel changed since the panels were last shown.
+    bool panelsChanged(void) const {return _renderers[0].changed() || _renderers[1].changed() || _renderers[2].changed();}
+    //! returns the panels drawn so far, stacked and captioned.
+    cimg_library::CImg<TI> panelsFrame(const int numDraw);
+    //! shows the panels drawn so far, sending only the rectangles changed since they were last shown.
+    void showPanels(const int numDraw);
 
     cimg_library::CImg<TI> updateImageCurrent(
         const cimg_library::CImg<TI>& _img,
@@ -492,13 +1412,63 @@ public:
 
 };
 
+template <typename TI, typename TP>
+void MatchingViewerMoveMaking<TI,TP>::segmentsUpdate(void)
+{
+    const int offset = MatchingViewer<TI,TP>::image(0).width();
+    const cimg_library::CImg<TP>& point0 = MatchingViewer<TI,TP>::point(0);
+    const cimg_library::CImg<TP>& point1 = MatchingViewer<TI,TP>::point(1);
+    resolveSegments(_segmentsCurrent, point0, point1, _correspondencesCurrent, _energyCurrent, offset);
+    resolveSegments(_segmentsNew, point0, point1, _correspondencesNew, _energyNew, offset);
+    resolveSegments(_segmentsFusion, point0, point1, _correspondencesCurrent, _correspondencesNew, _correspondencesFusion, _energyFusion, offset);
+    MatchingViewer<TI,TP>::_segmentsDirty = false;
+}
+
+template <typename TI, typename TP>
+void MatchingViewerMoveMaking<TI,TP>::panelCaption(
+    const int p,
+    const int numDraw,
+    int& c0,
+    int& c1,
+    double& energy
+) const
+{
+    const cimg_library::CImg<int>& correspondences = p == 0 ? _correspondencesCurrent : p == 1 ? _correspondencesNew : _correspondencesFusion;
+    const std::vector<double>& energies = p == 0 ? _energyCurrent : p == 1 ? _energyNew : _energyFusion;
+    c0 = c1 = -1;
+    energy = 0.0;
+    if(numDraw>=0 && numDraw<correspondences.width())
+    {
+        c0 = correspondences(numDraw,0);
+        c1 = correspondences(numDraw,1);
+        if(p == 2)
+        {
+            c1 = (correspondences(numDraw,1) == 1) ? _correspondencesNew(numDraw,1) : _correspondencesCurrent(numDraw,1);
+        }
+        energy = energies[numDraw];
+    }
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::updateImage(
+    const int p,
+    const cimg_library::CImg<TI>& _img,
+    const int numDraw
+)
+{
+    int c0, c1;
+    double e;
+    panelCaption(p, numDraw, c0, c1, e);
+    return MatchingViewer<TI,TP>::drawMatching( _img, panelSegments(p), numDraw, c0, c1, e, _colorPt, panelColors(p), panelTitle(p));
+}
+
 template <typename TI, typename TP>
 cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::updateImageCurrent(
     const cimg_library::CImg<TI>& _img,
     const int numDraw
 )
 {
-    return MatchingViewer<TI,TP>::drawMatching( _img, _correspondencesCurrent, _energyCurrent, numDraw, _colorPt, _colorLineCurrent, "Current matching");
+    return updateImage(0, _img, numDraw);
 }
 
 template <typename TI, typename TP>
@@ -507,7 +1477,7 @@ cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::updateImageNew(
     const int numDraw
 )
 {
-    return MatchingViewer<TI,TP>::drawMatching( _img, _correspondencesNew, _energyNew, numDraw, _colorPt, _colorLineNew, "Proposed matching");
+    return updateImage(1, _img, numDraw);
 }
 
 template <typename TI, typename TP>
@@ -516,7 +1486,71 @@ cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::updateImageFusion(
     const int numDraw
 )
 {
-    return drawMatching( _img, _correspondencesCurrent, _correspondencesNew, _correspondencesFusion, _energyFusion, numDraw, _colorPt, _colorLineCurrent, _colorLineNew, "Fused matching");
+    return updateImage(2, _img, numDraw);
+}
+
+template <typename TI, typename TP>
+void MatchingViewerMoveMaking<TI,TP>::panelsBegin(const int numDraw, const bool flagUpdate, const double budgetFrame)
+{
+    // the panels share the budget
+    const double budget = (budgetFrame < 0 ? MatchingViewer<TI,TP>::frameBudget() : budgetFrame)/3;
+    const MatchingViewer<TI,TP>& view = *this;
+    const unsigned long long revision = view.imagesRevision();
+    for(int p = 0; p < 3; ++p)
+    {
+        if(flagUpdate && _renderers[p].update(view.imgAlign(), revision, panelSegments(p), numDraw,
+                                              view.renderOrder(), _colorPt, panelColors(p), view.redrawRatio())) continue;
+        _renderers[p].begin(view.imgAlign(), revision, panelSegments(p), numDraw,
+                            view.renderOrder(), _colorPt, panelColors(p), budget);
+    }
+}
+
+template <typename TI, typename TP>
+bool MatchingViewerMoveMaking<TI,TP>::panelsStep(void)
+{
+    bool flagDone = true;
+    for(int p = 0; p < 3; ++p)
+    {
+        flagDone = _renderers[p].step() && flagDone;
+    }
+    return flagDone;
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::panelsFrame(const int numDraw)
+{
+    cimg_library::CImg<TI> panels[3];
+    for(int p = 0; p < 3; ++p)
+    {
+        int c0, c1;
+        double e;
+        panelCaption(p, numDraw, c0, c1, e);
+        panels[p] = _renderers[p].image();
+        if(MatchingViewer<TI,TP>::pointLabels() && _renderers[p].done())
+        {
+            const std::vector<MatchingSegment>& segments = panelSegments(p);
+            drawMatchingLabels(panels[p], segments.data(), numberOfSegments(segments, numDraw), true, MatchingViewer<TI,TP>::labelStyle());
+        }
+        MatchingViewer<TI,TP>::drawCaption(panels[p], numDraw, c0, c1, e, panelTitle(p));
+    }
+    const cimg_library::CImg<TI>* stack[] = {&panels[0], &panels[1], &panels[2]};
+    return stackImages(stack, 3);
+}
+
+template <typename TI, typename TP>
+void MatchingViewerMoveMaking<TI,TP>::showPanels(const int numDraw)
+{
+    std::vector<FrameRect> rects;
+    for(int p = 0; p < 3; ++p)
+    {
+        const cimg_library::CImg<TI>& img = _renderers[p].image();
+        const int dy = p*img.height();
+        _renderers[p].takeDirtyRects(rects, 0, dy);
+        captionRects(rects, img.width(), img.height(), true, MatchingStyle(), dy);
+        if(MatchingViewer<TI,TP>::pointLabels()) rects.push_back(FrameRect(0, dy, img.width()-1, dy+img.height()-1));
+    }
+    if(MatchingViewer<TI,TP>::headless()) return;
+    MatchingViewer<TI,TP>::displayFrame(panelsFrame(numDraw), rects);
 }
 
 template <typename TI, typename TP>
@@ -528,60 +1562,97 @@ cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::updateImages(
     cimg_library::CImg<TI> imgCurrent = updateImageCurrent(_img, numDraw);
     cimg_library::CImg<TI> imgNew = updateImageNew(_img, numDraw);
     cimg_library::CImg<TI> imgFusion = updateImageFusion(_img, numDraw);
-    return imgCurrent.append(imgNew,'y').append(imgFusion,'y');
+    const cimg_library::CImg<TI>* panels[] = {&imgCurrent, &imgNew, &imgFusion};
+    return stackImages(panels, 3);
+}
+
+template <typename TI, typename TP>
+bool MatchingViewerMoveMaking<TI,TP>::displayRefine(void)
+{
+    if(!_flagRefining) return true;
+    const bool flagDone = panelsStep();
+    if(panelsChanged()) showPanels(_numRendered);
+    if(!flagDone) return false;
+    // the status summarizes the fused correspondences, the result of the iteration
+    MatchingViewer<TI,TP>::serveFrame(panelsFrame(_numRendered), _correspondencesFusion.width(), _energyFusion);
+    _flagRefining = false;
+    return true;
 }
 
 template <typename TI, typename TP>
 void MatchingViewerMoveMaking<TI,TP>::displayUpdate(void)
 {
-    cimg_library::CImg<TI> imgShow(MatchingViewer<TI,TP>::imgAlign());
-    updateImages(imgShow, numberOfCorrespondences()).display( MatchingViewer<TI,TP>::dispEnergy() );
+    if(MatchingViewer<TI,TP>::imagesPreview() && !MatchingViewer<TI,TP>::headless())
+    { // show the matching on the previews until the images are decoded
+        segmentsUpdate();
+        const MatchingViewer<TI,TP>& view = *this;
+        MatchingViewer<TI,TP>::displayPreview( updateImages(view.imgAlign(), numberOfCorrespondences()) );
+    }
+    MatchingViewer<TI,TP>::imagesWait();
+    segmentsUpdate();
+    cimg_library::CImgDisplay& disp = MatchingViewer<TI,TP>::dispEnergy();
+    if(MatchingViewer<TI,TP>::flagPlot())
+    { // the flips are the fused correspondences taken from the proposal
+        const std::vector<double>* energies[] = {&_energyCurrent, &_energyNew, &_energyFusion};
+        const int numFusion = _correspondencesFusion.width();
+        const int numFlips = numFusion > 0 && _correspondencesFusion.height() > 1 ?
+                    (int)pixelKernels().countEqual(_correspondencesFusion.data(0, 1), 1, numFusion) : 0;
+        MatchingViewer<TI,TP>::plotUpdate(energies, 3, numFlips, numFusion);
+    }
+    if(MatchingViewer<TI,TP>::flagTrans())
+    { // the fused correspondences, resolved to the current or the new point
+        cimg_library::CImg<int> fused(_correspondencesFusion.width(), 2);
+        for(int m = 0; m < fused.width(); ++m)
+        {
+            fused(m,0) = _correspondencesFusion(m,0);
+            fused(m,1) = _correspondencesFusion(m,1) == 1 ? _correspondencesNew(m,1) : _correspondencesCurrent(m,1);
+        }
+        MatchingViewer<TI,TP>::transformUpdate(fused);
+    }
 
-    if(!MatchingViewer<TI,TP>::flagDebug())
-    { // non-debug mode
-        MatchingViewer<TI,TP>::dispEnergy().wait(300);
-        updateImages(imgShow, numberOfCorrespondences()).display( MatchingViewer<TI,TP>::dispEnergy() );
+    if(!MatchingViewer<TI,TP>::flagDebug() || MatchingViewer<TI,TP>::headless())
+    { // non-debug mode: refine the frame until it is complete, or only its first step if asynchronous
+        const bool flagAsync = MatchingViewer<TI,TP>::displayAsync();
+        _numRendered = numberOfCorrespondences();
+        _flagRefining = true;
+        panelsBegin(_numRendered, true);
+        bool flagDone;
+        do
+        {
+            flagDone = displayRefine();
+        }
+        while(!flagDone && !flagAsync && (MatchingViewer<TI,TP>::headless() || !disp.is_closed()));
+        if(!MatchingViewer<TI,TP>::headless() && !flagAsync) disp.wait(300);
     }
     else
-    { // debug mode
-        int numPointCur = 0, numPointPrev;
-        bool _flag = true;
-        updateImages(imgShow, numPointCur).display( MatchingViewer<TI,TP>::dispEnergy() );
-        while(_flag)
+    {
+        _flagRefining = false; // debug mode: the input is merged into one target, rendered at most once per refresh
+        BrowseScheduler browse(-1, _correspondencesCurrent.width()-1);
+        browse.target(0);
+        const double budget = browse.budget(MatchingViewer<TI,TP>::frameBudget());
+        int numPointCur = browse.target();
+        panelsBegin(numPointCur, false, budget);
+        browse.rendered();
+        panelsStep();
+        showPanels(numPointCur);
+        for(;;)
         {
-            // check any user input
-            MatchingViewer<TI,TP>::dispEnergy().wait();
-            // retrieve the input
-            if(MatchingViewer<TI,TP>::dispEnergy().wheel()!=0)
-            {
-                numPointCur += MatchingViewer<TI,TP>::dispEnergy().wheel();
-                MatchingViewer<TI,TP>::dispEnergy().set_wheel();
-            }
-
-            if(MatchingViewer<TI,TP>::dispEnergy().is_keyARROWDOWN() || MatchingViewer<TI,TP>::dispEnergy().is_keyARROWLEFT())
-            {
-                --numPointCur;
+            // wait for an event only when the panels shown are complete and current
+            browse.poll(disp, panelsDone() && browse.target() == numPointCur);
+            if(browse.quit()) break;
+            if(browse.target() != numPointCur && browse.due())
+            { // the render of the previous target is dropped, complete or not
+                numPointCur = browse.target();
+                panelsBegin(numPointCur, true, budget);
+                browse.rendered();
             }
-            if(MatchingViewer<TI,TP>::dispEnergy().is_keyARROWUP() || MatchingViewer<TI,TP>::dispEnergy().is_keyARROWRIGHT())
-            {
-                ++numPointCur;
-            }
-            if(MatchingViewer<TI,TP>::dispEnergy().is_keyQ() || MatchingViewer<TI,TP>::dispEnergy().is_keyESC())
-            {
-                _flag = false;
-            }
-
-            // update the image
-            else
-            { // update the image
-                numPointCur = std::min(_correspondencesCurrent.width()-1,numPointCur);
-                numPointCur = std::max(numPointCur, -1);
-                if(numPointCur != numPointPrev)
-                {
-                    updateImages(imgShow, numPointCur).display( MatchingViewer<TI,TP>::dispEnergy() );
-                    numPointPrev = numPointCur;
-                }
+            else if(panelsDone())
+            { // the new target waits for the next refresh
+                cimg_library::cimg::sleep(browse.delay());
+                continue;
             }
+            panelsStep();
+            showPanels(numPointCur);
         }
     }
 }
@@ -623,82 +1694,84 @@ cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::drawMatching(
     const unsigned char colorLineCurrent[],
     const unsigned char colorLineNew[],
     const std::string strTitle
-)
+) const
 {
+    MatchingFrame<TP> f = fusionFrame(
+        MatchingViewer<TI,TP>::point(0),
+        MatchingViewer<TI,TP>::point(1),
+        correspondencesCurrent,
+        correspondencesNew,
+        correspondencesFusion,
+        energyFusion,
+        numDraw
+    );
+    f.style = MatchingStyle(colorPt, colorLineCurrent, colorLineNew);
+    f.title = strTitle;
     cimg_library::CImg<TI> img(_img);
-    int offset = MatchingViewer<TI,TP>::image(0).width();
-    int radius = 4;
-    int x0, y0, x1, y1;
-    int i0, i1;
-
-    bool flagFusion;
-    /// draw matching
-    for(int m = 0; m <= numDraw; ++m)
-    {
-        i0 = correspondencesFusion(m,0);
-        if(correspondencesFusion(m,1) == 1)
-        {
-            flagFusion = true;
-            i1 = correspondencesNew(m,1);
-        }
-        else
-        {
-            flagFusion = false;
-            i1 = correspondencesCurrent(m,1);
-        }
-        if(i0>=0 && i0< MatchingViewer<TI,TP>::point(0).width() && i1>=0 && i1<MatchingViewer<TI,TP>::point(1).width())
-        {
-            x0 = MatchingViewer<TI,TP>::point(0)(i0,0);
-            y0 = MatchingViewer<TI,TP>::point(0)(i0,1);
-            x1 = MatchingViewer<TI,TP>::point(1)(i1,0)+offset;
-            y1 = MatchingViewer<TI,TP>::point(1)(i1,1);
-            if(flagFusion)
-            {
-                draw_line_thick(img, x0, y0, x1, y1, colorLineNew, radius/2);
-            }
-            else
-            {
-                draw_line_thick(img, x0, y0, x1, y1, colorLineCurrent, radius/2);
-            }
-            img.draw_circle(x0, y0, radius, colorPt, 1.f);
-            img.draw_circle(x1, y1, radius, colorPt, 1.f);
-//            img.draw_triangle(x1, y1-radius, x1-radius, y1+radius, x1+radius, y1+radius, _colorPt);
-        }
-    }
+    drawMatchingFrame(img, f, MatchingViewer<TI,TP>::image(0).width());
+    return img;
+}
 
-    /// draw energy
-    int fontsize = 25;
-    int c0, c1;
-    std::stringstream ss;
-    ss << "correspondence#";
-    if(numDraw>=0)
+template <typename TI, typename TP>
+MatchingFrame<TP> MatchingViewerMoveMaking<TI,TP>::fusionFrame(
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const cimg_library::CImg<int>& correspondencesCurrent,
+    const cimg_library::CImg<int>& correspondencesNew,
+    const cimg_library::CImg<int>& correspondencesFusion,
+    const std::vector<double>& energyFusion,
+    const int numDraw
+)
+{
+    const int numCorrespondences = correspondencesFusion.width();
+    MatchingFrame<TP> f(points0, points1, cimg_library::CImg<int>(), energyFusion, numDraw);
+    if(numCorrespondences == 0) return f;
+    f.correspondences.assign(numCorrespondences, 2);
+    f.labels.resize(numCorrespondences);
+    for(int m = 0; m < numCorrespondences; ++m)
     {
-        c0 = correspondencesFusion(numDraw,0);
-        if(correspondencesFusion(numDraw,1) == 1)
-        {
-            c1 = correspondencesNew(numDraw,1);
-        }
-        else
-        {
-            c1 = correspondencesCurrent(numDraw,1);
-        }
-        ss << numDraw << " = (";
-        if(c0>=0)   ss << "p" << c0;
-        else        ss << "-";
-        ss << ",";
-        if(c1>=0)   ss << "q" << c1;
-        else        ss << "-";
-        ss << ") = " << energyFusion[numDraw];
+        f.labels[m] = (correspondencesFusion(m,1) == 1);
+        f.correspondences(m,0) = correspondencesFusion(m,0);
+        f.correspondences(m,1) = f.labels[m] ? correspondencesNew(m,1) : correspondencesCurrent(m,1);
     }
-    img.draw_text(0, 0, ss.str().c_str(), _colorTextFg, _colorTextBg, 1, fontsize);
+    return f;
+}
 
-    /// draw title
-    if(strTitle.length()>0)
+template <typename TI, typename TP>
+std::vector<MatchingFrame<TP> > MatchingViewerMoveMaking<TI,TP>::panelFrames(const int numDraw) const
+{
+    const cimg_library::CImg<TP>& point0 = MatchingViewer<TI,TP>::point(0);
+    const cimg_library::CImg<TP>& point1 = MatchingViewer<TI,TP>::point(1);
+    std::vector<MatchingFrame<TP> > panels(3);
+    panels[0] = MatchingFrame<TP>(point0, point1, _correspondencesCurrent, _energyCurrent, numDraw);
+    panels[1] = MatchingFrame<TP>(point0, point1, _correspondencesNew, _energyNew, numDraw);
+    panels[2] = fusionFrame(point0, point1, _correspondencesCurrent, _correspondencesNew, _correspondencesFusion, _energyFusion, numDraw);
+    for(int p = 0; p < 3; ++p)
     {
-        img.draw_text( (img.width()-strTitle.length()*fontsize)/2, img.height()-fontsize*2, strTitle.c_str(), _colorTextFg, _colorTextBg, 1, fontsize*2);
+        panels[p].style = MatchingStyle(_colorPt, panelColors(p)[0], panelColors(p)[1]);
+        panels[p].style.pointLabels = MatchingViewer<TI,TP>::labelStyle().pointLabels;
+        panels[p].style.labelPriority = MatchingViewer<TI,TP>::labelStyle().labelPriority;
+        panels[p].title = panelTitle(p);
     }
+    return panels;
+}
 
-    return img;
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewerMoveMaking<TI,TP>::renderPanels(const std::vector<MatchingFrame<TP> >& panels) const
+{
+    std::vector<cimg_library::CImg<TI> > images = MatchingViewer<TI,TP>::render(panels);
+    std::vector<const cimg_library::CImg<TI>*> stack(images.size());
+    for(size_t p = 0; p < images.size(); ++p) stack[p] = &images[p];
+    return stackImages(stack.empty() ? 0 : &stack[0], (int)stack.size());
 }
 
+#ifdef CIMG_MATCHING_VIEWER_EXTERN
+// compiled once in the matchingviewer library, one object per class and point type (cimgMatchingViewerInt.cpp, ...),
+// not in each program including this header
+extern template class MatchingViewer<unsigned char, int>;
+extern template class MatchingViewer<unsigned char, float>;
+extern template class MatchingViewerMoveMaking<unsigned char, int>;
+extern template class MatchingViewerMoveMaking<unsigned char, float>;
+#endif
+
 #endif
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <CImg.h>
+
+// the viewers are instantiated in their own objects, cimgMatchingViewerInt.cpp and the like
+#ifndef CIMG_MATCHING_VIEWER_EXTERN
+#define CIMG_MATCHING_VIEWER_EXTERN
+#endif
+
+#include "cimgFrameEncoder.hpp"
+#include "cimgMatchingIO.hpp"
+#include "cimgMatchingViewer.hpp"
+#include "cimgMatchingViewerApi.hpp"
+
+namespace
+{
+
+//! returns false, with a message naming \c what, if the sizes \c size0 and \c size1 differ.
+inline bool sameSize(const size_t size0, const size_t size1, const char* what)
+{
+    if(size0 != size1)
+    {
+        std::cerr << "the numbers of " << what << " differ (" << size0 << " and " << size1 << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//! returns the points of coordinates \c x and \c y, of the same size, as the viewers store them.
+template <typename TP>
+cimg_library::CImg<TP> pointSet(
+    const std::vector<TP>& x,
+    const std::vector<TP>& y
+)
+{
+    const int numPoints = (int)x.size();
+    cimg_library::CImg<TP> points(numPoints, 2);
+    for(int m = 0; m < numPoints; ++m)
+    {
+        points(m,0) = x[m];
+        points(m,1) = y[m];
+    }
+    return points;
+}
+
+//! returns the correspondences from the points \c point0 to the points \c point1, of the same size.
+inline cimg_library::CImg<int> correspondenceSet(
+    const std::vector<int>& point0,
+    const std::vector<int>& point1
+)
+{
+    return pointSet(point0, point1);
+}
+
+//! saves \c img to \c strFile; returns false on error.
+inline bool saveImage(const cimg_library::CImg<unsigned char>& img, const std::string& strFile)
+{
+    if(!saveFrame(img, strFile))
+    {
+        std::cerr << "cannot save " << strFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+template <typename TP>
+struct MatchingView<TP>::Impl
+{
+    MatchingViewer<unsigned char, TP> view;
+};
+
+template <typename TP>
+MatchingView<TP>::MatchingView(void):
+    _impl(new Impl)
+{}
+
+template <typename TP>
+MatchingView<TP>::~MatchingView(void)
+{}
+
+template <typename TP>
+void MatchingView<TP>::images(const std::vector<std::string>& strImage)
+{
+    _impl->view.imagesAsync(strImage);
+}
+
+template <typename TP>
+int MatchingView<TP>::width(const int n)
+{
+    _impl->view.imagesWait();
+    return _impl->view.width(n);
+}
+
+template <typename TP>
+int MatchingView<TP>::height(const int n)
+{
+    _impl->view.imagesWait();
+    return _impl->view.height(n);
+}
+
+template <typename TP>
+bool MatchingView<TP>::points(const int n, const std::vector<TP>& x, const std::vector<TP>& y)
+{
+    if(!sameSize(x.size(), y.size(), "coordinates")) return false;
+    _impl->view.point(n, pointSet(x, y));
+    return true;
+}
+
+template <typename TP>
+bool MatchingView<TP>::correspondences(const std::vector<int>& point0, const std::vector<int>& point1)
+{
+    if(!sameSize(point0.size(), point1.size(), "points of the correspondences")) return false;
+    _impl->view.correspondences(correspondenceSet(point0, point1));
+    return true;
+}
+
+template <typename TP>
+void MatchingView<TP>::energy(const std::vector<double>& energy)
+{
+    _impl->view.energy(energy);
+}
+
+template <typename TP>
+int MatchingView<TP>::numberOfCorrespondences(void) const
+{
+    return _impl->view.numberOfCorrespondences();
+}
+
+template <typename TP>
+bool MatchingView<TP>::load(
+    const std::string& strPoints0,
+    const std::string& strPoints1,
+    const std::string& strCorrespondences,
+    const std::string& strEnergy
+)
+{
+    MatchingViewer<unsigned char, TP>& view = _impl->view;
+    cimg_library::CImg<TP> point0, point1;
+    cimg_library::CImg<int> correspondences;
+    std::vector<double> energy;
+    if(!loadPoints(strPoints0, point0) ||
+       !loadPoints(strPoints1, point1) ||
+       !loadCorrespondences(strCorrespondences, correspondences))
+    {
+        return false;
+    }
+    if(!strEnergy.empty())
+    {
+        if(!loadEnergy(strEnergy, energy)) return false;
+    }
+    else
+    {
+        energy.assign(correspondences.width(), 0.0);
+    }
+    if((int)energy.size() != correspondences.width())
+    {
+        std::cerr << "the numbers of correspondences and energies differ" << std::endl;
+        return false;
+    }
+    view.points(point0, point1);
+    view.correspondences(correspondences);
+    view.energy(energy);
+    return true;
+}
+
+template <typename TP>
+void MatchingView<TP>::flagDebug(const bool flagDebug)
+{
+    _impl->view.flagDebug(flagDebug);
+}
+
+template <typename TP>
+void MatchingView<TP>::frameBudget(const double frameBudget)
+{
+    _impl->view.frameBudget(frameBudget);
+}
+
+template <typename TP>
+void MatchingView<TP>::displayUpdate(void)
+{
+    _impl->view.displayUpdate();
+}
+
+template <typename TP>
+bool MatchingView<TP>::save(const std::string& strFile)
+{
+    _impl->view.imagesWait();
+    return saveImage(_impl->view.render(_impl->view.frame()), strFile);
+}
+
+template <typename TP>
+struct MatchingViewMoveMaking<TP>::Impl
+{
+    MatchingViewerMoveMaking<unsigned char, TP> view;
+};
+
+template <typename TP>
+MatchingViewMoveMaking<TP>::MatchingViewMoveMaking(void):
+    _impl(new Impl)
+{}
+
+template <typename TP>
+MatchingViewMoveMaking<TP>::~MatchingViewMoveMaking(void)
+{}
+
+template <typename TP>
+void MatchingViewMoveMaking<TP>::images(const std::vector<std::string>& strImage)
+{
+    _impl->view.imagesAsync(strImage);
+}
+
+template <typename TP>
+int MatchingViewMoveMaking<TP>::width(const int n)
+{
+    _impl->view.imagesWait();
+    return _impl->view.width(n);
+}
+
+template <typename TP>
+int MatchingViewMoveMaking<TP>::height(const int n)
+{
+    _impl->view.imagesWait();
+    return _impl->view.height(n);
+}
+
+template <typename TP>
+bool MatchingViewMoveMaking<TP>::points(const int n, const std::vector<TP>& x, const std::vector<TP>& y)
+{
+    if(!sameSize(x.size(), y.size(), "coordinates")) return false;
+    _impl->view.point(n, pointSet(x, y));
+    return true;
+}
+
+template <typename TP>
+bool MatchingViewMoveMaking<TP>::correspondences(
+    const std::vector<int>& point0,
+    const std::vector<int>& pointCurrent,
+    const std::vector<int>& pointNew,
+    const std::vector<int>& fusion
+)
+{
+    if(!sameSize(point0.size(), pointCurrent.size(), "points of the current correspondences") ||
+       !sameSize(point0.size(), pointNew.size(), "points of the proposed correspondences") ||
+       !sameSize(point0.size(), fusion.size(), "points of the fused correspondences"))
+    {
+        return false;
+    }
+    _impl->view.correspondences(correspondenceSet(point0, pointCurrent),
+                                correspondenceSet(point0, pointNew),
+                                correspondenceSet(point0, fusion));
+    return true;
+}
+
+template <typename TP>
+void MatchingViewMoveMaking<TP>::energy(
+    const std::vector<double>& energyCurrent,
+    const std::vector<double>& energyNew,
+    const std::vector<double>& energyFusion
+)
+{
+    _impl->view.energy(energyCurrent, energyNew, energyFusion);
+}
+
+template <typename TP>
+int MatchingViewMoveMaking<TP>::numberOfCorrespondences(void) const
+{
+    return _impl->view.numberOfCorrespondences();
+}
+
+template <typename TP>
+void MatchingViewMoveMaking<TP>::flagDebug(const bool flagDebug)
+{
+    _impl->view.flagDebug(flagDebug);
+}
+
+template <typename TP>
+void MatchingViewMoveMaking<TP>::frameBudget(const double frameBudget)
+{
+    _impl->view.frameBudget(frameBudget);
+}
+
+template <typename TP>
+void MatchingViewMoveMaking<TP>::displayUpdate(void)
+{
+    _impl->view.displayUpdate();
+}
+
+template <typename TP>
+bool MatchingViewMoveMaking<TP>::save(const std::string& strFile)
+{
+    MatchingViewerMoveMaking<unsigned char, TP>& view = _impl->view;
+    view.imagesWait();
+    return saveImage(view.renderPanels(view.panelFrames(view.numberOfCorrespondences())), strFile);
+}
+
+template class MatchingView<int>;
+template class MatchingView<float>;
+template class MatchingViewMoveMaking<int>;
+template class MatchingViewMoveMaking<float>;
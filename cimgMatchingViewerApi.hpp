@@ -0,0 +1,120 @@
+#ifndef cimgMatchingViewerApi
+#define cimgMatchingViewerApi
+
+#include <memory>
+#include <string>
+#include <vector>
+
+///
+/// \brief The MatchingView class
+/// A \c MatchingViewer<unsigned char,TP> behind a header that includes neither \c CImg.h nor the viewer,
+/// for the tools that embed the viewer: it is compiled once, for int and float points, in the
+/// \c matchingviewer library (cimgMatchingViewerApi.cpp) they link to.
+template <typename TP>
+class MatchingView
+{
+public:
+    //! Default constructor
+    MatchingView(void);
+    //! Destructor
+    ~MatchingView(void);
+
+    //! loads the images \c strImage; they are decoded in the background until they are first needed.
+    void images(const std::vector<std::string>& strImage);
+    //! returns the width of the image \c n.
+    int width(const int n);
+    //! returns the height of the image \c n.
+    int height(const int n);
+
+    //! sets the points of the image \c n from their coordinates \c x and \c y; returns false if their sizes differ.
+    bool points(const int n, const std::vector<TP>& x, const std::vector<TP>& y);
+    //! sets the correspondences from the points \c point0 of image 0 to the points \c point1 of image 1, -1 for none;
+    //! returns false if their sizes differ.
+    bool correspondences(const std::vector<int>& point0, const std::vector<int>& point1);
+    //! sets the energy of each correspondence.
+    void energy(const std::vector<double>& energy);
+    //! returns the number of correspondences.
+    int numberOfCorrespondences(void) const;
+    //! loads the points, the correspondences and, if \c strEnergy is not empty, the energy from CSV or binary files;
+    //! returns false on error.
+    bool load(
+        const std::string& strPoints0,
+        const std::string& strPoints1,
+        const std::string& strCorrespondences,
+        const std::string& strEnergy = ""
+    );
+
+    //! sets the debug mode, in which the correspondences are browsed one by one.
+    void flagDebug(const bool flagDebug);
+    //! sets the time budget of a frame in milliseconds, 0 for no limit.
+    void frameBudget(const double frameBudget);
+    //! displays the matching until the window is closed.
+    void displayUpdate(void);
+    //! saves the matching drawn on the aligned images to \c strFile; returns false on error.
+    bool save(const std::string& strFile);
+
+private:
+    MatchingView(const MatchingView&);
+    MatchingView& operator=(const MatchingView&);
+
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+///
+/// \brief The MatchingViewMoveMaking class
+/// A \c MatchingViewerMoveMaking<unsigned char,TP> behind a header that does not include \c CImg.h, as \c MatchingView.
+template <typename TP>
+class MatchingViewMoveMaking
+{
+public:
+    //! Default constructor
+    MatchingViewMoveMaking(void);
+    //! Destructor
+    ~MatchingViewMoveMaking(void);
+
+    //! loads the images \c strImage; they are decoded in the background until they are first needed.
+    void images(const std::vector<std::string>& strImage);
+    //! returns the width of the image \c n.
+    int width(const int n);
+    //! returns the height of the image \c n.
+    int height(const int n);
+
+    //! sets the points of the image \c n from their coordinates \c x and \c y; returns false if their sizes differ.
+    bool points(const int n, const std::vector<TP>& x, const std::vector<TP>& y);
+    //! sets the correspondences from the points \c point0 of image 0 to the points \c pointCurrent of the current
+    //! matching and \c pointNew of the proposed one, -1 for none; \c fusion is 1 where the fused matching takes
+    //! the proposed point, 0 where it keeps the current one and -1 for none. Returns false if their sizes differ.
+    bool correspondences(
+        const std::vector<int>& point0,
+        const std::vector<int>& pointCurrent,
+        const std::vector<int>& pointNew,
+        const std::vector<int>& fusion
+    );
+    //! sets the energy of the current, proposed and fused correspondences.
+    void energy(
+        const std::vector<double>& energyCurrent,
+        const std::vector<double>& energyNew,
+        const std::vector<double>& energyFusion
+    );
+    //! returns the number of correspondences.
+    int numberOfCorrespondences(void) const;
+
+    //! sets the debug mode, in which the correspondences are browsed one by one.
+    void flagDebug(const bool flagDebug);
+    //! sets the time budget of a frame in milliseconds, 0 for no limit.
+    void frameBudget(const double frameBudget);
+    //! displays the current, proposed and fused matchings until the window is closed.
+    void displayUpdate(void);
+    //! saves the three panels to \c strFile; returns false on error.
+    bool save(const std::string& strFile);
+
+private:
+    MatchingViewMoveMaking(const MatchingViewMoveMaking&);
+    MatchingViewMoveMaking& operator=(const MatchingViewMoveMaking&);
+
+    struct Impl;
+    std::unique_ptr<Impl> _impl;
+};
+
+#endif
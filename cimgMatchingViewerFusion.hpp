@@ -0,0 +1,390 @@
+#ifndef cimgMatchingViewerFusion
+#define cimgMatchingViewerFusion
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "cimgMatchingViewer.hpp"
+#include <CImg.h>
+
+//! The default colors of the proposals; the first two are those of the current and new correspondences.
+static const unsigned char _colorsProposal[8][3] = {
+    {255, 0, 0}, {0, 0, 255}, {0, 160, 0}, {255, 128, 0},
+    {160, 0, 160}, {0, 160, 160}, {128, 128, 0}, {96, 96, 96}
+};
+
+///
+/// \brief The MatchingViewerFusion class
+/// shows the fusion of K proposals, e.g. the sweeps of an alpha-expansion, where \c MatchingViewerMoveMaking
+/// shows two. The proposals are held once, as the rows of \c _proposals, and the fused matching as one byte per
+/// correspondence, the proposal it is taken from; its segments are resolved from the selected proposal directly.
+/// The panels, a selection of the proposals and the fused matching, are rendered concurrently and laid out in a
+/// grid. The lines of a proposal, and those of the fused correspondences taken from it, have its color in the palette.
+template <typename TI, typename TP>
+class MatchingViewerFusion :public MatchingViewer<TI,TP>{
+    //------------------------------------------
+    //
+    //! \name
+    //@{
+public:
+    enum {PANEL_FUSION = -1}; //!< The panel of the fused matching, in \c panels.
+
+    //! Default constructor
+    MatchingViewerFusion(void):
+        _numColumns(0)
+    {
+        palette(_colorsProposal, 8);
+    }
+    //! Destructor
+    ~MatchingViewerFusion(void){}
+    //@}
+
+    // proposals
+private:
+    cimg_library::CImg<int> _source; //!< The point of image 0 of each correspondence.
+    cimg_library::CImg<int> _proposals; //!< \c _proposals(m,k): the point of image 1 the proposal k matches to \c _source(m), -1 for none.
+    cimg_library::CImg<double> _energyProposals; //!< \c _energyProposals(m,k): the energy of the correspondence m in the proposal k.
+public:
+    //! returns the number of correspondences.
+    int numberOfCorrespondences(void) const {return _proposals.width();}
+    //! returns the number of proposals.
+    int numberOfProposals(void) const {return _proposals.height();}
+    ///
+    /// \brief proposals
+    /// sets the \c proposals.height() proposals of the correspondences from the points \c source of image 0:
+    /// \c proposals(m,k) is the point of image 1 the proposal k matches to \c source(m), -1 for none,
+    /// and \c energy(m,k) its energy.
+    void proposals(
+        const cimg_library::CImg<int>& source,
+        const cimg_library::CImg<int>& proposals,
+        const cimg_library::CImg<double>& energy
+    )
+    {
+        assert(
+            source.width() == proposals.width() &&
+            energy.width() == proposals.width() &&
+            energy.height() == proposals.height() &&
+            proposals.height() <= 255 &&
+            "Each correspondence must have a point of image 0 and an energy in each of at most 255 proposals."
+        );
+        _source = source;
+        _proposals = proposals;
+        _energyProposals = energy;
+    }
+    //! returns the points of image 0 of the correspondences.
+    cimg_library::CImg<int>& source(void){return _source;}
+    //! returns the proposals, to update some of them in place.
+    cimg_library::CImg<int>& proposals(void){return _proposals;}
+    const cimg_library::CImg<int>& proposals(void) const {return _proposals;}
+    //! returns the energy of the correspondences in the proposals.
+    cimg_library::CImg<double>& energyProposals(void){return _energyProposals;}
+
+    // fused matching
+private:
+    std::vector<unsigned char> _labels; //!< The proposal each correspondence is taken from, beyond the proposals for none.
+    std::vector<unsigned char> _labelsPrevious; //!< The labels of the previous \c displayUpdate, to count the flips.
+    std::vector<double> _energyFusion; //!< Energy of each fused correspondence.
+public:
+    //! sets the fused matching: the proposal \c labels[m] each correspondence is taken from, and its \c energy.
+    void fusion(
+        const std::vector<unsigned char>& labels,
+        const std::vector<double>& energy
+    )
+    {
+        assert(
+            energy.size() >= labels.size() &&
+            "Each fused correspondence must be assigned its energy."
+        );
+        _labels = labels;
+        _energyFusion = energy;
+    }
+    //! returns the proposal each correspondence is taken from.
+    const std::vector<unsigned char>& labels(void) const {return _labels;}
+    std::vector<unsigned char>& labels(void){return _labels;}
+    //! returns the energy of the fused correspondences.
+    const std::vector<double>& energyFusion(void) const {return _energyFusion;}
+    std::vector<double>& energyFusion(void){return _energyFusion;}
+
+    // palette
+private:
+    std::vector<unsigned char> _palette; //!< The color of each proposal, 3 bytes each, repeated beyond the last one.
+    std::vector<const unsigned char*> _colorLines; //!< The color of each label, into \c _palette.
+public:
+    //! sets the \c numColors colors of the proposals; they are repeated beyond \c numColors proposals.
+    void palette(
+        const unsigned char (*colors)[3],
+        const int numColors
+    )
+    {
+        _palette.assign(colors[0], colors[0] + 3*std::max(numColors, 1));
+        colorsUpdate();
+    }
+    //! returns the color of the proposal \c k.
+    const unsigned char* proposalColor(const int k) const {return &_palette[3*(k % (_palette.size()/3))];}
+private:
+    //! points the color of each proposal into the palette.
+    void colorsUpdate(void)
+    {
+        _colorLines.resize(std::max(numberOfProposals(), 1));
+        for(size_t k = 0; k < _colorLines.size(); ++k) _colorLines[k] = proposalColor((int)k);
+    }
+
+    // panels
+private:
+    std::vector<int> _panels; //!< The panels shown: proposals by index and \c PANEL_FUSION; if empty, all the proposals and the fusion.
+    int _numColumns; //!< The number of columns of the grid of panels, 0 for the square root of the number of panels.
+    std::vector<std::vector<MatchingSegment> > _segmentsProposals; //!< The resolved segments of the proposals shown.
+    std::vector<MatchingSegment> _segmentsFusion; //!< The resolved segments of the fused matching.
+public:
+    //! sets the panels shown: the proposals by index and \c PANEL_FUSION for the fused matching; all if empty.
+    //! The proposals that do not exist are skipped.
+    void panels(const std::vector<int>& panels){_panels = panels;}
+    //! returns the panels shown.
+    std::vector<int> panels(void) const;
+    //! sets the number of columns of the grid of panels, 0 for the square root of the number of panels.
+    void gridColumns(const int numColumns){_numColumns = numColumns;}
+    //! returns the number of columns of the grid of panels.
+    int gridColumns(void) const;
+    //! resolves the proposals shown and the fused matching into segments, concurrently.
+    void segmentsUpdate(void);
+    //! returns the segments of the panel \c panel.
+    const std::vector<MatchingSegment>& panelSegments(const int panel) const {return panel == PANEL_FUSION ? _segmentsFusion : _segmentsProposals[panel];}
+    //! returns the title of the panel \c panel.
+    static std::string panelTitle(const int panel);
+    //! returns the points and the energy of the correspondence \c numDraw in the panel \c panel, -1 and 0 if out of range.
+    void panelCaption(
+        const int panel,
+        const int numDraw,
+        int& c0,
+        int& c1,
+        double& energy
+    ) const;
+    //! draws the panel \c panel, up to the correspondence \c numDraw, on \c canvas. The viewer is only read.
+    void renderPanel(
+        const int panel,
+        const int numDraw,
+        cimg_library::CImg<TI>& canvas
+    ) const;
+    //! returns the panels drawn up to the correspondence \c numDraw, rendered concurrently and laid out in the grid.
+    cimg_library::CImg<TI> renderPanels(const int numDraw) const;
+
+    // displays
+    void displayUpdate(void);
+    //! shows the panels drawn up to the correspondence \c numDraw.
+    void showPanels(const int numDraw);
+};
+
+template <typename TI, typename TP>
+std::vector<int> MatchingViewerFusion<TI,TP>::panels(void) const
+{
+    std::vector<int> panels;
+    for(size_t p = 0; p < _panels.size(); ++p)
+    { // the proposals given that exist
+        if(_panels[p] == PANEL_FUSION || (_panels[p] >= 0 && _panels[p] < numberOfProposals())) panels.push_back(_panels[p]);
+    }
+    if(!_panels.empty()) return panels;
+    panels.resize(numberOfProposals()+1);
+    for(int k = 0; k < numberOfProposals(); ++k) panels[k] = k;
+    panels.back() = PANEL_FUSION;
+    return panels;
+}
+
+template <typename TI, typename TP>
+int MatchingViewerFusion<TI,TP>::gridColumns(void) const
+{
+    if(_numColumns > 0) return _numColumns;
+    return std::max(1, (int)std::ceil(std::sqrt((double)panels().size())));
+}
+
+template <typename TI, typename TP>
+void MatchingViewerFusion<TI,TP>::segmentsUpdate(void)
+{
+    const int offset = MatchingViewer<TI,TP>::image(0).width();
+    const cimg_library::CImg<TP>& point0 = MatchingViewer<TI,TP>::point(0);
+    const cimg_library::CImg<TP>& point1 = MatchingViewer<TI,TP>::point(1);
+    const int numCorrespondences = numberOfCorrespondences();
+    const int numProposals = numberOfProposals();
+
+    colorsUpdate();
+
+    // only the proposals shown are resolved, each straight from its row
+    _segmentsProposals.resize(numProposals);
+    std::vector<int> resolved;
+    const std::vector<int> shown = panels();
+    for(size_t p = 0; p < shown.size(); ++p)
+    {
+        if(shown[p] != PANEL_FUSION && shown[p] < numProposals) resolved.push_back(shown[p]);
+    }
+    for(int k = 0; k < numProposals; ++k)
+    {
+        if(std::find(resolved.begin(), resolved.end(), k) == resolved.end()) _segmentsProposals[k].clear();
+    }
+    const bool flagFusion = numCorrespondences > 0 &&
+                            (int)_labels.size() >= numCorrespondences && (int)_energyFusion.size() >= numCorrespondences;
+    parallelFor((int)resolved.size()+1, [&](const int r){
+        if(r < (int)resolved.size())
+        {
+            const int k = resolved[r];
+            resolveSegments(_segmentsProposals[k], point0, point1, _source.data(), _proposals.data(0,k),
+                            numCorrespondences, _energyProposals.data(0,k), offset, k);
+        }
+        else if(flagFusion)
+        {
+            resolveSegments(_segmentsFusion, point0, point1, _source.data(), _proposals,
+                            &_labels[0], &_energyFusion[0], offset);
+        }
+        else _segmentsFusion.clear();
+    });
+}
+
+template <typename TI, typename TP>
+std::string MatchingViewerFusion<TI,TP>::panelTitle(const int panel)
+{
+    if(panel == PANEL_FUSION) return "Fused matching";
+    std::stringstream ss;
+    ss << "Proposal " << panel;
+    return ss.str();
+}
+
+template <typename TI, typename TP>
+void MatchingViewerFusion<TI,TP>::panelCaption(
+    const int panel,
+    const int numDraw,
+    int& c0,
+    int& c1,
+    double& energy
+) const
+{
+    c0 = c1 = -1;
+    energy = 0;
+    if(numDraw < 0 || numDraw >= numberOfCorrespondences()) return;
+    int k = panel;
+    if(panel == PANEL_FUSION)
+    {
+        if(numDraw >= (int)_labels.size()) return;
+        k = _labels[numDraw];
+        energy = _energyFusion[numDraw];
+    }
+    c0 = _source(numDraw);
+    if(k >= numberOfProposals()) return;
+    c1 = _proposals(numDraw,k);
+    if(panel != PANEL_FUSION) energy = _energyProposals(numDraw,k);
+}
+
+template <typename TI, typename TP>
+void MatchingViewerFusion<TI,TP>::renderPanel(
+    const int panel,
+    const int numDraw,
+    cimg_library::CImg<TI>& canvas
+) const
+{
+    canvas = MatchingViewer<TI,TP>::imgAlign();
+    const std::vector<MatchingSegment>& segments = panelSegments(panel);
+    const size_t n = numberOfSegments(segments, numDraw);
+    if(n > 0)
+    {
+        drawSegments(canvas, &segments[0], &segments[0]+n, _colorPt, &_colorLines[0]);
+        drawMatchingLabels(canvas, &segments[0], n, true, MatchingViewer<TI,TP>::labelStyle());
+    }
+    int c0, c1;
+    double e;
+    panelCaption(panel, numDraw, c0, c1, e);
+    MatchingViewer<TI,TP>::drawCaption(canvas, numDraw, c0, c1, e, panelTitle(panel));
+}
+
+template <typename TI, typename TP>
+cimg_library::CImg<TI> MatchingViewerFusion<TI,TP>::renderPanels(const int numDraw) const
+{
+    const std::vector<int> shown = panels();
+    std::vector<cimg_library::CImg<TI> > canvases(shown.size());
+    parallelFor((int)shown.size(), [&](const int p){
+        renderPanel(shown[p], numDraw, canvases[p]);
+    });
+    std::vector<const cimg_library::CImg<TI>*> grid(canvases.size());
+    for(size_t p = 0; p < canvases.size(); ++p) grid[p] = &canvases[p];
+    return gridImages(grid.empty() ? 0 : &grid[0], (int)grid.size(), gridColumns());
+}
+
+template <typename TI, typename TP>
+void MatchingViewerFusion<TI,TP>::showPanels(const int numDraw)
+{
+    const cimg_library::CImg<TI> frame = renderPanels(numDraw);
+    std::vector<FrameRect> rects(1, FrameRect(0, 0, frame.width()-1, frame.height()-1));
+    MatchingViewer<TI,TP>::displayFrame(frame, rects);
+}
+
+template <typename TI, typename TP>
+void MatchingViewerFusion<TI,TP>::displayUpdate(void)
+{
+    if(MatchingViewer<TI,TP>::imagesPreview() && !MatchingViewer<TI,TP>::headless())
+    { // show the panels on the previews until the images are decoded
+        segmentsUpdate();
+        MatchingViewer<TI,TP>::displayPreview(renderPanels(numberOfCorrespondences()));
+    }
+    MatchingViewer<TI,TP>::imagesWait();
+    segmentsUpdate();
+    cimg_library::CImgDisplay& disp = MatchingViewer<TI,TP>::dispEnergy();
+    const int numFusion = std::min(numberOfCorrespondences(), (int)_labels.size());
+    if(MatchingViewer<TI,TP>::flagPlot())
+    { // the flips are the correspondences taken from another proposal than in the previous update
+        int numFlips = -1;
+        if(_labelsPrevious.size() == _labels.size())
+        {
+            numFlips = 0;
+            for(size_t m = 0; m < _labels.size(); ++m) numFlips += _labels[m] != _labelsPrevious[m];
+        }
+        const std::vector<double>* energies[] = {&_energyFusion};
+        MatchingViewer<TI,TP>::plotUpdate(energies, 1, numFlips, numFusion);
+    }
+    _labelsPrevious = _labels;
+    if(MatchingViewer<TI,TP>::flagTrans())
+    { // the fused correspondences, resolved to the point of their proposal
+        cimg_library::CImg<int> fused(numFusion, 2);
+        for(int m = 0; m < numFusion; ++m)
+        {
+            fused(m,0) = _source(m);
+            fused(m,1) = _labels[m] < numberOfProposals() ? _proposals(m,_labels[m]) : -1;
+        }
+        MatchingViewer<TI,TP>::transformUpdate(fused);
+    }
+
+    if(!MatchingViewer<TI,TP>::flagDebug() || MatchingViewer<TI,TP>::headless())
+    { // non-debug mode: show all the correspondences
+        const cimg_library::CImg<TI> frame = renderPanels(numberOfCorrespondences());
+        std::vector<FrameRect> rects(1, FrameRect(0, 0, frame.width()-1, frame.height()-1));
+        MatchingViewer<TI,TP>::displayFrame(frame, rects);
+        MatchingViewer<TI,TP>::serveFrame(frame, numFusion, _energyFusion);
+        if(!MatchingViewer<TI,TP>::headless()) disp.wait(300);
+    }
+    else
+    { // debug mode: the input is merged into one target, shown at most once per refresh
+        BrowseScheduler browse(-1, numberOfCorrespondences()-1);
+        browse.target(0);
+        int numPointCur = browse.target();
+        showPanels(numPointCur);
+        browse.rendered();
+        for(;;)
+        {
+            browse.poll(disp, browse.target() == numPointCur);
+            if(browse.quit()) break;
+            if(browse.target() == numPointCur) continue;
+            // the panels are drawn at once, so a burst of input waits for the next refresh
+            cimg_library::cimg::sleep(browse.delay());
+            browse.poll(disp, false);
+            if(browse.quit()) break;
+            numPointCur = browse.target();
+            showPanels(numPointCur);
+            browse.rendered();
+        }
+    }
+}
+
+#ifdef CIMG_MATCHING_VIEWER_EXTERN
+// compiled once in the matchingviewer library, with the other viewers
+extern template class MatchingViewerFusion<unsigned char, int>;
+extern template class MatchingViewerFusion<unsigned char, float>;
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#include <CImg.h>
+
+// the other viewers are instantiated in their own objects
+#define CIMG_MATCHING_VIEWER_EXTERN
+
+#include "cimgMatchingViewer.hpp"
+
+// the move making viewer with float points, compiled once for the programs declaring it extern (CIMG_MATCHING_VIEWER_EXTERN);
+// each class and point type has its own object, so a program links only the viewers it uses
+template class MatchingViewerMoveMaking<unsigned char, float>;
@@ -0,0 +1,275 @@
+#ifndef cimgMatchingWorkload
+#define cimgMatchingWorkload
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <CImg.h>
+
+//! How the synthetic points are spread over an image.
+enum PointDistribution
+{
+    DISTRIBUTION_UNIFORM,   //!< Uniformly over the image.
+    DISTRIBUTION_CLUSTERED  //!< Normally around \c numClusters random centers, with the deviation \c clusterSpread.
+};
+
+///
+/// \brief The WorkloadOptions struct
+/// The shape of a synthetic move-making run: its points, the labels of its correspondences, how many
+/// of them each iteration flips and how many of the flips the fusion accepts.
+struct WorkloadOptions
+{
+    WorkloadOptions(void):
+        numPoints(0),
+        distribution(DISTRIBUTION_UNIFORM),
+        numClusters(8),
+        clusterSpread(0.03),
+        invalidRatio(0.1),
+        flipRate(1.0/3.0),
+        acceptRate(1.0),
+        numIterations(4),
+        seed(0)
+    {}
+
+    int numPoints;                  //!< The number of points of each image and of correspondences, 5 to 20 at random if 0.
+    PointDistribution distribution;
+    int numClusters;                //!< The number of clusters of \c DISTRIBUTION_CLUSTERED.
+    double clusterSpread;           //!< The standard deviation of a cluster, relative to the larger side of the image.
+    double invalidRatio;            //!< The fraction of the labels which are -1, no point of image 1.
+    double flipRate;                //!< The fraction of the correspondences the proposal changes.
+    double acceptRate;              //!< The fraction of the changed correspondences the fusion takes.
+    int numIterations;
+    unsigned int seed;              //!< The seed of the generator, drawn from std::random_device if 0.
+};
+
+///
+/// \brief parseWorkload
+/// parses the options "points [uniform|clustered] [invalid] [flips] [iterations] [seed] [accept]" from \c argv[first] on
+/// into \c options, the options missing keeping their value. Returns false and reports the first invalid one.
+inline bool parseWorkload(
+    const int argc,
+    char* const argv[],
+    const int first,
+    WorkloadOptions& options
+)
+{
+    for(int a = first; a < argc; ++a)
+    {
+        const std::string arg = argv[a];
+        char* end = 0;
+        const double value = std::strtod(arg.c_str(), &end);
+        const bool flagNumber = !arg.empty() && *end == '\0';
+        bool ok = true;
+        switch(a-first)
+        {
+        case 0:
+            ok = flagNumber && value >= 1;
+            options.numPoints = (int)value;
+            break;
+        case 1:
+            ok = arg == "uniform" || arg == "clustered";
+            options.distribution = arg == "clustered" ? DISTRIBUTION_CLUSTERED : DISTRIBUTION_UNIFORM;
+            break;
+        case 2:
+            ok = flagNumber && value >= 0 && value <= 1;
+            options.invalidRatio = value;
+            break;
+        case 3:
+            ok = flagNumber && value >= 0 && value <= 1;
+            options.flipRate = value;
+            break;
+        case 4:
+            ok = flagNumber && value >= 0;
+            options.numIterations = (int)value;
+            break;
+        case 5:
+            ok = flagNumber && value >= 0;
+            options.seed = (unsigned int)value;
+            break;
+        case 6:
+            ok = flagNumber && value >= 0 && value <= 1;
+            options.acceptRate = value;
+            break;
+        default:
+            ok = false;
+        }
+        if(!ok)
+        {
+            std::cerr << "invalid workload option " << arg
+                      << ", expected points [uniform|clustered] [invalid] [flips] [iterations] [seed] [accept]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+/// \brief The MoveMakingWorkload class
+/// A synthetic move-making run shaped by \c WorkloadOptions, reproducible from its seed. The m-th correspondence
+/// links the point m of image 0 to a label, a point of image 1 or -1. Each iteration starts from the fused
+/// correspondences of the previous one; the proposal relabels a fraction \c flipRate of them at random, with
+/// new random energies, and the fusion takes a fraction \c acceptRate of those, so the labels, the invalid fraction
+/// and the energies keep the same distribution however long the run. The proposal is redrawn whole each iteration,
+/// the fused and current panels change only where the fusion accepts.
+template <typename TP>
+class MoveMakingWorkload
+{
+public:
+    //! Constructor: draws the points on the images of sizes \c width0 x \c height0 and \c width1 x \c height1,
+    //! and the correspondences of the first iteration.
+    MoveMakingWorkload(
+        const WorkloadOptions& options,
+        const int width0,
+        const int height0,
+        const int width1,
+        const int height1
+    ):
+        _options(options),
+        _mt(options.seed != 0 ? options.seed : std::random_device()()),
+        _numIterations(0),
+        _numFlips(0),
+        _numAccepted(0)
+    {
+        const int widths[2] = {width0, width1}, heights[2] = {height0, height1};
+        std::uniform_int_distribution<> randNumPoint(5, 20);
+        const int numPoints = options.numPoints > 0 ? options.numPoints : randNumPoint(_mt);
+        for(int n = 0; n < 2; ++n)
+        {
+            pointsDraw(_points[n], numPoints, std::max(widths[n], 1), std::max(heights[n], 1));
+        }
+        _correspondencesCurrent.assign(numPoints, 2);
+        _correspondencesNew.assign(numPoints, 2);
+        _correspondencesFusion.assign(numPoints, 2);
+        _energyCurrent.resize(numPoints);
+        _energyNew.resize(numPoints);
+        _energyFusion.resize(numPoints);
+        std::uniform_real_distribution<> randE(0.0, 1.0);
+        for(int m = 0; m < numPoints; ++m)
+        {
+            _correspondencesCurrent(m,0) = _correspondencesNew(m,0) = _correspondencesFusion(m,0) = m;
+            _correspondencesCurrent(m,1) = label(-1);
+            _energyCurrent[m] = randE(_mt);
+        }
+    }
+
+    ///
+    /// \brief next
+    /// draws the proposal and the fusion of the next iteration, after fusing the previous one into the current
+    /// correspondences.
+    void next(void)
+    {
+        const int numCorrespondences = _correspondencesCurrent.width();
+        if(_numIterations > 0)
+        {
+            for(int m = 0; m < numCorrespondences; ++m)
+            {
+                if(_correspondencesFusion(m,1) != 1) continue;
+                _correspondencesCurrent(m,1) = _correspondencesNew(m,1);
+                _energyCurrent[m] = _energyFusion[m];
+            }
+        }
+        std::bernoulli_distribution randFlip(_options.flipRate), randAccept(_options.acceptRate);
+        std::uniform_real_distribution<> randE(0.0, 1.0);
+        _numFlips = 0;
+        _numAccepted = 0;
+        for(int m = 0; m < numCorrespondences; ++m)
+        {
+            const bool flagFlip = randFlip(_mt);
+            // drawn only below 1, so a seed accepting all the flips reproduces the same run as before
+            const bool flagAccept = flagFlip && (_options.acceptRate >= 1.0 || randAccept(_mt));
+            _correspondencesNew(m,1) = flagFlip ? label(_correspondencesCurrent(m,1)) : _correspondencesCurrent(m,1);
+            _energyNew[m] = flagFlip ? randE(_mt) : _energyCurrent[m];
+            _correspondencesFusion(m,1) = flagAccept ? 1 : 0;
+            _energyFusion[m] = flagAccept ? _energyNew[m] : _energyCurrent[m];
+            _numFlips += flagFlip;
+            _numAccepted += flagAccept;
+        }
+        ++_numIterations;
+    }
+
+    //! returns the options of the run.
+    const WorkloadOptions& options(void) const {return _options;}
+    //! returns the number of iterations drawn.
+    int numberOfIterations(void) const {return _numIterations;}
+    //! returns the number of correspondences flipped by the last iteration.
+    int numberOfFlips(void) const {return _numFlips;}
+    //! returns the number of flips of the last iteration the fusion took.
+    int numberOfAccepted(void) const {return _numAccepted;}
+    //! returns the number of correspondences.
+    int numberOfCorrespondences(void) const {return _correspondencesCurrent.width();}
+    //! returns the points of the image \c n.
+    const cimg_library::CImg<TP>& point(const int n) const {return _points[n];}
+    const cimg_library::CImg<int>& correspondencesCurrent(void) const {return _correspondencesCurrent;}
+    const cimg_library::CImg<int>& correspondencesNew(void) const {return _correspondencesNew;}
+    //! returns the fusion: 1 for the correspondences taken from the proposal, 0 for the current ones.
+    const cimg_library::CImg<int>& correspondencesFusion(void) const {return _correspondencesFusion;}
+    const std::vector<double>& energyCurrent(void) const {return _energyCurrent;}
+    const std::vector<double>& energyNew(void) const {return _energyNew;}
+    const std::vector<double>& energyFusion(void) const {return _energyFusion;}
+
+private:
+    //! draws \c numPoints points on an image of size \c width x \c height into \c points.
+    void pointsDraw(
+        cimg_library::CImg<TP>& points,
+        const int numPoints,
+        const int width,
+        const int height
+    )
+    {
+        points.assign(numPoints, 2);
+        std::uniform_real_distribution<> randX(0.0, width-1), randY(0.0, height-1);
+        if(_options.distribution == DISTRIBUTION_UNIFORM)
+        {
+            for(int m = 0; m < numPoints; ++m)
+            {
+                points(m,0) = (TP)randX(_mt);
+                points(m,1) = (TP)randY(_mt);
+            }
+            return;
+        }
+        const int numClusters = std::max(_options.numClusters, 1);
+        std::vector<double> centerX(numClusters), centerY(numClusters);
+        for(int c = 0; c < numClusters; ++c)
+        {
+            centerX[c] = randX(_mt);
+            centerY[c] = randY(_mt);
+        }
+        std::uniform_int_distribution<> randCluster(0, numClusters-1);
+        std::normal_distribution<> randSpread(0.0, _options.clusterSpread*std::max(width, height));
+        for(int m = 0; m < numPoints; ++m)
+        {
+            const int c = randCluster(_mt);
+            points(m,0) = (TP)std::max(0.0, std::min(centerX[c] + randSpread(_mt), width-1.0));
+            points(m,1) = (TP)std::max(0.0, std::min(centerY[c] + randSpread(_mt), height-1.0));
+        }
+    }
+
+    //! returns a random label: -1 with the probability \c invalidRatio, a point of image 1 other than \c previous
+    //! where possible otherwise, so the fraction of -1 stays \c invalidRatio.
+    int label(const int previous)
+    {
+        const int numPoints1 = _points[1].width();
+        if(numPoints1 == 0 || std::bernoulli_distribution(_options.invalidRatio)(_mt)) return -1;
+        if(previous < 0 || numPoints1 == 1) return std::uniform_int_distribution<>(0, numPoints1-1)(_mt);
+        const int l = std::uniform_int_distribution<>(0, numPoints1-2)(_mt);
+        return l >= previous ? l+1 : l;
+    }
+
+    WorkloadOptions _options;
+    std::mt19937 _mt;
+    int _numIterations;
+    int _numFlips;
+    int _numAccepted;
+    cimg_library::CImg<TP> _points[2];
+    cimg_library::CImg<int> _correspondencesCurrent;
+    cimg_library::CImg<int> _correspondencesNew;
+    cimg_library::CImg<int> _correspondencesFusion;
+    std::vector<double> _energyCurrent;
+    std::vector<double> _energyNew;
+    std::vector<double> _energyFusion;
+};
+
+#endif
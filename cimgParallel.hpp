@@ -0,0 +1,43 @@
+#ifndef cimgParallel
+#define cimgParallel
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+//! returns the number of worker threads to use, at least 1.
+inline int numberOfThreads(void)
+{
+    const unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? (int)n : 1;
+}
+
+///
+/// \brief parallelFor
+/// calls \c fn(t) for t in [0, \c numTasks) on up to \c numberOfThreads() threads.
+/// Tasks are handed out in contiguous blocks; the calling thread runs the first block.
+template <typename Fn>
+void parallelFor(
+    const int numTasks,
+    Fn fn
+)
+{
+    const int numThreads = std::min(numTasks, numberOfThreads());
+    if(numThreads <= 1)
+    {
+        for(int t = 0; t < numTasks; ++t) fn(t);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(numThreads-1);
+    for(int k = 1; k < numThreads; ++k)
+    {
+        threads.push_back(std::thread([&fn, k, numTasks, numThreads](){
+            for(int t = (int)((long long)numTasks*k/numThreads); t < (int)((long long)numTasks*(k+1)/numThreads); ++t) fn(t);
+        }));
+    }
+    for(int t = 0; t < numTasks/numThreads; ++t) fn(t);
+    for(auto it = threads.begin(); it != threads.end(); ++it) it->join();
+}
+
+#endif
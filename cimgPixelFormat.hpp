@@ -0,0 +1,221 @@
+#ifndef cimgPixelFormat
+#define cimgPixelFormat
+
+#include <algorithm>
+#include <cstddef>
+#include <CImg.h>
+
+///
+/// \brief Pixel format policies
+/// Each policy fixes the channel count and the memory layout of a canvas at compile time,
+/// so that the kernels in cimgPixelKernels.hpp are unrolled for the format.
+/// Planar formats store one full plane per channel, as \c cimg_library::CImg does.
+/// Interleaved formats store the channels of a pixel next to each other, as a \c cimg_library::CImg permuted
+/// by \c get_permute_axes("cxyz") does; such an image is drawn through an \c InterleavedImage.
+
+//! 8-bit RGB stored channel by channel (the layout of \c CImg<unsigned char> with spectrum 3).
+struct PixelFormatRGB8Planar
+{
+    typedef unsigned char value_type;
+    static constexpr int channels = 3;
+    static constexpr bool planar = true;
+    static constexpr bool alpha = false;
+};
+
+//! 8-bit RGB stored pixel by pixel.
+struct PixelFormatRGB8Interleaved
+{
+    typedef unsigned char value_type;
+    static constexpr int channels = 3;
+    static constexpr bool planar = false;
+    static constexpr bool alpha = false;
+};
+
+//! 8-bit grayscale.
+struct PixelFormatGray8
+{
+    typedef unsigned char value_type;
+    static constexpr int channels = 1;
+    static constexpr bool planar = true;
+    static constexpr bool alpha = false;
+};
+
+//! 8-bit RGBA stored pixel by pixel. Drawn pixels are made opaque.
+struct PixelFormatRGBA8
+{
+    typedef unsigned char value_type;
+    static constexpr int channels = 4;
+    static constexpr bool planar = false;
+    static constexpr bool alpha = true;
+};
+
+//! Any other image type, drawn through the generic \c cimg_library::CImg functions.
+template <typename T>
+struct PixelFormatGeneric
+{
+    typedef T value_type;
+};
+
+///
+/// \brief PixelFormatOf
+/// selects the pixel format used to draw on a \c cimg_library::CImg<T>.
+/// The viewer always draws on 3-channel images, so \c unsigned \c char maps to \c PixelFormatRGB8Planar.
+template <typename T>
+struct PixelFormatOf
+{
+    typedef PixelFormatGeneric<T> type;
+};
+template <>
+struct PixelFormatOf<unsigned char>
+{
+    typedef PixelFormatRGB8Planar type;
+};
+
+///
+/// \brief The PixelCanvas struct
+/// A non-owning view of a pixel buffer in the format \c F.
+template <typename F>
+struct PixelCanvas
+{
+    typedef typename F::value_type value_type;
+
+    value_type* data;   //!< The first channel of the top-left pixel.
+    int width;          //!< Width in pixels.
+    int height;         //!< Height in pixels.
+    int clipX0;         //!< The first column drawn by the kernels.
+    int clipY0;         //!< The first row drawn by the kernels.
+    int clipX1;         //!< The last column drawn by the kernels.
+    int clipY1;         //!< The last row drawn by the kernels.
+
+    PixelCanvas(value_type* _data, const int _width, const int _height):
+        data(_data),
+        width(_width),
+        height(_height),
+        clipX0(0),
+        clipY0(0),
+        clipX1(_width-1),
+        clipY1(_height-1)
+    {}
+
+    //! restricts the drawing to the pixels [x0,x1]x[y0,y1] of the canvas; the pixels drawn there do not change.
+    PixelCanvas& clip(const int x0, const int y0, const int x1, const int y1)
+    {
+        clipX0 = std::max(x0, 0);
+        clipY0 = std::max(y0, 0);
+        clipX1 = std::min(x1, width-1);
+        clipY1 = std::min(y1, height-1);
+        return *this;
+    }
+
+    //! returns the distance between two horizontally neighboring pixels.
+    static constexpr int pixelStride(void){return F::planar ? 1 : F::channels;}
+    //! returns the distance between two channels of a pixel.
+    size_t channelStride(void) const {return F::planar ? (size_t)width*height : 1;}
+    //! returns the distance between two vertically neighboring pixels.
+    size_t rowStride(void) const {return F::planar ? (size_t)width : (size_t)width*F::channels;}
+    //! returns the first channel of the pixel (x,y).
+    value_type* pixel(const int x, const int y) const {return data + y*rowStride() + (size_t)x*pixelStride();}
+};
+
+///
+/// \brief The FrameRect struct
+/// The pixels [x0,x1]x[y0,y1] of a frame, e.g. a region changed since the frame was last shown.
+struct FrameRect
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+
+    FrameRect(const int _x0 = 0, const int _y0 = 0, const int _x1 = -1, const int _y1 = -1):
+        x0(_x0),
+        y0(_y0),
+        x1(_x1),
+        y1(_y1)
+    {}
+
+    int width(void) const {return x1-x0+1;}
+    int height(void) const {return y1-y0+1;}
+    bool empty(void) const {return x1 < x0 || y1 < y0;}
+    //! returns the rectangle clipped to a frame of \c width x \c height pixels.
+    FrameRect clipped(const int width, const int height) const
+    {
+        return FrameRect(std::max(x0, 0), std::max(y0, 0), std::min(x1, width-1), std::min(y1, height-1));
+    }
+};
+
+//! returns true if \c img, a \c cimg_library::CImg stored plane by plane, is in the planar pixel format \c F.
+template <typename F>
+bool hasPixelFormat(const cimg_library::CImg<typename F::value_type>& img)
+{
+    return F::planar && img.spectrum() == F::channels;
+}
+
+//! returns a canvas sharing the buffer of \c img, stored in the planar pixel format \c F.
+template <typename F>
+PixelCanvas<F> pixelCanvas(cimg_library::CImg<typename F::value_type>& img)
+{
+    assert(
+        hasPixelFormat<F>(img) &&
+        "The image must be stored in the layout of the pixel format."
+    );
+    return PixelCanvas<F>(img.data(), img.width(), img.height());
+}
+
+///
+/// \brief The InterleavedImage struct
+/// A \c cimg_library::CImg holding an image of the interleaved pixel format \c F, in the layout of
+/// \c get_permute_axes("cxyz"): \c F::channels wide, as high as the image is wide and as deep as it is high.
+/// The dimensions alone do not tell this layout from a narrow planar image, so it is carried by the type.
+template <typename F>
+struct InterleavedImage
+{
+    cimg_library::CImg<typename F::value_type>& img; //!< The image, channels first.
+
+    explicit InterleavedImage(cimg_library::CImg<typename F::value_type>& _img):
+        img(_img)
+    {
+        static_assert(!F::planar, "An interleaved image has an interleaved pixel format.");
+        assert(
+            img.width() == F::channels &&
+            img.spectrum() == 1 &&
+            "The image must be stored channels first, as get_permute_axes(\"cxyz\") does."
+        );
+    }
+
+    //! returns the width of the image in pixels.
+    int width(void) const {return img.height();}
+    //! returns the height of the image in pixels.
+    int height(void) const {return img.depth();}
+};
+
+//! returns a canvas sharing the buffer of the interleaved image \c img.
+template <typename F>
+PixelCanvas<F> pixelCanvas(const InterleavedImage<F>& img)
+{
+    return PixelCanvas<F>(img.img.data(), img.width(), img.height());
+}
+
+///
+/// \brief The PixelColor struct
+/// A color converted from 8-bit RGB into the channels of the format \c F.
+template <typename F>
+struct PixelColor
+{
+    typename F::value_type v[F::channels];
+
+    explicit PixelColor(const unsigned char rgb[])
+    {
+        if(F::channels == 1)
+        { // luma of the ITU-R BT.601 conversion used by RGBtoYCbCr
+            v[0] = (typename F::value_type)(((66*rgb[0] + 129*rgb[1] + 25*rgb[2] + 128) >> 8) + 16);
+        }
+        else
+        {
+            for(int c = 0; c < F::channels && c < 3; ++c) v[c] = rgb[c];
+            for(int c = 3; c < F::channels; ++c) v[c] = 255;
+        }
+    }
+};
+
+#endif
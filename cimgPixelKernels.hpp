@@ -0,0 +1,484 @@
+#ifndef cimgPixelKernels
+#define cimgPixelKernels
+
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include "cimgPixelFormat.hpp"
+#include "cimgCpuDispatch.hpp"
+
+///
+/// \brief Pixel kernels
+/// Line, marker and blend kernels specialized on a pixel format policy.
+/// The channel count and the strides are known at compile time, so the inner loops are unrolled
+/// and the spans of planar formats are filled with \c memset when drawn opaque.
+
+//! converts an opacity in [0,1] into a blending weight in [0,256].
+inline unsigned int blendWeight(const double opacity)
+{
+    return opacity >= 1.0 ? 256u : opacity <= 0.0 ? 0u : (unsigned int)(opacity*256.0 + 0.5);
+}
+
+//! blends \c src over \c dst with the weight \c w in [0,256].
+inline unsigned char blendChannel(const unsigned char dst, const unsigned char src, const unsigned int w)
+{
+    return (unsigned char)((dst*(256u-w) + src*w + 128u) >> 8);
+}
+
+//! The number of fractional bits of the subpixel coordinates, in 24.8 fixed point.
+const int subpixelBits = 8;
+
+//! converts the coordinate \c v into 24.8 fixed point, exactly for the integral types, to the nearest 1/256 otherwise.
+template <typename TP>
+inline int toSubpixel(const TP v)
+{
+    return std::numeric_limits<TP>::is_integer ? (int)v*(1 << subpixelBits) : (int)std::floor(v*(double)(1 << subpixelBits) + 0.5);
+}
+
+//! returns the pixel nearest to the 24.8 fixed-point coordinate \c f, i.e. the largest pixel not greater than f+1/2.
+inline int fromSubpixel(const long long f){return (int)((f + (1 << (subpixelBits-1))) >> subpixelBits);}
+
+//! returns the smallest pixel not less than the 24.8 fixed-point coordinate \c f.
+inline int ceilSubpixel(const long long f){return (int)((f + (1 << subpixelBits) - 1) >> subpixelBits);}
+
+//! returns the largest pixel not greater than the 24.8 fixed-point coordinate \c f.
+inline int floorSubpixel(const long long f){return (int)(f >> subpixelBits);}
+
+//! returns the square root of \c n in [0,2^62] rounded down.
+inline long long sqrtFloor(const long long n)
+{
+    long long h = (long long)std::sqrt((double)n);
+    while(h*h > n) --h;
+    while((h+1)*(h+1) <= n) ++h;
+    return h;
+}
+
+//! returns \c a / \c b rounded down, for \c b > 0.
+inline long long floorDiv(const long long a, const long long b){return a >= 0 ? a/b : -((-a + b-1)/b);}
+
+//! returns \c a / \c b rounded up, for \c b > 0.
+inline long long ceilDiv(const long long a, const long long b){return a >= 0 ? (a + b-1)/b : -(-a/b);}
+
+//! blends \c color over the pixel \c p with the weight \c w.
+template <typename F>
+inline void blendPixel(
+    const PixelCanvas<F>& canvas,
+    typename F::value_type* p,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    const size_t cs = canvas.channelStride();
+    for(int c = 0; c < F::channels; ++c)
+    {
+        p[c*cs] = (w >= 256 || (F::alpha && c == 3)) ? color.v[c] : blendChannel(p[c*cs], color.v[c], w);
+    }
+}
+
+//! fills the pixels [xl,xr] of the row \c y.
+template <typename F>
+void fillSpan(
+    const PixelCanvas<F>& canvas,
+    const int y,
+    int xl,
+    int xr,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    if(y < canvas.clipY0 || y > canvas.clipY1 || w == 0) return;
+    xl = std::max(xl, canvas.clipX0);
+    xr = std::min(xr, canvas.clipX1);
+    if(xl > xr) return;
+    const int n = xr-xl+1;
+    typename F::value_type* p = canvas.pixel(xl, y);
+    if(F::planar)
+    {
+        const size_t cs = canvas.channelStride();
+        for(int c = 0; c < F::channels; ++c, p += cs)
+        {
+            if(w >= 256)
+            {
+                std::memset(p, color.v[c], n);
+            }
+            else
+            {
+                pixelKernels().fill(p, color.v[c], n, w);
+            }
+        }
+    }
+    else
+    {
+        for(int i = 0; i < n; ++i, p += F::channels)
+        {
+            for(int c = 0; c < F::channels; ++c)
+            {
+                p[c] = (w >= 256 || (F::alpha && c == 3)) ? color.v[c] : blendChannel(p[c], color.v[c], w);
+            }
+        }
+    }
+}
+
+//! draws a one pixel wide line from (x0,y0) to (x1,y1).
+template <typename F>
+void drawLine(
+    const PixelCanvas<F>& canvas,
+    int x0,
+    int y0,
+    const int x1,
+    const int y1,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    const int dx = std::abs(x1-x0), dy = -std::abs(y1-y0);
+    const int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int e = dx+dy;
+    for(;;)
+    {
+        if(x0 >= canvas.clipX0 && y0 >= canvas.clipY0 && x0 <= canvas.clipX1 && y0 <= canvas.clipY1)
+        {
+            blendPixel(canvas, canvas.pixel(x0, y0), color, w);
+        }
+        if(x0 == x1 && y0 == y1) break;
+        // the line never comes back once it has left the clip rectangle in its direction
+        if((sx > 0 ? x0 > canvas.clipX1 : x0 < canvas.clipX0) || (sy > 0 ? y0 > canvas.clipY1 : y0 < canvas.clipY0)) break;
+        const int e2 = 2*e;
+        if(e2 >= dy) { e += dy; x0 += sx; }
+        if(e2 <= dx) { e += dx; y0 += sy; }
+    }
+}
+
+///
+/// \brief drawLineSubpixel
+/// draws a one pixel wide line from (fx0,fy0) to (fx1,fy1) in 24.8 fixed point: a pixel per column, or per row for
+/// the steep lines, from the pixel nearest to one end to the pixel nearest to the other, at the row (column)
+/// nearest to the exact line at the center of the pixel. The rows are stepped in 16.16 fixed point, and the
+/// lines between whole pixels are drawn by \c drawLine.
+template <typename F>
+void drawLineSubpixel(
+    const PixelCanvas<F>& canvas,
+    const int fx0,
+    const int fy0,
+    const int fx1,
+    const int fy1,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    if(((fx0 | fy0 | fx1 | fy1) & ((1 << subpixelBits) - 1)) == 0)
+    {
+        drawLine(canvas, floorSubpixel(fx0), floorSubpixel(fy0), floorSubpixel(fx1), floorSubpixel(fy1), color, w);
+        return;
+    }
+    // the major axis u, along which the line is stepped, and the minor axis v
+    const bool flagSteep = std::abs(fy1-fy0) > std::abs(fx1-fx0);
+    const int u0 = flagSteep ? fy0 : fx0, v0 = flagSteep ? fx0 : fy0;
+    const int u1 = flagSteep ? fy1 : fx1, v1 = flagSteep ? fx1 : fy1;
+    const int clipU0 = flagSteep ? canvas.clipY0 : canvas.clipX0, clipU1 = flagSteep ? canvas.clipY1 : canvas.clipX1;
+    const int clipV0 = flagSteep ? canvas.clipX0 : canvas.clipY0, clipV1 = flagSteep ? canvas.clipX1 : canvas.clipY1;
+    const int ua = fromSubpixel(u0), ub = fromSubpixel(u1), su = ua <= ub ? 1 : -1;
+    // the first pixel within the clip rectangle, and the last one
+    const int first = su > 0 ? std::max(ua, clipU0) : std::min(ua, clipU1);
+    const int last = su > 0 ? std::min(ub, clipU1) : std::max(ub, clipU0);
+    if((last-first)*su < 0) return;
+    const long long du = u1-u0, dv = v1-v0;
+    // v at the center of the pixel ua and its step per pixel, in 16.16, then stepped to the pixel first,
+    // so a clipped line has the same pixels as the whole line
+    long long v = (long long)v0*(1 << 8);
+    long long step = 0;
+    if(du != 0)
+    {
+        v += (((long long)ua*(1 << subpixelBits) - u0)*dv*(1 << 8))/du;
+        step = su*dv*(1 << 16)/du;
+        v += (long long)(first-ua)*su*step;
+    }
+    // the line stays between its ends, whose pixels bound it
+    const long long vlo = (long long)std::min(v0, v1)*(1 << 8), vhi = (long long)std::max(v0, v1)*(1 << 8);
+    for(int u = first; ; u += su, v += step)
+    {
+        const int p = (int)((std::max(vlo, std::min(v, vhi)) + (1 << 15)) >> 16);
+        if(p >= clipV0 && p <= clipV1)
+        {
+            blendPixel(canvas, flagSteep ? canvas.pixel(p, u) : canvas.pixel(u, p), color, w);
+        }
+        if(u == last) break;
+    }
+}
+
+//! draws a filled disc of radius \c r centered at (cx,cy).
+template <typename F>
+void drawDisc(
+    const PixelCanvas<F>& canvas,
+    const int cx,
+    const int cy,
+    const int r,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    const int ylo = std::max(cy-r, canvas.clipY0), yhi = std::min(cy+r, canvas.clipY1);
+    for(int y = ylo; y <= yhi; ++y)
+    {
+        const int dy = y-cy;
+        const int h = (int)std::sqrt((double)(r*r - dy*dy));
+        fillSpan(canvas, y, cx-h, cx+h, color, w);
+    }
+}
+
+///
+/// \brief drawDiscSubpixel
+/// draws the pixels within the distance \c r from (fcx,fcy) in 24.8 fixed point, one span per row, in integer
+/// arithmetic. The discs centered on whole pixels are drawn by \c drawDisc.
+template <typename F>
+void drawDiscSubpixel(
+    const PixelCanvas<F>& canvas,
+    const int fcx,
+    const int fcy,
+    const int r,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    if(((fcx | fcy) & ((1 << subpixelBits) - 1)) == 0)
+    {
+        drawDisc(canvas, floorSubpixel(fcx), floorSubpixel(fcy), r, color, w);
+        return;
+    }
+    const long long fr = (long long)r << subpixelBits, rr = fr*fr;
+    const int ylo = std::max(ceilSubpixel(fcy - fr), canvas.clipY0), yhi = std::min(floorSubpixel(fcy + fr), canvas.clipY1);
+    for(int y = ylo; y <= yhi; ++y)
+    {
+        const long long dy = (long long)y*(1 << subpixelBits) - fcy, hh = rr - dy*dy;
+        // the half width of the span
+        const long long h = sqrtFloor(hh);
+        fillSpan(canvas, y, ceilSubpixel(fcx - h), floorSubpixel(fcx + h), color, w);
+    }
+}
+
+///
+/// \brief drawCapsuleSubpixel
+/// draws the pixels within the distance \c r from the segment (fx0,fy0)-(fx1,fy1) in 24.8 fixed point, one span
+/// per row: the union of the two end discs and the band around the segment, each solved in integer arithmetic
+/// from the exact ends, as \c drawDiscSubpixel. A capsule of radius 0 is a line, drawn by \c drawLineSubpixel.
+template <typename F>
+void drawCapsuleSubpixel(
+    const PixelCanvas<F>& canvas,
+    const int fx0,
+    const int fy0,
+    const int fx1,
+    const int fy1,
+    const int r,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    if(r <= 0)
+    {
+        drawLineSubpixel(canvas, fx0, fy0, fx1, fy1, color, w);
+        return;
+    }
+    const long long dx = fx1-fx0, dy = fy1-fy0, len2 = dx*dx + dy*dy;
+    const long long fr = (long long)r << subpixelBits, rr = fr*fr;
+    // the half width of the band times the length, r*sqrt(len2) in the units of u*dy-v0*dx below, rounded down
+    // from r times a square root in 16.16: the band is then narrower by less than r/65536 of a pixel for the
+    // segments of a pixel to 32768 pixels, and much less for the longer ones, so no pixel farther than r is drawn
+    const long long rl = len2 < (1LL << 46) ? r*sqrtFloor(len2 << 16) : (r*sqrtFloor(len2)) << 8;
+    const int ylo = std::max(ceilSubpixel(std::min(fy0, fy1) - fr), canvas.clipY0);
+    const int yhi = std::min(floorSubpixel(std::max(fy0, fy1) + fr), canvas.clipY1);
+    for(int y = ylo; y <= yhi; ++y)
+    {
+        int xl = std::numeric_limits<int>::max(), xr = std::numeric_limits<int>::min();
+        // end discs
+        const long long v0 = (long long)y*(1 << subpixelBits) - fy0, v1 = (long long)y*(1 << subpixelBits) - fy1;
+        if(v0*v0 <= rr)
+        {
+            const long long h = sqrtFloor(rr - v0*v0);
+            xl = std::min(xl, ceilSubpixel(fx0 - h));
+            xr = std::max(xr, floorSubpixel(fx0 + h));
+        }
+        if(v1*v1 <= rr)
+        {
+            const long long h = sqrtFloor(rr - v1*v1);
+            xl = std::min(xl, ceilSubpixel(fx1 - h));
+            xr = std::max(xr, floorSubpixel(fx1 + h));
+        }
+        // band: 0 <= u*dx+v0*dy <= len2 and -rl <= u*dy-v0*dx <= rl, with u = x-fx0 in 24.8
+        if(len2 > 0)
+        {
+            long long ul = std::numeric_limits<long long>::min(), ur = std::numeric_limits<long long>::max();
+            const long long a[2] = {dx, dy}, b[2] = {v0*dy, -v0*dx};
+            const long long bl[2] = {0, -rl}, bh[2] = {len2, rl};
+            for(int k = 0; k < 2; ++k)
+            {
+                if(a[k] > 0)
+                {
+                    ul = std::max(ul, ceilDiv(bl[k]-b[k], a[k]));
+                    ur = std::min(ur, floorDiv(bh[k]-b[k], a[k]));
+                }
+                else if(a[k] < 0)
+                {
+                    ul = std::max(ul, ceilDiv(b[k]-bh[k], -a[k]));
+                    ur = std::min(ur, floorDiv(b[k]-bl[k], -a[k]));
+                }
+                else if(b[k] < bl[k] || b[k] > bh[k])
+                {
+                    ur = std::numeric_limits<long long>::min();
+                }
+            }
+            if(ul <= ur)
+            {
+                xl = std::min(xl, ceilSubpixel(fx0 + ul));
+                xr = std::max(xr, floorSubpixel(fx0 + ur));
+            }
+        }
+        if(xl <= xr)
+        {
+            fillSpan(canvas, y, xl, xr, color, w);
+        }
+    }
+}
+
+///
+/// \brief drawCapsule
+/// draws the pixels within the distance \c r from the segment (x0,y0)-(x1,y1), one span per row.
+template <typename F>
+void drawCapsule(
+    const PixelCanvas<F>& canvas,
+    const int x0,
+    const int y0,
+    const int x1,
+    const int y1,
+    const int r,
+    const PixelColor<F>& color,
+    const unsigned int w
+)
+{
+    const int one = 1 << subpixelBits;
+    drawCapsuleSubpixel(canvas, x0*one, y0*one, x1*one, y1*one, r, color, w);
+}
+
+///
+/// \brief blendBuffers
+/// computes \c dst = \c alpha * \c src0 + (1 - \c alpha) * \c src1 over \c size 8-bit values.
+/// The blend is element-wise, so it applies to any 8-bit format.
+/// The kernel is selected at runtime by \c pixelKernels().
+inline void blendBuffers(
+    unsigned char* dst,
+    const unsigned char* src0,
+    const unsigned char* src1,
+    const size_t size,
+    const double alpha
+)
+{
+    pixelKernels().blend(dst, src0, src1, size, blendWeight(alpha));
+}
+
+///
+/// \brief blendImages
+/// returns \c alpha * \c img0 + (1 - \c alpha) * \c img1.
+template <typename T>
+cimg_library::CImg<T> blendImages(
+    const cimg_library::CImg<T>& img0,
+    const cimg_library::CImg<T>& img1,
+    const double alpha
+)
+{
+    return alpha*img0+(1.0-alpha)*img1;
+}
+
+inline cimg_library::CImg<unsigned char> blendImages(
+    const cimg_library::CImg<unsigned char>& img0,
+    const cimg_library::CImg<unsigned char>& img1,
+    const double alpha
+)
+{
+    if(img0.width() != img1.width() || img0.height() != img1.height() ||
+       img0.depth() != img1.depth() || img0.spectrum() != img1.spectrum())
+    {
+        return alpha*img0+(1.0-alpha)*img1;
+    }
+    cimg_library::CImg<unsigned char> img(img0.width(), img0.height(), img0.depth(), img0.spectrum());
+    blendBuffers(img.data(), img0.data(), img1.data(), img.size(), alpha);
+    return img;
+}
+
+///
+/// \brief stackImages
+/// returns the \c n images \c imgs appended along the y axis.
+template <typename T>
+cimg_library::CImg<T> stackImages(
+    const cimg_library::CImg<T>* const imgs[],
+    const int n
+)
+{
+    cimg_library::CImg<T> img;
+    for(int k = 0; k < n; ++k)
+    {
+        img.append(*imgs[k], 'y');
+    }
+    return img;
+}
+
+inline cimg_library::CImg<unsigned char> stackImages(
+    const cimg_library::CImg<unsigned char>* const imgs[],
+    const int n
+)
+{
+    int height = 0;
+    for(int k = 0; k < n; ++k)
+    {
+        if(imgs[k]->width() != imgs[0]->width() || imgs[k]->spectrum() != imgs[0]->spectrum() || imgs[k]->depth() != 1)
+        {
+            return stackImages<unsigned char>(imgs, n);
+        }
+        height += imgs[k]->height();
+    }
+    if(n == 0) return cimg_library::CImg<unsigned char>();
+
+    // in each channel plane, the images occupy consecutive blocks of rows
+    const PixelKernelTable& kernels = pixelKernels();
+    cimg_library::CImg<unsigned char> img(imgs[0]->width(), height, 1, imgs[0]->spectrum());
+    for(int c = 0; c < img.spectrum(); ++c)
+    {
+        int y = 0;
+        for(int k = 0; k < n; ++k)
+        {
+            kernels.copy(img.data(0,y,0,c), imgs[k]->data(0,0,0,c), (size_t)imgs[k]->width()*imgs[k]->height());
+            y += imgs[k]->height();
+        }
+    }
+    return img;
+}
+
+///
+/// \brief gridImages
+/// returns the \c n images \c imgs laid out row by row in a grid of \c numColumns columns, each in a cell of the
+/// size of the largest one; the cells left empty are 0.
+template <typename T>
+cimg_library::CImg<T> gridImages(
+    const cimg_library::CImg<T>* const imgs[],
+    const int n,
+    const int numColumns
+)
+{
+    if(n == 0 || numColumns <= 0) return cimg_library::CImg<T>();
+    int width = 0, height = 0, spectrum = 0;
+    for(int k = 0; k < n; ++k)
+    {
+        width = std::max(width, imgs[k]->width());
+        height = std::max(height, imgs[k]->height());
+        spectrum = std::max(spectrum, imgs[k]->spectrum());
+    }
+    const int numRows = (n + numColumns-1)/numColumns;
+    cimg_library::CImg<T> img(width*std::min(n, numColumns), height*numRows, 1, spectrum, (T)0);
+    for(int k = 0; k < n; ++k)
+    {
+        img.draw_image((k % numColumns)*width, (k / numColumns)*height, *imgs[k]);
+    }
+    return img;
+}
+
+#endif
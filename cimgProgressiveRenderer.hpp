@@ -0,0 +1,418 @@
+#ifndef cimgProgressiveRenderer
+#define cimgProgressiveRenderer
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "cimgMatchingSegments.hpp"
+#include <CImg.h>
+
+///
+/// \brief The ProgressiveRenderer class
+/// draws the segments of a frame over several steps, each within a time budget.
+/// The segments are drawn in a priority order, so that each step shows a representative partial frame.
+/// When drawing all the segments at full detail is expected to take more than \c _lodSteps budgets,
+/// the frame is first drawn at a low level of detail (one pixel wide lines, no markers);
+/// the full-detail frame is then drawn in a back buffer by the following steps and shown once complete.
+template <typename T>
+class ProgressiveRenderer
+{
+public:
+    //! Default constructor
+    ProgressiveRenderer(void):
+        _backgroundRevision(0),
+        _next(0),
+        _budget(0.0),
+        _radius(4),
+        _flagLod(false),
+        _flagFront(false),
+        _flagDone(true),
+        _secondsPerSegment(0.0),
+        _order(ORDER_INDEX),
+        _numRedrawn(0),
+        _numTiles(0),
+        _flagDirtyAll(true)
+    {}
+
+    ///
+    /// \brief begin
+    /// starts a frame drawing the segments whose correspondence index is not greater than \c numDraw over \c background.
+    /// \c revision identifies the content of \c background: the caller changes it whenever the background changes.
+    /// \c budget is the time of a step in milliseconds, 0 for drawing the whole frame in one step.
+    void begin(
+        const cimg_library::CImg<T>& background,
+        const unsigned long long revision,
+        const std::vector<MatchingSegment>& segments,
+        const int numDraw,
+        const SegmentOrder order,
+        const unsigned char colorPt[],
+        const unsigned char* const colorLine[],
+        const double budget,
+        const int radius = 4
+    )
+    {
+        _background = background;
+        _backgroundRevision = revision;
+        _work = _background;
+        orderSegments(_ordered, segments, numDraw, order);
+        _next = 0;
+        _budget = budget;
+        _radius = radius;
+        _flagFront = false;
+        _flagDone = false;
+        _flagLod = expectedSteps(_ordered.size()) > _lodSteps;
+        _order = order;
+        _drawn.assign(segments.begin(), segments.begin()+_ordered.size());
+        dirtyAll();
+
+        // keep the colors, the caller's arrays may not outlive the frame
+        int numLabels = 1;
+        for(auto it = _ordered.begin(); it != _ordered.end(); ++it) numLabels = std::max(numLabels, it->label+1);
+        _colors.assign(3*(numLabels+1), 0);
+        std::copy(colorPt, colorPt+3, _colors.begin());
+        for(int l = 0; l < numLabels; ++l) std::copy(colorLine[l], colorLine[l]+3, _colors.begin()+3*(l+1));
+        _colorLine.resize(numLabels);
+        for(int l = 0; l < numLabels; ++l) _colorLine[l] = &_colors[3*(l+1)];
+    }
+
+    //! draws the next segments within the budget; returns true when the frame is complete at full detail.
+    bool step(void);
+
+    ///
+    /// \brief update
+    /// brings the complete previous frame up to date with the segments \c segments up to \c numDraw in one step:
+    /// the tiles touched by the segments removed, added or changed since that frame are restored from the background,
+    /// then the segments crossing them are redrawn there, in the drawing order, so the frame is the one \c begin draws.
+    /// Returns false, leaving the frame to \c begin, when there is no complete frame, when the background, by its
+    /// \c revision, the order or the colors differ, when more than \c maxRatio of the segments changed, or when the
+    /// tiles to restore cover more than \c maxRatio of the frame: the segments redrawn are clipped to these tiles,
+    /// so their area, not the number of segments crossing them, is the cost of the update.
+    bool update(
+        const cimg_library::CImg<T>& background,
+        const unsigned long long revision,
+        const std::vector<MatchingSegment>& segments,
+        const int numDraw,
+        const SegmentOrder order,
+        const unsigned char colorPt[],
+        const unsigned char* const colorLine[],
+        const double maxRatio,
+        const int radius = 4
+    );
+    ///
+    /// \brief takeDirtyRects
+    /// appends to \c rects the rectangles of \c image() changed since the last call, offset by (\c dx,\c dy),
+    /// the whole image if it was replaced.
+    void takeDirtyRects(std::vector<FrameRect>& rects, const int dx = 0, const int dy = 0)
+    {
+        const cimg_library::CImg<T>& img = image();
+        if(_flagDirtyAll) _dirtyRects.assign(1, FrameRect(0, 0, img.width()-1, img.height()-1));
+        for(size_t k = 0; k < _dirtyRects.size(); ++k)
+        {
+            const FrameRect r = _dirtyRects[k].clipped(img.width(), img.height());
+            if(!r.empty()) rects.push_back(FrameRect(r.x0+dx, r.y0+dy, r.x1+dx, r.y1+dy));
+        }
+        _dirtyRects.clear();
+        _flagDirtyAll = false;
+    }
+    //! returns true if \c image() changed since the last \c takeDirtyRects.
+    bool changed(void) const {return _flagDirtyAll || !_dirtyRects.empty();}
+
+    //! returns the number of segments redrawn, within the restored tiles, by the last \c update.
+    size_t numberOfRedrawn(void) const {return _numRedrawn;}
+    //! returns the number of tiles restored by the last \c update.
+    size_t numberOfTiles(void) const {return _numTiles;}
+
+    //! returns true when the frame is complete at full detail.
+    bool done(void) const {return _flagDone;}
+    //! returns true while the shown frame is drawn at the low level of detail.
+    bool lod(void) const {return _flagFront || _flagLod;}
+    //! returns the frame to show: the complete low-detail frame while the full-detail one is drawn, or the frame being drawn.
+    const cimg_library::CImg<T>& image(void) const {return _flagFront ? _front : _work;}
+
+private:
+    static const int _lodSteps = 4;         //!< The number of steps beyond which a frame starts at the low level of detail.
+
+    //! returns the number of budgets needed to draw \c n segments at full detail, from the cost measured on the previous ones.
+    double expectedSteps(const size_t n) const
+    {
+        return _budget > 0 ? n*_secondsPerSegment*1000.0/_budget : 0.0;
+    }
+
+    static const int _tile = 16;            //!< The size of the tiles restored by \c update.
+
+    //! returns the number of columns and rows of tiles of the frame.
+    int tileColumns(void) const {return (_work.width()+_tile-1)/_tile;}
+    int tileRows(void) const {return (_work.height()+_tile-1)/_tile;}
+
+    ///
+    /// \brief segmentTiles
+    /// calls \c f(row, first, last) for each row of tiles crossed by the segment \c s widened by \c margin,
+    /// with the first and last columns crossed in that row.
+    template <typename F>
+    void segmentTiles(const MatchingSegment& s, const int margin, F f) const
+    {
+        const int width = _work.width(), height = _work.height();
+        const int ya = std::min(s.y0, s.y1), yb = std::max(s.y0, s.y1);
+        if(yb + margin < 0 || ya - margin >= height) return;
+        const int r0 = std::max(ya - margin, 0)/_tile, r1 = std::min(yb + margin, height-1)/_tile;
+        for(int r = r0; r <= r1; ++r)
+        { // the part of the segment within the rows of the tiles, widened by the margin
+            const int lo = std::max(ya, r*_tile - margin), hi = std::min(yb, (r+1)*_tile - 1 + margin);
+            int xlo = std::min(s.x0, s.x1), xhi = std::max(s.x0, s.x1);
+            if(s.y0 != s.y1)
+            {
+                const double slope = (double)(s.x1 - s.x0)/(s.y1 - s.y0);
+                const double xa = s.x0 + (lo - s.y0)*slope, xb = s.x0 + (hi - s.y0)*slope;
+                xlo = (int)std::floor(std::min(xa, xb));
+                xhi = (int)std::ceil(std::max(xa, xb));
+            }
+            if(xhi + margin < 0 || xlo - margin >= width) continue;
+            f(r, std::max(xlo - margin, 0)/_tile, std::min(xhi + margin, width-1)/_tile);
+        }
+    }
+
+    //! returns true if the segments can be drawn on \c img clipped to a rectangle, i.e. through the pixel format \c F.
+    template <typename F>
+    static bool clippable(const cimg_library::CImg<T>& img, const F&){return hasPixelFormat<F>(img);}
+    static bool clippable(const cimg_library::CImg<T>&, const PixelFormatGeneric<T>&){return false;}
+
+    //! draws the segment \c s on the frame, clipped to the pixels [x0,x1]x[y0,y1].
+    template <typename F>
+    void drawClipped(const MatchingSegment& s, const int x0, const int y0, const int x1, const int y1, const F&)
+    {
+        PixelCanvas<F> canvas = pixelCanvas<F>(_work);
+        drawSegments(canvas.clip(x0, y0, x1, y1), &s, &s+1, &_colors[0], &_colorLine[0], _radius, true);
+    }
+    void drawClipped(const MatchingSegment&, const int, const int, const int, const int, const PixelFormatGeneric<T>&){}
+
+    static const size_t _maxDirtyRects = 256;  //!< The number of dirty rectangles beyond which the whole image is dirty.
+
+    //! marks the shown image as replaced.
+    void dirtyAll(void)
+    {
+        _flagDirtyAll = true;
+        _dirtyRects.clear();
+    }
+    //! marks the rectangle \c r of the shown image as changed.
+    void dirty(const FrameRect& r)
+    {
+        if(_flagDirtyAll) return;
+        const cimg_library::CImg<T>& img = image();
+        const FrameRect c = r.clipped(img.width(), img.height());
+        if(_dirtyRects.size() == _maxDirtyRects || (c.width() == img.width() && c.height() == img.height())) dirtyAll();
+        else _dirtyRects.push_back(r);
+    }
+
+    //! copies the dirty tiles of \c src into \c dst.
+    void copyTiles(const cimg_library::CImg<T>& src, cimg_library::CImg<T>& dst) const;
+
+    cimg_library::CImg<T> _background;      //!< The image the segments are drawn over.
+    unsigned long long _backgroundRevision; //!< The revision of \c _background given to \c begin.
+    cimg_library::CImg<T> _work;            //!< The frame being drawn.
+    cimg_library::CImg<T> _front;           //!< The complete low-detail frame.
+    std::vector<MatchingSegment> _ordered;  //!< The segments of the frame in the drawing order.
+    size_t _next;                           //!< The first segment not drawn yet in \c _work.
+    double _budget;
+    int _radius;
+    bool _flagLod;                          //!< A flag indicating \c _work is drawn at the low level of detail.
+    bool _flagFront;                        //!< A flag indicating \c _front is shown.
+    bool _flagDone;
+    double _secondsPerSegment;              //!< The average cost of a segment at full detail.
+    std::vector<unsigned char> _colors;     //!< The point color, then the line color of each label.
+    std::vector<const unsigned char*> _colorLine;
+    SegmentOrder _order;
+    std::vector<MatchingSegment> _drawn;    //!< The segments of the frame, ordered by index.
+    std::vector<MatchingSegment> _changed;  //!< The previous and new versions of the segments changed by \c update.
+    std::vector<MatchingSegment> _redraw;   //!< The segments crossing the dirty tiles, in the drawing order.
+    std::vector<unsigned char> _dirty;      //!< The tiles restored by \c update, row by row.
+    std::vector<int> _dirtyCount;           //!< The number of dirty tiles before each column, row by row.
+    size_t _numRedrawn;
+    size_t _numTiles;
+    std::vector<FrameRect> _dirtyRects;     //!< The rectangles of the shown image changed since \c takeDirtyRects.
+    bool _flagDirtyAll;                     //!< A flag indicating the shown image was replaced since \c takeDirtyRects.
+};
+
+template <typename T>
+bool ProgressiveRenderer<T>::update(
+    const cimg_library::CImg<T>& background,
+    const unsigned long long revision,
+    const std::vector<MatchingSegment>& segments,
+    const int numDraw,
+    const SegmentOrder order,
+    const unsigned char colorPt[],
+    const unsigned char* const colorLine[],
+    const double maxRatio,
+    const int radius
+)
+{
+    // a spatial order depends on all the segments, so a change may reorder the unchanged ones
+    if(!_flagDone || _work.is_empty() || maxRatio <= 0 || order == ORDER_SPATIAL || order != _order || radius != _radius)
+        return false;
+    if(revision != _backgroundRevision || !background.is_sameXYZC(_background) ||
+       !clippable(_work, typename PixelFormatOf<T>::type()))
+        return false;
+    const size_t n = numberOfSegments(segments, numDraw);
+    int numLabels = 1;
+    for(size_t m = 0; m < n; ++m) numLabels = std::max(numLabels, segments[m].label+1);
+    if(numLabels > (int)_colorLine.size() || !std::equal(colorPt, colorPt+3, _colors.begin())) return false;
+    for(int l = 0; l < numLabels; ++l)
+    {
+        if(!std::equal(colorLine[l], colorLine[l]+3, _colorLine[l])) return false;
+    }
+
+    _changed.clear();
+    const size_t numChanges = diffSegments(_changed, _drawn.empty() ? 0 : &_drawn[0], _drawn.size(),
+                                           n > 0 ? &segments[0] : 0, n, order == ORDER_ENERGY);
+    _numRedrawn = _numTiles = 0;
+    if(numChanges > maxRatio*std::max(n, _drawn.size())) return false;
+    if(numChanges == 0) return true;
+
+    // mark the tiles touched by the previous and new versions of the changed segments
+    const int numCols = tileColumns(), numRows = tileRows(), margin = _radius + 2;
+    _dirty.assign((size_t)numCols*numRows, 0);
+    for(size_t k = 0; k < _changed.size(); ++k)
+    {
+        segmentTiles(_changed[k], margin, [&](const int r, const int c0, const int c1){
+            std::fill(&_dirty[(size_t)r*numCols+c0], &_dirty[(size_t)r*numCols+c1]+1, 1);
+        });
+    }
+    _dirtyCount.assign((size_t)(numCols+1)*numRows, 0);
+    for(int r = 0; r < numRows; ++r)
+    {
+        int* count = &_dirtyCount[(size_t)r*(numCols+1)];
+        for(int c = 0; c < numCols; ++c) count[c+1] = count[c] + _dirty[(size_t)r*numCols+c];
+        _numTiles += count[numCols];
+    }
+    if(_numTiles > maxRatio*numCols*numRows) return false;
+
+    // the segments crossing a dirty tile, in the drawing order
+    orderSegments(_ordered, segments, numDraw, order);
+    _redraw.clear();
+    for(size_t m = 0; m < _ordered.size(); ++m)
+    {
+        bool flagDirty = false;
+        segmentTiles(_ordered[m], margin, [&](const int r, const int c0, const int c1){
+            const int* count = &_dirtyCount[(size_t)r*(numCols+1)];
+            flagDirty = flagDirty || count[c1+1] > count[c0];
+        });
+        if(flagDirty) _redraw.push_back(_ordered[m]);
+    }
+    _ordered.clear();
+    _drawn.assign(segments.begin(), segments.begin()+n);
+
+    // restore the dirty tiles, then redraw the segments clipped to each run of dirty tiles they cross
+    copyTiles(_background, _work);
+    for(size_t m = 0; m < _redraw.size(); ++m)
+    {
+        const MatchingSegment& segment = _redraw[m];
+        segmentTiles(segment, margin, [&](const int r, const int c0, const int c1){
+            for(int c = c0; c <= c1; )
+            {
+                if(!_dirty[(size_t)r*numCols+c]){++c; continue;}
+                const int first = c;
+                while(c <= c1 && _dirty[(size_t)r*numCols+c]) ++c;
+                drawClipped(segment, first*_tile, r*_tile, c*_tile-1, (r+1)*_tile-1, typename PixelFormatOf<T>::type());
+            }
+        });
+    }
+    for(int r = 0; r < numRows; ++r)
+    { // the runs of restored tiles, row by row
+        for(int c = 0; c < numCols; )
+        {
+            if(!_dirty[(size_t)r*numCols+c]){++c; continue;}
+            const int first = c;
+            while(c < numCols && _dirty[(size_t)r*numCols+c]) ++c;
+            dirty(FrameRect(first*_tile, r*_tile, c*_tile-1, (r+1)*_tile-1));
+        }
+    }
+    _numRedrawn = _redraw.size();
+    return true;
+}
+
+template <typename T>
+void ProgressiveRenderer<T>::copyTiles(const cimg_library::CImg<T>& src, cimg_library::CImg<T>& dst) const
+{
+    const int numCols = tileColumns(), numRows = tileRows();
+    for(int r = 0; r < numRows; ++r)
+    {
+        const int y0 = r*_tile, y1 = std::min(y0+_tile, dst.height());
+        for(int c = 0; c < numCols; )
+        { // a run of dirty tiles is copied row by row
+            if(!_dirty[(size_t)r*numCols+c]){++c; continue;}
+            const int c0 = c;
+            while(c < numCols && _dirty[(size_t)r*numCols+c]) ++c;
+            const int x0 = c0*_tile, x1 = std::min(c*_tile, dst.width());
+            for(int ch = 0; ch < dst.spectrum(); ++ch)
+            {
+                for(int y = y0; y < y1; ++y)
+                {
+                    const T* p = src.data(x0, y, 0, ch);
+                    std::copy(p, p+(x1-x0), dst.data(x0, y, 0, ch));
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+bool ProgressiveRenderer<T>::step(void)
+{
+    if(_flagDone) return true;
+    const size_t chunk = 256; // segments drawn between two checks of the clock
+    const auto start = std::chrono::steady_clock::now();
+    while(_next < _ordered.size())
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        const size_t end = std::min(_next+chunk, _ordered.size());
+        drawSegments(_work, &_ordered[0]+_next, &_ordered[0]+end, &_colors[0], &_colorLine[0],
+                     _flagLod ? 0 : _radius, !_flagLod);
+        if(!_flagFront)
+        { // the chunk is drawn on the shown image
+            FrameRect r(_ordered[_next].x0, _ordered[_next].y0, _ordered[_next].x0, _ordered[_next].y0);
+            for(size_t m = _next; m < end; ++m)
+            {
+                const MatchingSegment& segment = _ordered[m];
+                r.x0 = std::min(r.x0, std::min(segment.x0, segment.x1)); r.x1 = std::max(r.x1, std::max(segment.x0, segment.x1));
+                r.y0 = std::min(r.y0, std::min(segment.y0, segment.y1)); r.y1 = std::max(r.y1, std::max(segment.y0, segment.y1));
+            }
+            const int margin = _radius + 2;
+            dirty(FrameRect(r.x0-margin, r.y0-margin, r.x1+margin, r.y1+margin));
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        if(!_flagLod)
+        {
+            const double cost = std::chrono::duration<double>(t1-t0).count()/(end-_next);
+            _secondsPerSegment = _secondsPerSegment > 0 ? 0.8*_secondsPerSegment + 0.2*cost : cost;
+        }
+        _next = end;
+
+        // fall back to the low level of detail as soon as the first chunk shows the frame is too heavy
+        if(!_flagLod && !_flagFront && _next == std::min(chunk, _ordered.size()) &&
+           expectedSteps(_ordered.size()-_next) > _lodSteps)
+        {
+            _work = _background;
+            _next = 0;
+            _flagLod = true;
+            dirtyAll();
+        }
+        if(_budget > 0 && std::chrono::duration<double, std::milli>(t1-start).count() >= _budget) break;
+    }
+    if(_next < _ordered.size()) return false;
+
+    if(_flagLod)
+    { // show the low-detail frame and draw the full-detail one behind it
+        _front.swap(_work);
+        _work = _background;
+        _next = 0;
+        _flagLod = false;
+        _flagFront = true;
+        return false;
+    }
+    if(_flagFront) dirtyAll(); // the full-detail frame replaces the low-detail one
+    _flagFront = false;
+    _flagDone = true;
+    return true;
+}
+
+#endif
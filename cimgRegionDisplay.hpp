@@ -0,0 +1,323 @@
+#ifndef cimgRegionDisplay
+#define cimgRegionDisplay
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "cimgPixelFormat.hpp"
+#include <CImg.h>
+
+///
+/// \brief The RegionDisplay class
+/// shows frames on a \c cimg_library::CImgDisplay, sending only the rectangles changed since the previous frame.
+///
+/// The frames are scaled to the size of the display here, nearest neighbor as \c CImgDisplay does, and only in
+/// the changed rectangles, so a full-size frame is never resized whole. With the X11 display of CImg, the
+/// rectangles are converted into the image of the display and put one by one, through the shared memory of
+/// the XShm extension when CImg uses it (\c cimg_use_xshm); the display still repaints itself from that image.
+/// A frame of another size, a resized window, changes covering most of the frame or another display system
+/// fall back to \c CImgDisplay::display with the frame scaled to the window size.
+///
+/// With verification on, each frame is read back from the window and compared with the scaled frame; run the
+/// viewer under Xvfb to check the partial updates without a screen.
+class RegionDisplay
+{
+public:
+    //! Default constructor
+    RegionDisplay(void):
+        _frameWidth(0),
+        _frameHeight(0),
+        _width(0),
+        _height(0),
+        _flagVerify(false),
+        _numRects(0),
+        _numBytes(0),
+        _numMismatches(0),
+        _numFrames(0)
+    {}
+
+    //! makes the next frame shown whole, e.g. after the display was drawn by other means.
+    void invalidate(void){_frameWidth = _frameHeight = 0;}
+
+    //! sets whether each frame shown is read back from the window and compared, with the X11 display only.
+    void verification(const bool flagVerify){_flagVerify = flagVerify;}
+    bool verification(void) const {return _flagVerify;}
+
+    ///
+    /// \brief show
+    /// shows \c frame on \c disp, of which only the rectangles \c rects changed since the previous frame shown.
+    template <typename T>
+    void show(
+        cimg_library::CImgDisplay& disp,
+        const cimg_library::CImg<T>& frame,
+        const std::vector<FrameRect>& rects
+    );
+
+    //! returns the number of rectangles sent for the last frame, 0 if it was shown whole.
+    size_t numberOfRects(void) const {return _numRects;}
+    //! returns the number of bytes of pixels sent to the display for the last frame.
+    size_t numberOfBytes(void) const {return _numBytes;}
+    //! returns the number of pixels of the window that differed from the last frame, with verification on.
+    size_t numberOfMismatches(void) const {return _numMismatches;}
+    //! returns the number of frames shown.
+    long long numberOfFrames(void) const {return _numFrames;}
+
+private:
+    //! returns the rectangle \c r of the frame in the window: the pixels whose nearest pixel of the frame is in \c r.
+    FrameRect windowRect(const FrameRect& r) const
+    {
+        const long long fw = _frameWidth, fh = _frameHeight, ww = _width, wh = _height;
+        return FrameRect((int)((r.x0*ww + fw-1)/fw), (int)((r.y0*wh + fh-1)/fh),
+                         (int)(((r.x1+1)*ww + fw-1)/fw)-1, (int)(((r.y1+1)*wh + fh-1)/fh)-1);
+    }
+
+    //! scales the rectangle \c r, in the window, of \c frame into \c _scaled.
+    template <typename T>
+    void scale(const cimg_library::CImg<T>& frame, const FrameRect& r)
+    {
+        for(int c = 0; c < _scaled.spectrum(); ++c)
+        {
+            for(int y = r.y0; y <= r.y1; ++y)
+            {
+                const T* src = frame.data(0, _mapY[y], 0, c);
+                unsigned char* dst = _scaled.data(0, y, 0, c);
+                for(int x = r.x0; x <= r.x1; ++x) dst[x] = toByte(src[_mapX[x]]);
+            }
+        }
+    }
+
+    template <typename T>
+    static unsigned char toByte(const T v)
+    {
+        return std::numeric_limits<T>::is_integer && !std::numeric_limits<T>::is_signed && sizeof(T) == 1 ? (unsigned char)v :
+               v <= (T)0 ? 0 : v >= (T)255 ? 255 : (unsigned char)v;
+    }
+
+    //! puts the rectangles \c rects, in the window, of \c src on \c disp; returns false if it cannot.
+    bool blit(cimg_library::CImgDisplay& disp, const cimg_library::CImg<unsigned char>& src, const std::vector<FrameRect>& rects);
+    //! returns the number of pixels of the window of \c disp that differ from \c src.
+    size_t mismatches(cimg_library::CImgDisplay& disp, const cimg_library::CImg<unsigned char>& src) const;
+
+    int _frameWidth;                            //!< The size of the last frame shown, 0 if none.
+    int _frameHeight;
+    int _width;                                 //!< The size of the display it was shown at.
+    int _height;
+    std::vector<int> _mapX;                     //!< The column of the frame shown in each column of the window.
+    std::vector<int> _mapY;                     //!< The row of the frame shown in each row of the window.
+    cimg_library::CImg<unsigned char> _scaled;  //!< The frame at the size of the window, unless it is shown as is.
+    std::vector<FrameRect> _windowRects;
+    bool _flagVerify;
+    size_t _numRects;
+    size_t _numBytes;
+    size_t _numMismatches;
+    long long _numFrames;
+};
+
+template <typename T>
+void RegionDisplay::show(
+    cimg_library::CImgDisplay& disp,
+    const cimg_library::CImg<T>& frame,
+    const std::vector<FrameRect>& rects
+)
+{
+    ++_numFrames;
+    _numRects = 0;
+    if(disp.is_empty())
+    { // the display takes the size of the first frame
+        disp.assign(frame.width(), frame.height());
+        invalidate();
+    }
+    if(disp.is_resized())
+    {
+        disp.resize(false);
+        invalidate();
+    }
+
+    // a frame covering most of the previous one is shown whole
+    size_t area = 0;
+    for(size_t k = 0; k < rects.size(); ++k)
+    {
+        const FrameRect r = rects[k].clipped(frame.width(), frame.height());
+        if(!r.empty()) area += (size_t)r.width()*r.height();
+    }
+    const bool flagWhole = frame.width() != _frameWidth || frame.height() != _frameHeight ||
+                           disp.width() != _width || disp.height() != _height ||
+                           2*area > (size_t)frame.width()*frame.height();
+    _frameWidth = frame.width();
+    _frameHeight = frame.height();
+    _width = disp.width();
+    _height = disp.height();
+
+    // the window rectangles, scaled into _scaled unless the frame is shown as is
+    const bool flagAsIs = _width == _frameWidth && _height == _frameHeight &&
+                          std::numeric_limits<T>::is_integer && !std::numeric_limits<T>::is_signed && sizeof(T) == 1;
+    if(flagWhole)
+    {
+        _mapX.resize(_width);
+        _mapY.resize(_height);
+        for(int x = 0; x < _width; ++x) _mapX[x] = (int)((long long)x*_frameWidth/_width);
+        for(int y = 0; y < _height; ++y) _mapY[y] = (int)((long long)y*_frameHeight/_height);
+        _windowRects.assign(1, FrameRect(0, 0, _width-1, _height-1));
+    }
+    else
+    {
+        _windowRects.clear();
+        for(size_t k = 0; k < rects.size(); ++k)
+        {
+            const FrameRect r = rects[k].clipped(_frameWidth, _frameHeight);
+            if(r.empty()) continue;
+            const FrameRect w = windowRect(r).clipped(_width, _height);
+            if(!w.empty()) _windowRects.push_back(w);
+        }
+    }
+    if(!flagAsIs)
+    {
+        const int spectrum = std::min(frame.spectrum(), 3);
+        if(_scaled.width() != _width || _scaled.height() != _height || _scaled.spectrum() != spectrum)
+        {
+            _scaled.assign(_width, _height, 1, spectrum);
+        }
+        for(size_t k = 0; k < _windowRects.size(); ++k) scale(frame, _windowRects[k]);
+    }
+    const cimg_library::CImg<unsigned char>& src = flagAsIs ?
+                reinterpret_cast<const cimg_library::CImg<unsigned char>&>(frame) : _scaled;
+
+    if(!flagWhole && blit(disp, src, _windowRects))
+    {
+        _numRects = _windowRects.size();
+        _numBytes = 0;
+        for(size_t k = 0; k < _windowRects.size(); ++k) _numBytes += 4*(size_t)_windowRects[k].width()*_windowRects[k].height();
+    }
+    else
+    {
+        disp.display(src);
+        _numBytes = 4*(size_t)_width*_height;
+    }
+    if(_flagVerify) _numMismatches = mismatches(disp, src);
+}
+
+#if cimg_display == 1
+
+//! returns the shift and the width of the bits of \c mask.
+inline void maskBits(const unsigned long mask, int& shift, int& bits)
+{
+    shift = bits = 0;
+    if(!mask) return;
+    while(!((mask >> shift) & 1)) ++shift;
+    while((mask >> (shift + bits)) & 1) ++bits;
+}
+
+//! returns the pixel value of the color (r,g,b) in an image of the masks \c masks.
+inline unsigned long packPixel(const int shifts[3], const int bits[3], const unsigned char rgb[3])
+{
+    unsigned long v = 0;
+    for(int c = 0; c < 3; ++c)
+    {
+        const unsigned long level = bits[c] >= 8 ? (unsigned long)rgb[c] << (bits[c]-8) : rgb[c] >> (8-bits[c]);
+        v |= level << shifts[c];
+    }
+    return v;
+}
+
+inline bool RegionDisplay::blit(
+    cimg_library::CImgDisplay& disp,
+    const cimg_library::CImg<unsigned char>& src,
+    const std::vector<FrameRect>& rects
+)
+{
+    XImage* const image = disp._image;
+    Display* const dpy = cimg_library::cimg::X11_attr().display;
+    if(!image || !dpy || cimg_library::cimg::X11_attr().nb_bits < 16 ||
+       image->width != src.width() || image->height != src.height()) return false;
+
+    int shifts[3], bits[3];
+    maskBits(image->red_mask, shifts[0], bits[0]);
+    maskBits(image->green_mask, shifts[1], bits[1]);
+    maskBits(image->blue_mask, shifts[2], bits[2]);
+    if(!bits[0] || !bits[1] || !bits[2]) return false;
+    const unsigned int one = 1;
+    const bool flagNative = image->bits_per_pixel == 32 &&
+                            (image->byte_order == LSBFirst) == (*(const unsigned char*)&one == 1);
+    const size_t plane = (size_t)src.width()*src.height();
+    const int c1 = src.spectrum() > 1 ? 1 : 0, c2 = src.spectrum() > 2 ? 2 : 0;
+
+    cimg_library::cimg::mutex(15); // the lock of the X11 display in CImg
+    for(size_t k = 0; k < rects.size(); ++k)
+    {
+        const FrameRect& r = rects[k];
+        for(int y = r.y0; y <= r.y1; ++y)
+        {
+            const unsigned char* p = src.data(0, y);
+            unsigned int* row = (unsigned int*)(image->data + (size_t)y*image->bytes_per_line);
+            for(int x = r.x0; x <= r.x1; ++x)
+            {
+                const unsigned char rgb[3] = {p[x], p[x + c1*plane], p[x + c2*plane]};
+                const unsigned long v = packPixel(shifts, bits, rgb);
+                if(flagNative) row[x] = (unsigned int)v;
+                else XPutPixel(image, x, y, v);
+            }
+        }
+    }
+    GC gc = DefaultGC(dpy, DefaultScreen(dpy));
+    for(size_t k = 0; k < rects.size(); ++k)
+    {
+        const FrameRect& r = rects[k];
+#ifdef cimg_use_xshm
+        if(disp._shminfo)
+        {
+            XShmPutImage(dpy, disp._window, gc, image, r.x0, r.y0, r.x0, r.y0, r.width(), r.height(), False);
+            continue;
+        }
+#endif
+        XPutImage(dpy, disp._window, gc, image, r.x0, r.y0, r.x0, r.y0, r.width(), r.height());
+    }
+    // the server has read the shared image once the requests are processed
+    XSync(dpy, False);
+    cimg_library::cimg::mutex(15, 0);
+    return true;
+}
+
+inline size_t RegionDisplay::mismatches(cimg_library::CImgDisplay& disp, const cimg_library::CImg<unsigned char>& src) const
+{
+    Display* const dpy = cimg_library::cimg::X11_attr().display;
+    if(!dpy || disp.is_empty()) return 0;
+    cimg_library::cimg::mutex(15);
+    XImage* const window = XGetImage(dpy, disp._window, 0, 0, src.width(), src.height(), AllPlanes, ZPixmap);
+    cimg_library::cimg::mutex(15, 0);
+    if(!window) return (size_t)src.width()*src.height();
+
+    int shifts[3], bits[3];
+    maskBits(window->red_mask, shifts[0], bits[0]);
+    maskBits(window->green_mask, shifts[1], bits[1]);
+    maskBits(window->blue_mask, shifts[2], bits[2]);
+    const size_t plane = (size_t)src.width()*src.height();
+    const int c1 = src.spectrum() > 1 ? 1 : 0, c2 = src.spectrum() > 2 ? 2 : 0;
+    size_t numMismatches = 0;
+    for(int y = 0; y < src.height(); ++y)
+    {
+        const unsigned char* p = src.data(0, y);
+        for(int x = 0; x < src.width(); ++x)
+        {
+            const unsigned char rgb[3] = {p[x], p[x + c1*plane], p[x + c2*plane]};
+            numMismatches += XGetPixel(window, x, y) != packPixel(shifts, bits, rgb);
+        }
+    }
+    XDestroyImage(window);
+    return numMismatches;
+}
+
+#else
+
+inline bool RegionDisplay::blit(cimg_library::CImgDisplay&, const cimg_library::CImg<unsigned char>&, const std::vector<FrameRect>&)
+{
+    return false;
+}
+
+inline size_t RegionDisplay::mismatches(cimg_library::CImgDisplay&, const cimg_library::CImg<unsigned char>&) const
+{
+    return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,385 @@
+#ifndef cimgSnapshotRing
+#define cimgSnapshotRing
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <CImg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CIMG_MATCHING_SHM
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+///
+/// \brief Snapshot ring
+/// passes the iterations of an optimizer to a viewer running in another process, through a POSIX
+/// shared-memory object holding a ring of fixed-size slots, so that a stalled or crashed display
+/// cannot stall or kill the optimizer.
+///
+/// Each slot is guarded by a sequence lock: the publisher makes the slot sequence odd, copies the
+/// snapshot and makes it even again, then publishes the snapshot number in the header. Publishing is
+/// two atomic stores and a bounded copy, without system call or lock. The subscriber only reads the
+/// shared memory: it copies the newest snapshot and keeps it if the slot sequence did not change
+/// meanwhile, retrying otherwise, so the publisher never waits for it.
+///
+/// Layout, in native byte order:
+///   SnapshotRingHeader, then numSlots slots of slotBytes bytes, each made of
+///   SnapshotSlotHeader, points0 (float, all x then all y), points1 (float), correspondences (int32,
+///   all i0 then all i1) and energy (float64).
+
+//! The header of the shared-memory object.
+struct SnapshotRingHeader
+{
+    char magic[8];                      //!< "CMVRING1"
+    std::uint32_t numSlots;
+    std::uint32_t slotBytes;            //!< Bytes of a slot, its header included.
+    char images[2][512];                //!< The paths of the images the points lie on.
+    std::atomic<std::uint64_t> latest;  //!< The number of the newest complete snapshot, 0 for none.
+    std::atomic<std::uint32_t> closed;  //!< 1 once the publisher has stopped.
+};
+
+//! The header of a slot.
+struct SnapshotSlotHeader
+{
+    std::atomic<std::uint64_t> sequence;    //!< Odd while written, 2*number once snapshot \c number is complete.
+    std::int64_t iteration;
+    std::int64_t timestamp;                 //!< Nanoseconds since the epoch of the steady clock of the publisher.
+    std::uint32_t numPoints0;
+    std::uint32_t numPoints1;
+    std::uint32_t numCorrespondences;
+    std::uint32_t reserved;
+    double energyTotal;                     //!< The sum of the energies.
+};
+
+static const char _snapshotRingMagic[8] = {'C', 'M', 'V', 'R', 'I', 'N', 'G', '1'};
+
+//! returns the bytes of the data of a snapshot.
+inline size_t snapshotBytes(const size_t numPoints0, const size_t numPoints1, const size_t numCorrespondences)
+{
+    return 2*(numPoints0+numPoints1)*sizeof(float) + numCorrespondences*(2*sizeof(std::int32_t) + sizeof(double));
+}
+
+///
+/// \brief The MatchingSnapshot struct
+/// An iteration read from the ring.
+struct MatchingSnapshot
+{
+    std::uint64_t number;               //!< The number of the snapshot, increasing from 1.
+    long long iteration;
+    long long timestamp;
+    double energyTotal;
+    cimg_library::CImg<float> points0;
+    cimg_library::CImg<float> points1;
+    cimg_library::CImg<int> correspondences;
+    std::vector<double> energy;
+
+    MatchingSnapshot(void): number(0), iteration(0), timestamp(0), energyTotal(0.0) {}
+    void swap(MatchingSnapshot& other)
+    {
+        std::swap(number, other.number);
+        std::swap(iteration, other.iteration);
+        std::swap(timestamp, other.timestamp);
+        std::swap(energyTotal, other.energyTotal);
+        points0.swap(other.points0);
+        points1.swap(other.points1);
+        correspondences.swap(other.correspondences);
+        energy.swap(other.energy);
+    }
+};
+
+///
+/// \brief The SnapshotPublisher class
+/// creates the ring and publishes the snapshots of the optimizer.
+class SnapshotPublisher
+{
+public:
+    //! Default constructor
+    SnapshotPublisher(void):
+        _header(0),
+        _size(0),
+        _next(1)
+    {}
+    //! Destructor: marks the ring closed and removes its name.
+    ~SnapshotPublisher(void) {close();}
+
+    ///
+    /// \brief create
+    /// creates the shared-memory object \c name (e.g. "/cimg-matching") with \c numSlots slots
+    /// of \c capacity bytes of data each, replacing an existing one.
+    bool create(
+        const std::string& name,
+        const std::string& image0,
+        const std::string& image1,
+        const size_t capacity = 16 << 20,
+        const int numSlots = 4
+    )
+    {
+        close();
+#ifdef CIMG_MATCHING_SHM
+        const size_t slotBytes = (sizeof(SnapshotSlotHeader) + capacity + 63) & ~(size_t)63;
+        const size_t headerBytes = (sizeof(SnapshotRingHeader) + 63) & ~(size_t)63;
+        const size_t size = headerBytes + slotBytes*std::max(numSlots, 2);
+        if(slotBytes > 0xffffffffu || !std::atomic<std::uint64_t>().is_lock_free())
+        {
+            std::cerr << "unsupported snapshot ring size or platform" << std::endl;
+            return false;
+        }
+        ::shm_unlink(name.c_str());
+        const int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(fd < 0)
+        {
+            std::cerr << "cannot create the shared memory " << name << std::endl;
+            return false;
+        }
+        void* p = MAP_FAILED;
+        if(::ftruncate(fd, (off_t)size) == 0) p = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED)
+        {
+            std::cerr << "cannot map the shared memory " << name << std::endl;
+            ::shm_unlink(name.c_str());
+            return false;
+        }
+        _name = name;
+        _size = size;
+        _header = new (p) SnapshotRingHeader;
+        _header->numSlots = (std::uint32_t)std::max(numSlots, 2);
+        _header->slotBytes = (std::uint32_t)slotBytes;
+        std::strncpy(_header->images[0], image0.c_str(), sizeof(_header->images[0])-1);
+        std::strncpy(_header->images[1], image1.c_str(), sizeof(_header->images[1])-1);
+        _header->closed.store(0);
+        for(std::uint32_t s = 0; s < _header->numSlots; ++s) new (slot(s)) SnapshotSlotHeader;
+        _next = 1;
+        _header->latest.store(0, std::memory_order_relaxed);
+        // the magic number, written last, tells the subscribers the header is complete
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(_header->magic, _snapshotRingMagic, 8);
+        return true;
+#else
+        (void)name; (void)image0; (void)image1; (void)capacity; (void)numSlots;
+        std::cerr << "shared memory is not supported on this platform" << std::endl;
+        return false;
+#endif
+    }
+
+    ///
+    /// \brief publish
+    /// copies the snapshot of \c iteration to the next slot; returns false if it exceeds the capacity of a slot.
+    template <typename TP>
+    bool publish(
+        const long long iteration,
+        const cimg_library::CImg<TP>& points0,
+        const cimg_library::CImg<TP>& points1,
+        const cimg_library::CImg<int>& correspondences,
+        const std::vector<double>& energy
+    )
+    {
+        if(!_header) return false;
+        const size_t n0 = points0.width(), n1 = points1.width(), m = correspondences.width();
+        if(sizeof(SnapshotSlotHeader) + snapshotBytes(n0, n1, m) > _header->slotBytes) return false;
+
+        const std::uint64_t number = _next++;
+        SnapshotSlotHeader* s = slot(number % _header->numSlots);
+        s->sequence.store(2*number-1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        s->iteration = iteration;
+        s->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        s->numPoints0 = (std::uint32_t)n0;
+        s->numPoints1 = (std::uint32_t)n1;
+        s->numCorrespondences = (std::uint32_t)m;
+        float* p = (float*)(s+1);
+        p = std::copy(points0.data(), points0.data()+2*n0, p);
+        p = std::copy(points1.data(), points1.data()+2*n1, p);
+        std::int32_t* c = std::copy(correspondences.data(), correspondences.data()+2*m, (std::int32_t*)p);
+        double* e = (double*)c;
+        double total = 0.0;
+        for(size_t k = 0; k < m; ++k)
+        {
+            e[k] = k < energy.size() ? energy[k] : 0.0;
+            total += e[k];
+        }
+        s->energyTotal = total;
+
+        s->sequence.store(2*number, std::memory_order_release);
+        _header->latest.store(number, std::memory_order_release);
+        return true;
+    }
+
+    //! returns the capacity of a slot, in bytes of data.
+    size_t capacity(void) const {return _header ? _header->slotBytes - sizeof(SnapshotSlotHeader) : 0;}
+
+    //! marks the ring closed, unmaps it and removes its name; the subscribers keep their mapping.
+    void close(void)
+    {
+#ifdef CIMG_MATCHING_SHM
+        if(!_header) return;
+        _header->closed.store(1, std::memory_order_release);
+        ::munmap((void*)_header, _size);
+        ::shm_unlink(_name.c_str());
+        _header = 0;
+#endif
+    }
+
+private:
+    SnapshotPublisher(const SnapshotPublisher&);
+    SnapshotPublisher& operator=(const SnapshotPublisher&);
+
+    SnapshotSlotHeader* slot(const size_t s) const
+    {
+        return (SnapshotSlotHeader*)((char*)_header + ((sizeof(SnapshotRingHeader) + 63) & ~(size_t)63) + s*_header->slotBytes);
+    }
+
+    SnapshotRingHeader* _header;
+    size_t _size;
+    std::string _name;
+    std::uint64_t _next;    //!< The number of the next snapshot.
+};
+
+///
+/// \brief The SnapshotSubscriber class
+/// maps the ring read-only and reads the newest snapshots.
+class SnapshotSubscriber
+{
+public:
+    //! Default constructor
+    SnapshotSubscriber(void):
+        _header(0),
+        _size(0),
+        _numRetries(0)
+    {}
+    ~SnapshotSubscriber(void) {detach();}
+
+    //! maps the ring \c name; returns false if it does not exist (yet).
+    bool attach(const std::string& name)
+    {
+        detach();
+#ifdef CIMG_MATCHING_SHM
+        const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0) return false;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if(::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(SnapshotRingHeader))
+        {
+            p = ::mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if(p == MAP_FAILED) return false;
+        const SnapshotRingHeader* header = (const SnapshotRingHeader*)p;
+        const bool flagMagic = std::memcmp(header->magic, _snapshotRingMagic, 8) == 0;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const size_t headerBytes = (sizeof(SnapshotRingHeader) + 63) & ~(size_t)63;
+        if(!flagMagic || header->numSlots < 2 ||
+           headerBytes + (size_t)header->numSlots*header->slotBytes > (size_t)st.st_size)
+        { // not a ring, or not initialized yet
+            ::munmap(p, (size_t)st.st_size);
+            return false;
+        }
+        _header = header;
+        _size = (size_t)st.st_size;
+        return true;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    void detach(void)
+    {
+#ifdef CIMG_MATCHING_SHM
+        if(_header) ::munmap((void*)_header, _size);
+#endif
+        _header = 0;
+    }
+
+    //! returns the path of the image \c i given by the publisher.
+    std::string image(const int i) const
+    {
+        if(!_header) return std::string();
+        const char* path = _header->images[i];
+        return std::string(path, std::find(path, path+sizeof(_header->images[i]), '\0'));
+    }
+    //! returns true once the publisher has stopped.
+    bool closed(void) const {return _header && _header->closed.load(std::memory_order_acquire) != 0;}
+    //! returns the number of reads retried because the publisher overwrote the slot meanwhile.
+    long long numberOfRetries(void) const {return _numRetries;}
+
+    ///
+    /// \brief latest
+    /// reads the newest complete snapshot into \c snapshot if it is newer than \c snapshot.number.
+    /// Returns false, leaving \c snapshot unchanged, if there is no newer snapshot.
+    bool latest(MatchingSnapshot& snapshot)
+    {
+        if(!_header) return false;
+        for(int attempt = 0; attempt < 64; ++attempt)
+        {
+            const std::uint64_t number = _header->latest.load(std::memory_order_acquire);
+            if(number == 0 || number <= snapshot.number) return false;
+            const SnapshotSlotHeader* s = slot(number % _header->numSlots);
+            const std::uint64_t sequence = s->sequence.load(std::memory_order_acquire);
+            if(sequence == 2*number && read(*s, number, _scratch))
+            {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(s->sequence.load(std::memory_order_relaxed) == sequence)
+                {
+                    snapshot.swap(_scratch);
+                    return true;
+                }
+            }
+            // overwritten while read: the publisher lapped the ring, read the newest one again
+            ++_numRetries;
+        }
+        return false;
+    }
+
+private:
+    SnapshotSubscriber(const SnapshotSubscriber&);
+    SnapshotSubscriber& operator=(const SnapshotSubscriber&);
+
+    const SnapshotSlotHeader* slot(const size_t s) const
+    {
+        return (const SnapshotSlotHeader*)((const char*)_header + ((sizeof(SnapshotRingHeader) + 63) & ~(size_t)63) + s*_header->slotBytes);
+    }
+
+    //! copies the slot \c s, checking its counts first since they may be torn.
+    bool read(const SnapshotSlotHeader& s, const std::uint64_t number, MatchingSnapshot& snapshot) const
+    {
+        const size_t n0 = s.numPoints0, n1 = s.numPoints1, m = s.numCorrespondences;
+        if(n0 > _header->slotBytes || n1 > _header->slotBytes || m > _header->slotBytes ||
+           sizeof(SnapshotSlotHeader) + snapshotBytes(n0, n1, m) > _header->slotBytes) return false;
+        snapshot.number = number;
+        snapshot.iteration = s.iteration;
+        snapshot.timestamp = s.timestamp;
+        snapshot.energyTotal = s.energyTotal;
+        const float* p = (const float*)(&s+1);
+        if(n0 > 0) snapshot.points0.assign(p, (unsigned int)n0, 2, 1, 1);
+        else snapshot.points0.assign();
+        p += 2*n0;
+        if(n1 > 0) snapshot.points1.assign(p, (unsigned int)n1, 2, 1, 1);
+        else snapshot.points1.assign();
+        p += 2*n1;
+        const std::int32_t* c = (const std::int32_t*)p;
+        if(m > 0) snapshot.correspondences.assign(c, (unsigned int)m, 2, 1, 1);
+        else snapshot.correspondences.assign();
+        const double* e = (const double*)(c + 2*m);
+        snapshot.energy.assign(e, e+m);
+        return true;
+    }
+
+    const SnapshotRingHeader* _header;
+    size_t _size;
+    long long _numRetries;
+    MatchingSnapshot _scratch;      //!< The snapshot being read, kept to reuse its buffers.
+};
+
+#endif
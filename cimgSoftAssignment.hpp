@@ -0,0 +1,283 @@
+#ifndef cimgSoftAssignment
+#define cimgSoftAssignment
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "cimgCpuDispatch.hpp"
+#include "cimgMatchingSegments.hpp"
+#include "cimgParallel.hpp"
+#include "cimgPixelKernels.hpp"
+#include <CImg.h>
+
+///
+/// \brief The SoftAssignment struct
+/// A soft assignment of the points of image 0 to the points of image 1, as output by graph-matching solvers:
+/// a sparse matrix in CSR format, row \c r for the point \c r of image 0, whose nonzeros
+/// [\c rowOffsets[r], \c rowOffsets[r+1]) give the points \c columns of image 1 and their \c weights.
+struct SoftAssignment
+{
+    std::vector<int> rowOffsets;    //!< The first nonzero of each row, then the number of nonzeros.
+    std::vector<int> columns;       //!< The point of image 1 of each nonzero.
+    std::vector<float> weights;     //!< The weight of each nonzero.
+
+    //! returns the number of rows.
+    int numberOfRows(void) const {return rowOffsets.empty() ? 0 : (int)rowOffsets.size()-1;}
+    //! returns the number of nonzeros.
+    size_t numberOfNonzeros(void) const {return columns.size();}
+    //! returns true if the offsets start at 0, never decrease and end at the number of columns and weights.
+    bool valid(void) const
+    {
+        if(rowOffsets.empty()) return columns.empty() && weights.empty();
+        if(rowOffsets.front() != 0 || (size_t)rowOffsets.back() != columns.size() || columns.size() != weights.size()) return false;
+        for(size_t r = 1; r < rowOffsets.size(); ++r) if(rowOffsets[r] < rowOffsets[r-1]) return false;
+        return true;
+    }
+};
+
+//! How the weight of a nonzero is shown.
+enum SoftMode
+{
+    SOFT_OPACITY,   //!< The segments are drawn in \c colorHigh, as opaque as their weight.
+    SOFT_COLOR      //!< The segments are drawn opaque, from \c colorLow to \c colorHigh with their weight.
+};
+
+///
+/// \brief The SoftStyle struct
+/// How the nonzeros of a soft assignment are drawn. A weight is mapped to [0,1] by \c weightMax,
+/// the weights below \c threshold are not drawn.
+struct SoftStyle
+{
+    SoftStyle(void):
+        threshold(0.1f),
+        weightMax(1.0f),
+        mode(SOFT_OPACITY),
+        radius(0)
+    {
+        const unsigned char low[3] = {0, 0, 255}, high[3] = {255, 0, 0};
+        std::copy(low, low+3, colorLow);
+        std::copy(high, high+3, colorHigh);
+    }
+
+    float threshold;            //!< The weights below are skipped.
+    float weightMax;            //!< The weight drawn opaque or in \c colorHigh.
+    SoftMode mode;
+    int radius;                 //!< The half thickness of the segments, 0 for one pixel.
+    unsigned char colorLow[3];  //!< The color of the weight 0 in \c SOFT_COLOR.
+    unsigned char colorHigh[3]; //!< The color of the weight \c weightMax.
+
+    //! returns the color and the blending weight in [0,256] of a segment of weight \c weight.
+    unsigned int color(const double weight, unsigned char rgb[3]) const
+    {
+        const double t = std::max(0.0, std::min(weight/weightMax, 1.0));
+        if(mode == SOFT_OPACITY)
+        {
+            std::copy(colorHigh, colorHigh+3, rgb);
+            return blendWeight(t);
+        }
+        for(int c = 0; c < 3; ++c) rgb[c] = (unsigned char)(colorLow[c] + t*(colorHigh[c]-colorLow[c]) + 0.5);
+        return 256;
+    }
+};
+
+///
+/// \brief resolveSoftSegments
+/// resolves the nonzeros of \c assignment not less than \c threshold into \c segments, ordered by row, their weight
+/// as their energy and their row as their index, without building the dense matrix. The weights of each row are
+/// selected by the SIMD kernel \c selectAbove, then only the selected nonzeros are read; the rows are resolved in
+/// parallel, in blocks of about the same number of nonzeros. Nonzeros referring to a point out of \c points0 or
+/// \c points1 are dropped. Returns the number of segments.
+template <typename TP>
+size_t resolveSoftSegments(
+    std::vector<MatchingSegment>& segments,
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const SoftAssignment& assignment,
+    const float threshold,
+    const int offset
+)
+{
+    assert(assignment.valid() && "The soft assignment must be a CSR matrix.");
+    segments.clear();
+    const int numRows = std::min(assignment.numberOfRows(), points0.width());
+    if(numRows == 0 || points1.width() == 0) return 0;
+
+    const PixelKernelTable& kernels = pixelKernels();
+    const int* rowOffsets = &assignment.rowOffsets[0];
+    const int* columns = assignment.columns.empty() ? 0 : &assignment.columns[0];
+    const float* weights = assignment.weights.empty() ? 0 : &assignment.weights[0];
+    const TP *px0 = points0.data(0,0), *py0 = points0.data(0,1);
+    const TP *px1 = points1.data(0,0), *py1 = points1.data(0,1);
+    const unsigned int w1 = points1.width();
+
+    // the blocks split the nonzeros evenly, whatever the lengths of the rows
+    const size_t numNonzeros = rowOffsets[numRows];
+    const int numBlocks = numNonzeros < (1u << 16) ? 1 : std::min(numRows, 4*numberOfThreads());
+    std::vector<int> firstRow(numBlocks+1, numRows);
+    for(int b = 0; b < numBlocks; ++b)
+    {
+        firstRow[b] = (int)(std::lower_bound(rowOffsets, rowOffsets+numRows, (int)(numNonzeros*b/numBlocks)) - rowOffsets);
+    }
+    std::vector<std::vector<MatchingSegment> > blocks(numBlocks);
+    parallelFor(numBlocks, [&](const int b){
+        std::vector<MatchingSegment>& out = blocks[b];
+        std::vector<unsigned int> selected;
+        for(int r = firstRow[b]; r < firstRow[b+1]; ++r)
+        {
+            const int begin = rowOffsets[r], n = rowOffsets[r+1]-begin;
+            if(n <= 0) continue;
+            if(selected.size() < (size_t)n) selected.resize(n);
+            const size_t count = kernels.selectAbove(weights+begin, n, threshold, &selected[0]);
+            for(size_t j = 0; j < count; ++j)
+            {
+                // negative indices wrap around and fail the range check
+                const unsigned int k = begin + selected[j], i1 = columns[k];
+                if(i1 >= w1) continue;
+                MatchingSegment s;
+                segmentEnds(s, px0[r], py0[r], px1[i1], py1[i1], offset);
+                s.energy = weights[k];
+                s.label = 0;
+                s.index = r;
+                out.push_back(s);
+            }
+        }
+    });
+
+    std::vector<size_t> start(numBlocks+1, 0);
+    for(int b = 0; b < numBlocks; ++b) start[b+1] = start[b] + blocks[b].size();
+    segments.resize(start[numBlocks]);
+    parallelFor(numBlocks, [&](const int b){std::copy(blocks[b].begin(), blocks[b].end(), segments.begin()+start[b]);});
+    return segments.size();
+}
+
+///
+/// \brief drawSoftSegments
+/// draws the segments [\c first, \c last) resolved from a soft assignment on a canvas of the pixel format \c F,
+/// each in the color and opacity of its weight (its energy) by \c style. The canvas is split in horizontal bands
+/// drawn in parallel, each with the segments crossing it in their order, so the frame is the same as drawn serially.
+template <typename F>
+void drawSoftSegments(
+    const PixelCanvas<F>& canvas,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const SoftStyle& style
+)
+{
+    const int height = canvas.clipY1-canvas.clipY0+1;
+    if(first == last || height <= 0) return;
+    const int r = std::max(style.radius, 0);
+    // a band walks the whole part of the thin lines before it, so there are no more bands than threads
+    const int numBands = (last-first) < 4096 ? 1 : std::min(height, numberOfThreads());
+    parallelFor(numBands, [&](const int b){
+        PixelCanvas<F> band = canvas;
+        band.clip(canvas.clipX0, canvas.clipY0 + (int)((long long)height*b/numBands),
+                  canvas.clipX1, canvas.clipY0 + (int)((long long)height*(b+1)/numBands)-1);
+        unsigned char rgb[3];
+        for(const MatchingSegment* it = first; it != last; ++it)
+        {
+            if(std::max(it->y0, it->y1)+r < band.clipY0 || std::min(it->y0, it->y1)-r > band.clipY1) continue;
+            const unsigned int w = style.color(it->energy, rgb);
+            drawCapsuleSubpixel(band, it->fx0, it->fy0, it->fx1, it->fy1, r, PixelColor<F>(rgb), w);
+        }
+    });
+}
+
+//! draws the segments on an image of any type and spectrum, \c style.radius thick like on a canvas: each segment is
+//! rasterized into a mask, then the pixels of the mask are blended once with the weight of the segment.
+template <typename T>
+void drawSoftSegments(
+    cimg_library::CImg<T>& img,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const SoftStyle& style,
+    const PixelFormatGeneric<T>&
+)
+{
+    const int width = img.width(), height = img.height(), spectrum = img.spectrum();
+    const int r = std::max(style.radius, 0);
+    const size_t plane = (size_t)width*height;
+    cimg_library::CImg<unsigned char> mask(width, height, 1, 1, 0);
+    const unsigned char white[3] = {255, 255, 255};
+    const PixelColor<PixelFormatGray8> on(white);
+    std::vector<double> color(spectrum);
+    unsigned char rgb[3];
+    for(const MatchingSegment* it = first; it != last; ++it)
+    {
+        // the rows crossed by the segment widened by the radius, and the rounding of its subpixel ends
+        const int ya = std::min(it->y0, it->y1), yb = std::max(it->y0, it->y1), m = r+1;
+        const int y0 = std::max(ya-m, 0), y1 = std::min(yb+m, height-1);
+        if(y0 > y1 || std::max(it->x0, it->x1)+m < 0 || std::min(it->x0, it->x1)-m >= width) continue;
+        const double w = style.color(it->energy, rgb)/256.0;
+        for(int c = 0; c < spectrum; ++c)
+        { // the luma of the ITU-R BT.601 conversion for one channel, opaque beyond RGB, like PixelColor
+            color[c] = spectrum == 1 ? (double)(((66*rgb[0] + 129*rgb[1] + 25*rgb[2] + 128) >> 8) + 16) : c < 3 ? rgb[c] : 255.0;
+        }
+        PixelCanvas<PixelFormatGray8> canvas = pixelCanvas<PixelFormatGray8>(mask);
+        drawCapsuleSubpixel(canvas.clip(0, y0, width-1, y1), it->fx0, it->fy0, it->fx1, it->fy1, r, on, 256);
+        const double slope = it->y0 != it->y1 ? (double)(it->x1 - it->x0)/(it->y1 - it->y0) : 0.0;
+        for(int y = y0; y <= y1; ++y)
+        { // the span of the row within the distance of the segment, from the ends of the part of the segment near it
+            int xa = std::min(it->x0, it->x1), xb = std::max(it->x0, it->x1);
+            if(it->y0 != it->y1)
+            {
+                const int lo = std::max(ya, std::min(y-m, yb)), hi = std::min(yb, std::max(y+m, ya));
+                const double xl = it->x0 + (lo - it->y0)*slope, xh = it->x0 + (hi - it->y0)*slope;
+                xa = (int)std::floor(std::min(xl, xh));
+                xb = (int)std::ceil(std::max(xl, xh));
+            }
+            unsigned char* row = mask.data(0, y);
+            for(int x = std::max(xa-m, 0), xe = std::min(xb+m, width-1); x <= xe; ++x)
+            {
+                if(!row[x]) continue;
+                row[x] = 0;
+                T* p = img.data(x, y);
+                for(int c = 0; c < spectrum; ++c) p[c*plane] = (T)(p[c*plane] + (color[c] - p[c*plane])*w);
+            }
+        }
+    }
+}
+
+//! draws the segments on \c img through the pixel format \c F when \c img is stored in that format.
+template <typename T, typename F>
+void drawSoftSegments(
+    cimg_library::CImg<T>& img,
+    const MatchingSegment* first,
+    const MatchingSegment* last,
+    const SoftStyle& style,
+    const F&
+)
+{
+    if(hasPixelFormat<F>(img))
+    {
+        drawSoftSegments(pixelCanvas<F>(img), first, last, style);
+    }
+    else
+    {
+        drawSoftSegments(img, first, last, style, PixelFormatGeneric<T>());
+    }
+}
+
+///
+/// \brief drawSoftAssignment
+/// draws the nonzeros of \c assignment not less than \c style.threshold on \c img, the aligned images with the
+/// points of image 1 shifted by \c offset, from the lowest weight to the highest so the highest stay visible.
+/// Returns the number of segments drawn.
+template <typename T, typename TP>
+size_t drawSoftAssignment(
+    cimg_library::CImg<T>& img,
+    const cimg_library::CImg<TP>& points0,
+    const cimg_library::CImg<TP>& points1,
+    const SoftAssignment& assignment,
+    const SoftStyle& style,
+    const int offset
+)
+{
+    std::vector<MatchingSegment> segments;
+    const size_t n = resolveSoftSegments(segments, points0, points1, assignment, style.threshold, offset);
+    std::stable_sort(segments.begin(), segments.end(),
+        [](const MatchingSegment& a, const MatchingSegment& b){return a.energy < b.energy;});
+    if(n > 0) drawSoftSegments(img, &segments[0], &segments[0]+n, style, typename PixelFormatOf<T>::type());
+    return n;
+}
+
+#endif
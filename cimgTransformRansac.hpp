@@ -0,0 +1,381 @@
+#ifndef cimgTransformRansac
+#define cimgTransformRansac
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "cimgCpuDispatch.hpp"
+#include "cimgParallel.hpp"
+#include <CImg.h>
+
+///
+/// \brief Transformation estimation
+/// estimates the affine transformation or the homography mapping the points of image 0 to their
+/// correspondents in image 1 with RANSAC, and warps image 1 onto image 0 with it.
+/// The hypotheses are drawn from minimal samples, fitted, and scored in batches, in parallel; each one
+/// counts its inliers over all the matches with the SIMD kernel \c transformInliers. Hypothesis k draws
+/// its sample from its own generator seeded by k, and ties go to the lowest k, so the result does not
+/// depend on the number of threads. The best hypothesis is refined by least squares on its inliers.
+
+enum TransformModel
+{
+    TRANSFORM_AFFINE,       //!< 6 degrees of freedom, from 3 matches.
+    TRANSFORM_HOMOGRAPHY    //!< 8 degrees of freedom, from 4 matches.
+};
+
+//! returns the number of matches of a minimal sample of \c model.
+inline int transformSampleSize(const TransformModel model)
+{
+    return model == TRANSFORM_AFFINE ? 3 : 4;
+}
+
+///
+/// \brief The Transform struct
+/// A 3x3 matrix, row-major, mapping (x0,y0,1) to (x1,y1,1) up to scale; the last row is (0,0,1) for an affine transformation.
+struct Transform
+{
+    Transform(const TransformModel m = TRANSFORM_AFFINE): model(m)
+    {
+        for(int k = 0; k < 9; ++k) h[k] = k % 4 == 0 ? 1.0 : 0.0;
+    }
+
+    //! maps (\c x, \c y) to (\c u, \c v); returns false if the point maps to infinity.
+    bool apply(const double x, const double y, double& u, double& v) const
+    {
+        const double w = h[6]*x + h[7]*y + h[8];
+        if(w == 0) return false;
+        u = (h[0]*x + h[1]*y + h[2])/w;
+        v = (h[3]*x + h[4]*y + h[5])/w;
+        return true;
+    }
+
+    TransformModel model;
+    double h[9];
+};
+
+//! The matches as packed arrays, the input of the estimation: (x0[i],y0[i]) in image 0 matches (x1[i],y1[i]) in image 1.
+struct PackedMatches
+{
+    std::vector<float> x0, y0, x1, y1;
+    std::vector<int> index;     //!< The correspondence of each match.
+
+    size_t size(void) const {return x0.size();}
+    void clear(void) {x0.clear(); y0.clear(); x1.clear(); y1.clear(); index.clear();}
+    void push_back(const float u0, const float v0, const float u1, const float v1, const int m)
+    {
+        x0.push_back(u0); y0.push_back(v0); x1.push_back(u1); y1.push_back(v1); index.push_back(m);
+    }
+};
+
+//! The parameters of \c estimateTransform.
+struct RansacOptions
+{
+    RansacOptions(void):
+        model(TRANSFORM_HOMOGRAPHY),
+        threshold(3.0),
+        confidence(0.999),
+        maxHypotheses(2000),
+        batchSize(64),
+        seed(1)
+    {}
+
+    TransformModel model;
+    double threshold;       //!< The largest distance in pixels from an inlier to the image of its match.
+    double confidence;      //!< The probability of drawing an outlier-free sample, which stops the sampling early.
+    int maxHypotheses;
+    int batchSize;          //!< The number of hypotheses scored in parallel between the checks of the stopping criterion.
+    unsigned int seed;
+};
+
+//! The result of \c estimateTransform.
+struct RansacResult
+{
+    RansacResult(void): numInliers(0), numHypotheses(0), valid(false) {}
+
+    Transform transform;
+    std::vector<unsigned char> inliers;     //!< 1 for the inlier matches, in the order of the matches.
+    int numInliers;
+    int numHypotheses;                      //!< The number of hypotheses drawn.
+    bool valid;                             //!< false if no hypothesis could be fitted, e.g. fewer matches than a sample.
+};
+
+///
+/// \brief solveLinear
+/// solves a x = b in place by Gaussian elimination with partial pivoting, \c a being n x n row-major;
+/// returns false if \c a is singular.
+inline bool solveLinear(double* a, double* b, const int n)
+{
+    for(int c = 0; c < n; ++c)
+    {
+        int pivot = c;
+        for(int r = c+1; r < n; ++r) if(std::fabs(a[r*n+c]) > std::fabs(a[pivot*n+c])) pivot = r;
+        if(std::fabs(a[pivot*n+c]) < 1e-12) return false;
+        if(pivot != c)
+        {
+            for(int k = 0; k < n; ++k) std::swap(a[c*n+k], a[pivot*n+k]);
+            std::swap(b[c], b[pivot]);
+        }
+        for(int r = c+1; r < n; ++r)
+        {
+            const double f = a[r*n+c]/a[c*n+c];
+            for(int k = c; k < n; ++k) a[r*n+k] -= f*a[c*n+k];
+            b[r] -= f*b[c];
+        }
+    }
+    for(int c = n-1; c >= 0; --c)
+    {
+        for(int k = c+1; k < n; ++k) b[c] -= a[c*n+k]*b[k];
+        b[c] /= a[c*n+c];
+    }
+    return true;
+}
+
+///
+/// \brief fitTransform
+/// fits the transformation of \c model to the \c count matches \c indices of \c matches by least squares,
+/// exactly for a minimal sample. The points are first centered and scaled to a mean distance of sqrt(2)
+/// to the origin, which keeps the normal equations well conditioned.
+inline bool fitTransform(
+    const PackedMatches& matches,
+    const int* indices,
+    const int count,
+    const TransformModel model,
+    Transform& transform
+)
+{
+    if(count < transformSampleSize(model)) return false;
+    // normalizations s*(p - c) of both point sets
+    double c[4] = {0, 0, 0, 0}, s[2] = {0, 0};
+    for(int k = 0; k < count; ++k)
+    {
+        const int i = indices[k];
+        c[0] += matches.x0[i]; c[1] += matches.y0[i]; c[2] += matches.x1[i]; c[3] += matches.y1[i];
+    }
+    for(int j = 0; j < 4; ++j) c[j] /= count;
+    for(int k = 0; k < count; ++k)
+    {
+        const int i = indices[k];
+        s[0] += std::hypot(matches.x0[i]-c[0], matches.y0[i]-c[1]);
+        s[1] += std::hypot(matches.x1[i]-c[2], matches.y1[i]-c[3]);
+    }
+    if(s[0] <= 0 || s[1] <= 0) return false;
+    s[0] = std::sqrt(2.0)*count/s[0];
+    s[1] = std::sqrt(2.0)*count/s[1];
+
+    // the normal equations of the transformation of the normalized points
+    const int numUnknowns = model == TRANSFORM_AFFINE ? 6 : 8;
+    double ata[64] = {0}, atb[8] = {0};
+    for(int k = 0; k < count; ++k)
+    {
+        const int i = indices[k];
+        const double x = s[0]*(matches.x0[i]-c[0]), y = s[0]*(matches.y0[i]-c[1]);
+        const double u = s[1]*(matches.x1[i]-c[2]), v = s[1]*(matches.y1[i]-c[3]);
+        // u = (h0 x + h1 y + h2)/(h6 x + h7 y + 1), linearized as h0 x + h1 y + h2 - h6 x u - h7 y u = u, and likewise for v
+        double rows[2][8] = {
+            {x, y, 1, 0, 0, 0, -x*u, -y*u},
+            {0, 0, 0, x, y, 1, -x*v, -y*v}
+        };
+        const double rhs[2] = {u, v};
+        for(int r = 0; r < 2; ++r)
+        {
+            for(int a = 0; a < numUnknowns; ++a)
+            {
+                if(rows[r][a] == 0) continue;
+                for(int b = 0; b < numUnknowns; ++b) ata[a*numUnknowns+b] += rows[r][a]*rows[r][b];
+                atb[a] += rows[r][a]*rhs[r];
+            }
+        }
+    }
+    if(!solveLinear(ata, atb, numUnknowns)) return false;
+    double hn[9] = {atb[0], atb[1], atb[2], atb[3], atb[4], atb[5], 0, 0, 1};
+    if(model == TRANSFORM_HOMOGRAPHY)
+    {
+        hn[6] = atb[6];
+        hn[7] = atb[7];
+    }
+
+    // h = N1^-1 hn N0, with N = [s 0 -s cx; 0 s -s cy; 0 0 1]
+    const double n0[9] = {s[0], 0, -s[0]*c[0], 0, s[0], -s[0]*c[1], 0, 0, 1};
+    const double n1inv[9] = {1/s[1], 0, c[2], 0, 1/s[1], c[3], 0, 0, 1};
+    double t[9], h[9];
+    for(int r = 0; r < 3; ++r) for(int q = 0; q < 3; ++q)
+        t[3*r+q] = hn[3*r]*n0[q] + hn[3*r+1]*n0[3+q] + hn[3*r+2]*n0[6+q];
+    for(int r = 0; r < 3; ++r) for(int q = 0; q < 3; ++q)
+        h[3*r+q] = n1inv[3*r]*t[q] + n1inv[3*r+1]*t[3+q] + n1inv[3*r+2]*t[6+q];
+    if(std::fabs(h[8]) < 1e-12) return false;
+    transform.model = model;
+    for(int k = 0; k < 9; ++k)
+    {
+        transform.h[k] = h[k]/h[8];
+        if(!std::isfinite(transform.h[k])) return false;
+    }
+    return true;
+}
+
+//! returns true if the points \c a, \c b and \c c of the image \c image (0 or 1) of \c matches are nearly collinear.
+inline bool matchesCollinear(const PackedMatches& matches, const int image, const int a, const int b, const int c)
+{
+    const std::vector<float>& x = image == 0 ? matches.x0 : matches.x1;
+    const std::vector<float>& y = image == 0 ? matches.y0 : matches.y1;
+    const double area = (x[b]-x[a])*(double)(y[c]-y[a]) - (x[c]-x[a])*(double)(y[b]-y[a]);
+    return std::fabs(area) < 1.0;
+}
+
+//! returns the number of inliers of \c transform among \c matches, marking them in \c inliers unless it is 0.
+inline int countTransformInliers(
+    const PackedMatches& matches,
+    const Transform& transform,
+    const double threshold,
+    unsigned char* inliers = 0
+)
+{
+    float h[9];
+    for(int k = 0; k < 9; ++k) h[k] = (float)transform.h[k];
+    return (int)pixelKernels().transformInliers(
+        matches.x0.data(), matches.y0.data(), matches.x1.data(), matches.y1.data(), matches.size(),
+        h, (float)(threshold*threshold), inliers);
+}
+
+///
+/// \brief estimateTransform
+/// estimates the transformation of \c options.model mapping the points of image 0 of \c matches to
+/// their matches in image 1 with RANSAC.
+inline RansacResult estimateTransform(const PackedMatches& matches, const RansacOptions& options = RansacOptions())
+{
+    RansacResult result;
+    const int n = (int)matches.size();
+    const int sampleSize = transformSampleSize(options.model);
+    if(n < sampleSize) return result;
+
+    // hypothesis k: its sample, its transformation and its number of inliers, -1 if degenerate
+    const int batchSize = std::max(options.batchSize, 1);
+    std::vector<Transform> transforms(batchSize);
+    std::vector<int> scores(batchSize);
+    auto hypothesis = [&](const int k, Transform& transform) -> int
+    {
+        // splitmix64 on (seed, k)
+        std::uint64_t state = ((std::uint64_t)options.seed << 32) ^ (std::uint64_t)k;
+        auto next = [&state]() -> std::uint64_t
+        {
+            std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        };
+        int sample[4];
+        for(int j = 0; j < sampleSize; ++j)
+        {
+            bool flagRepeated;
+            do
+            {
+                sample[j] = (int)(next() % (std::uint64_t)n);
+                flagRepeated = std::find(sample, sample+j, sample[j]) != sample+j;
+            }
+            while(flagRepeated);
+        }
+        for(int image = 0; image < 2; ++image)
+        {
+            for(int j = 0; j < sampleSize; ++j)
+            {
+                if(matchesCollinear(matches, image, sample[j], sample[(j+1)%sampleSize], sample[(j+2)%sampleSize])) return -1;
+            }
+        }
+        if(!fitTransform(matches, sample, sampleSize, options.model, transform)) return -1;
+        return countTransformInliers(matches, transform, options.threshold);
+    };
+
+    int best = -1, maxHypotheses = std::max(options.maxHypotheses, 1);
+    while(result.numHypotheses < maxHypotheses)
+    {
+        const int first = result.numHypotheses;
+        const int count = std::min(batchSize, maxHypotheses - first);
+        parallelFor(count, [&](const int b){scores[b] = hypothesis(first + b, transforms[b]);});
+        for(int b = 0; b < count; ++b)
+        {
+            if(scores[b] > best)
+            {
+                best = scores[b];
+                result.transform = transforms[b];
+            }
+        }
+        result.numHypotheses += count;
+        // the number of hypotheses drawing an outlier-free sample with the given confidence, at the best inlier ratio so far
+        if(best >= sampleSize)
+        {
+            const double ratio = std::pow((double)best/n, sampleSize);
+            const double needed = ratio >= 1 ? 1 : std::log(1-options.confidence)/std::log(1-ratio);
+            if(needed < maxHypotheses) maxHypotheses = std::max((int)std::ceil(needed), result.numHypotheses);
+        }
+    }
+    if(best < sampleSize) return result;
+
+    // refine on the inliers while their number grows
+    result.inliers.resize(n);
+    result.numInliers = countTransformInliers(matches, result.transform, options.threshold, &result.inliers[0]);
+    std::vector<int> indices;
+    for(int pass = 0; pass < 3; ++pass)
+    {
+        indices.clear();
+        for(int i = 0; i < n; ++i) if(result.inliers[i]) indices.push_back(i);
+        Transform refined;
+        if(!fitTransform(matches, indices.data(), (int)indices.size(), options.model, refined)) break;
+        if(countTransformInliers(matches, refined, options.threshold) <= result.numInliers) break;
+        result.transform = refined;
+        result.numInliers = countTransformInliers(matches, refined, options.threshold, &result.inliers[0]);
+    }
+    result.valid = true;
+    return result;
+}
+
+///
+/// \brief warpBilinear
+/// returns the image of \c width x \c height whose pixel (x,y) is \c src at \c transform(x,y), interpolated
+/// bilinearly, or \c background(x,y) where \c transform(x,y) falls outside \c src; \c background has the size
+/// of the result, which has the channels of \c src. The rows are warped in parallel.
+template <typename T>
+cimg_library::CImg<T> warpBilinear(
+    const cimg_library::CImg<T>& src,
+    const Transform& transform,
+    const cimg_library::CImg<T>& background
+)
+{
+    const int width = background.width(), height = background.height(), channels = src.spectrum();
+    cimg_library::CImg<T> dst(width, height, 1, channels);
+    const size_t planeSrc = (size_t)src.width()*src.height(), planeDst = (size_t)width*height;
+    const double* h = transform.h;
+    const int numBlocks = std::min(height, 4*numberOfThreads());
+    parallelFor(numBlocks, [&](const int block)
+    {
+        for(int y = (int)((long long)height*block/numBlocks); y < (int)((long long)height*(block+1)/numBlocks); ++y)
+        {
+            // the terms of u, v and w linear in x, updated along the row
+            double nu = h[1]*y + h[2], nv = h[4]*y + h[5], w = h[7]*y + h[8];
+            for(int x = 0; x < width; ++x, nu += h[0], nv += h[3], w += h[6])
+            {
+                const size_t p = (size_t)y*width + x;
+                const double u = nu/w, v = nv/w;
+                if(!(w != 0 && u >= 0 && v >= 0 && u <= src.width()-1 && v <= src.height()-1))
+                {
+                    for(int c = 0; c < channels; ++c) dst.data()[c*planeDst + p] = background.data()[std::min(c, background.spectrum()-1)*planeDst + p];
+                    continue;
+                }
+                const int u0 = std::min((int)u, src.width()-2 < 0 ? 0 : src.width()-2);
+                const int v0 = std::min((int)v, src.height()-2 < 0 ? 0 : src.height()-2);
+                const int u1 = std::min(u0+1, src.width()-1), v1 = std::min(v0+1, src.height()-1);
+                const double fu = u - u0, fv = v - v0;
+                for(int c = 0; c < channels; ++c)
+                {
+                    const T* s = src.data() + c*planeSrc;
+                    const double top = s[(size_t)v0*src.width()+u0]*(1-fu) + s[(size_t)v0*src.width()+u1]*fu;
+                    const double bottom = s[(size_t)v1*src.width()+u0]*(1-fu) + s[(size_t)v1*src.width()+u1]*fu;
+                    dst.data()[c*planeDst + p] = (T)(top*(1-fv) + bottom*fv + (std::numeric_limits<T>::is_integer ? 0.5 : 0));
+                }
+            }
+        }
+    });
+    return dst;
+}
+
+#endif
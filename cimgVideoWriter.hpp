@@ -0,0 +1,286 @@
+#ifndef cimgVideoWriter
+#define cimgVideoWriter
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cimgCpuDispatch.hpp"
+#include <CImg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CIMG_MATCHING_POPEN
+#include <pthread.h>
+#include <signal.h>
+#endif
+
+#ifdef CIMG_MATCHING_POPEN
+///
+/// \brief The PipeSignalBlock class
+/// blocks SIGPIPE in the calling thread while it lives, so a write to a command which exited fails with EPIPE
+/// instead of killing the process. The signal raised meanwhile is consumed before the mask is restored;
+/// the signal handlers of the process are left alone.
+class PipeSignalBlock
+{
+public:
+    PipeSignalBlock(void)
+    {
+        sigemptyset(&_pipe);
+        sigaddset(&_pipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &_pipe, &_previous);
+        _flagPending = isPending();
+    }
+    ~PipeSignalBlock(void)
+    {
+        int signal;
+        if(!_flagPending && isPending()) sigwait(&_pipe, &signal);
+        pthread_sigmask(SIG_SETMASK, &_previous, 0);
+    }
+
+private:
+    PipeSignalBlock(const PipeSignalBlock&);
+    PipeSignalBlock& operator=(const PipeSignalBlock&);
+
+    static bool isPending(void)
+    {
+        sigset_t pending;
+        return sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1;
+    }
+
+    sigset_t _pipe;
+    sigset_t _previous;
+    bool _flagPending;  //!< A flag indicating SIGPIPE was pending before, and is left so.
+};
+#endif
+
+///
+/// \brief rgbToYuv420
+/// converts the planar RGB (or grayscale) image \c img to the planes Y, U and V of \c yuv,
+/// BT.601 with limited range, the chroma averaged over 2x2 blocks (the last column or row is repeated
+/// when the size is odd). \c yuv holds w*h + 2*((w+1)/2)*((h+1)/2) bytes.
+inline void rgbToYuv420(const cimg_library::CImg<unsigned char>& img, unsigned char* yuv)
+{
+    const PixelKernelTable& kernels = pixelKernels();
+    const int width = img.width(), height = img.height();
+    const int cw = (width+1)/2, ch = (height+1)/2;
+    const size_t plane = (size_t)width*height;
+    const unsigned char* r = img.data();
+    const unsigned char* g = img.spectrum() < 3 ? r : r + plane;
+    const unsigned char* b = img.spectrum() < 3 ? r : r + 2*plane;
+    unsigned char* u = yuv + plane;
+    unsigned char* v = u + (size_t)cw*ch;
+
+    kernels.rgbToGray(r, g, b, yuv, plane);
+    for(int y = 0; y < ch; ++y)
+    {
+        const size_t row0 = (size_t)2*y*width;
+        const size_t row1 = 2*y+1 < height ? row0 + width : row0;
+        kernels.rgbToChroma420(r+row0, g+row0, b+row0, r+row1, g+row1, b+row1, u+(size_t)y*cw, v+(size_t)y*cw, width/2);
+        if(width % 2)
+        { // the last block is a single column
+            const size_t x = width-1;
+            const unsigned char r2[2] = {r[row0+x], r[row0+x]}, g2[2] = {g[row0+x], g[row0+x]}, b2[2] = {b[row0+x], b[row0+x]};
+            const unsigned char r3[2] = {r[row1+x], r[row1+x]}, g3[2] = {g[row1+x], g[row1+x]}, b3[2] = {b[row1+x], b[row1+x]};
+            rgbToChroma420Scalar(r2, g2, b2, r3, g3, b3, u+(size_t)y*cw+cw-1, v+(size_t)y*cw+cw-1, 1);
+        }
+    }
+}
+
+///
+/// \brief The Y4MWriter class
+/// streams frames as an uncompressed YUV4MPEG2 video, 4:2:0, to a file or to the standard input
+/// of a command (e.g. "|ffmpeg -i - out.mp4"), so long runs can be reviewed as one video
+/// without linking a video library.
+/// The frames are converted to YUV by the caller of \c push and written by a writer thread.
+/// A fixed set of \c maxInFlight frame buffers is recycled, so the memory stays constant
+/// however many frames are written; \c push blocks while all of them wait to be written.
+class Y4MWriter
+{
+public:
+    //! Default constructor
+    explicit Y4MWriter(
+        const int fps = 25,
+        const int maxInFlight = 4
+    ):
+        _fps(fps > 0 ? fps : 25),
+        _maxInFlight(maxInFlight > 0 ? maxInFlight : 1),
+        _file(0),
+        _flagPipe(false),
+        _width(0),
+        _height(0),
+        _numFrames(0),
+        _flagFailed(false),
+        _stop(false)
+    {}
+    //! Destructor: writes the pending frames and closes the stream.
+    ~Y4MWriter(void) {close();}
+
+    ///
+    /// \brief open
+    /// opens \c path for writing; a path starting with '|' is a command reading the video on its standard input.
+    bool open(const std::string& path)
+    {
+        close();
+        if(!path.empty() && path[0] == '|')
+        {
+#ifdef CIMG_MATCHING_POPEN
+            // a command which exits early must not kill the process: the writes block SIGPIPE
+            _file = popen(path.c_str()+1, "w");
+#endif
+            _flagPipe = true;
+        }
+        else
+        {
+            _file = std::fopen(path.c_str(), "wb");
+            _flagPipe = false;
+        }
+        if(!_file)
+        {
+            std::cerr << "cannot open " << path << std::endl;
+            return false;
+        }
+        _width = _height = 0;
+        _numFrames = 0;
+        _flagFailed = false;
+        _stop = false;
+        _thread = std::thread(&Y4MWriter::run, this);
+        return true;
+    }
+
+    ///
+    /// \brief push
+    /// queues \c frame; the first frame sets the size of the video, which the following ones must have.
+    /// Returns false if the frame is rejected or the stream failed.
+    bool push(const cimg_library::CImg<unsigned char>& frame)
+    {
+        if(!_file) return false;
+        if(_numFrames == 0)
+        {
+            _width = frame.width();
+            _height = frame.height();
+            char header[128];
+            std::snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", _width, _height, _fps);
+            std::vector<unsigned char> bytes(header, header+std::strlen(header));
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue.push_back(bytes);
+        }
+        else if(frame.width() != _width || frame.height() != _height)
+        {
+            std::cerr << "frame " << _numFrames << " is " << frame.width() << "x" << frame.height()
+                      << ", the video is " << _width << "x" << _height << std::endl;
+            return false;
+        }
+
+        std::vector<unsigned char> buffer;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cvSpace.wait(lock, [this](){return _flagFailed || _queue.size() < (size_t)_maxInFlight;});
+            if(_flagFailed) return false;
+            if(!_free.empty())
+            {
+                buffer.swap(_free.back());
+                _free.pop_back();
+            }
+        }
+        static const char tag[] = "FRAME\n";
+        const size_t size = 6 + (size_t)_width*_height + 2*(size_t)((_width+1)/2)*((_height+1)/2);
+        buffer.resize(size);
+        std::copy(tag, tag+6, buffer.begin());
+        rgbToYuv420(frame, &buffer[6]);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(std::vector<unsigned char>());
+            _queue.back().swap(buffer);
+        }
+        _cvWork.notify_one();
+        ++_numFrames;
+        return true;
+    }
+
+    //! writes the pending frames and closes the stream; returns false if a frame could not be written.
+    bool close(void)
+    {
+        if(!_file) return !_flagFailed;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cvWork.notify_one();
+        _thread.join();
+#ifdef CIMG_MATCHING_POPEN
+        // closing flushes the last bytes
+        const PipeSignalBlock block;
+        const int status = _flagPipe ? pclose(_file) : std::fclose(_file);
+#else
+        const int status = std::fclose(_file);
+#endif
+        _file = 0;
+        _free.clear();
+        if(status != 0) _flagFailed = true;
+        return !_flagFailed;
+    }
+
+    //! returns true while the stream is open.
+    bool isOpen(void) const {return _file != 0;}
+    //! returns the number of frames pushed.
+    long long numberOfFrames(void) const {return _numFrames;}
+    //! returns true if a write failed.
+    bool failed(void) const {std::lock_guard<std::mutex> lock(_mutex); return _flagFailed;}
+
+private:
+    Y4MWriter(const Y4MWriter&);
+    Y4MWriter& operator=(const Y4MWriter&);
+
+    void run(void)
+    {
+#ifdef CIMG_MATCHING_POPEN
+        const PipeSignalBlock block;
+#endif
+        for(;;)
+        {
+            std::vector<unsigned char> buffer;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cvWork.wait(lock, [this](){return _stop || !_queue.empty();});
+                if(_queue.empty()) return;
+                buffer.swap(_queue.front());
+                _queue.pop_front();
+            }
+            const bool ok = std::fwrite(&buffer[0], 1, buffer.size(), _file) == buffer.size();
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if(!ok && !_flagFailed)
+                {
+                    _flagFailed = true;
+                    std::cerr << "cannot write the video stream" << std::endl;
+                }
+                if(_free.size() < (size_t)_maxInFlight) _free.push_back(std::vector<unsigned char>());
+                if(!_free.empty()) _free.back().swap(buffer);
+            }
+            _cvSpace.notify_one();
+        }
+    }
+
+    const int _fps;
+    const int _maxInFlight;
+    std::FILE* _file;
+    bool _flagPipe;                     //!< A flag indicating \c _file was opened by \c popen.
+    int _width;
+    int _height;
+    long long _numFrames;
+    std::thread _thread;
+    mutable std::mutex _mutex;
+    std::condition_variable _cvWork;    //!< Notified when a frame is queued or the stream closes.
+    std::condition_variable _cvSpace;   //!< Notified when a frame is written.
+    std::deque<std::vector<unsigned char> > _queue;     //!< The header and the frames waiting to be written.
+    std::vector<std::vector<unsigned char> > _free;     //!< The written frame buffers, reused by \c push.
+    bool _flagFailed;
+    bool _stop;
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef cimgWorkStealing
+#define cimgWorkStealing
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cimgParallel.hpp"
+
+///
+/// \brief The WorkStealingPool class
+/// A pool of worker threads, each owning a deque of tasks.
+/// A worker pushes and pops the tasks it submits at the back of its own deque, so that
+/// follow-up tasks run on the same core while their data are still in cache,
+/// and steals from the front of the other deques when its own is empty.
+/// Tasks submitted from outside the pool are distributed round-robin.
+class WorkStealingPool
+{
+public:
+    typedef std::function<void(void)> Task;
+
+    //! Default constructor
+    explicit WorkStealingPool(
+        const int numWorkers = numberOfThreads()
+    ):
+        _pending(0),
+        _queued(0),
+        _next(0),
+        _steals(0),
+        _stop(false)
+    {
+        for(int k = 0; k < std::max(numWorkers, 1); ++k)
+        {
+            _workers.push_back(std::unique_ptr<Worker>(new Worker));
+        }
+        for(int k = 0; k < (int)_workers.size(); ++k)
+        {
+            _threads.push_back(std::thread(&WorkStealingPool::run, this, k));
+        }
+    }
+    //! Destructor: waits for all the tasks, then stops the workers.
+    ~WorkStealingPool(void)
+    {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cvWork.notify_all();
+        for(auto it = _threads.begin(); it != _threads.end(); ++it) it->join();
+    }
+
+    //! returns the number of workers.
+    int numberOfWorkers(void) const {return (int)_workers.size();}
+    //! returns the index of the calling worker, or -1 if called from outside the pool.
+    int currentWorker(void) const {return current().first == this ? current().second : -1;}
+    //! returns the number of tasks taken from another worker's deque.
+    long long numberOfSteals(void) const {return _steals;}
+
+    //! submits \c task; from a worker, it goes to the back of the worker's own deque.
+    void submit(const Task& task)
+    {
+        const int self = currentWorker();
+        const int k = self >= 0 ? self : (int)(_next++ % _workers.size());
+        ++_pending;
+        {
+            std::lock_guard<std::mutex> lock(_workers[k]->mutex);
+            _workers[k]->tasks.push_back(task);
+        }
+        ++_queued;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+        }
+        _cvWork.notify_one();
+    }
+
+    //! waits until all the submitted tasks, including the ones they submit, have finished.
+    void wait(void)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cvDone.wait(lock, [this](){return _pending == 0;});
+    }
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    //! returns the pool and the worker index of the calling thread.
+    static std::pair<const WorkStealingPool*, int>& current(void)
+    {
+        static thread_local std::pair<const WorkStealingPool*, int> worker(nullptr, -1);
+        return worker;
+    }
+
+    //! takes the last task of the worker \c k.
+    bool pop(const int k, Task& task)
+    {
+        std::lock_guard<std::mutex> lock(_workers[k]->mutex);
+        if(_workers[k]->tasks.empty()) return false;
+        task = std::move(_workers[k]->tasks.back());
+        _workers[k]->tasks.pop_back();
+        return true;
+    }
+
+    //! takes the first task of another worker, starting after \c k.
+    bool steal(const int k, Task& task)
+    {
+        const int n = (int)_workers.size();
+        for(int d = 1; d < n; ++d)
+        {
+            Worker& victim = *_workers[(k+d) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if(victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++_steals;
+            return true;
+        }
+        return false;
+    }
+
+    void run(const int k)
+    {
+        current() = std::make_pair(this, k);
+        Task task;
+        for(;;)
+        {
+            if(pop(k, task) || steal(k, task))
+            {
+                --_queued;
+                task();
+                task = Task();
+                if(--_pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _cvDone.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cvWork.wait(lock, [this](){return _stop || _queued > 0;});
+            if(_stop && _queued == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker> > _workers;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;                  //!< Guards the sleeping and the completion of the workers.
+    std::condition_variable _cvWork;    //!< Notified when a task is queued or the pool stops.
+    std::condition_variable _cvDone;    //!< Notified when no task is pending.
+    std::atomic<long long> _pending;    //!< Tasks submitted and not finished.
+    std::atomic<long long> _queued;     //!< Tasks waiting in the deques.
+    std::atomic<unsigned int> _next;    //!< Next worker for the tasks submitted from outside.
+    std::atomic<long long> _steals;
+    bool _stop;
+};
+
+#endif
@@ -43,6 +43,10 @@ SET(CIMG_JPEG_CCFLAGS  -Dcimg_use_jpeg)
 # ( http://www.libtiff.org/ )
 SET(CIMG_TIFF_CCFLAGS  -Dcimg_use_tiff)
 
+# Flags to enable zlib compression, used by CImg and by the PNG frame encoder.
+# ( http://www.zlib.net/ )
+SET(CIMG_ZLIB_CCFLAGS  -Dcimg_use_zlib)
+
 # Flags to enable native support for PNG image files, using the PNG library.
 # ( http://www.libpng.org/ )
 SET(CIMG_PNG_CCFLAGS  -Dcimg_use_png)
@@ -260,9 +264,14 @@ endif()
 
 if(NOT APPLE)
   if(NOT WIN32)
-    if(X11_FOUND)
-      SET(CIMG_CFLAGS "${CIMG_CFLAGS} ${CIMG_XSHM_CCFLAGS} ${CIMG_XRANDR_CCFLAGS}")
-      SET(CImg_SYSTEM_LIBS ${CImg_SYSTEM_LIBS} Xext Xrandr)
+    # the partial display updates put the frames through the shared memory of XShm when it is found
+    if(X11_FOUND AND X11_XShm_FOUND)
+      SET(CIMG_CFLAGS "${CIMG_CFLAGS} ${CIMG_XSHM_CCFLAGS}")
+      SET(CImg_SYSTEM_LIBS ${CImg_SYSTEM_LIBS} ${X11_Xext_LIB})
+    endif()
+    if(X11_FOUND AND X11_Xrandr_FOUND)
+      SET(CIMG_CFLAGS "${CIMG_CFLAGS} ${CIMG_XRANDR_CCFLAGS}")
+      SET(CImg_SYSTEM_LIBS ${CImg_SYSTEM_LIBS} ${X11_Xrandr_LIB})
     endif()
   endif(NOT WIN32)
 endif(NOT APPLE)
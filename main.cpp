@@ -3,10 +3,21 @@
 #include <vector>
 #include <random>
 #include <sstream>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
 
 #include <CImg.h>
 
 #include "cimgMatchingViewer.hpp"
+#include "cimgMatchingViewerFusion.hpp"
+#include "cimgMatchingIO.hpp"
+#include "cimgMatchingWorkload.hpp"
+#include "cimgMatchingBatch.hpp"
+#include "cimgFrameEncoder.hpp"
+#include "cimgFrameServer.hpp"
+#include "cimgVideoWriter.hpp"
+#include "cimgSnapshotRing.hpp"
 
 template <typename T>
 void drawMatching(
@@ -194,14 +205,93 @@ void drawMatching(
 
 int main(int argc, char* argv[])
 {
-    typedef unsigned char T;
     std::random_device rnd;
     std::mt19937 mt(rnd());
 
+    /// verify the runtime-dispatched pixel kernels against the scalar ones
+    if(argc > 1 && std::string(argv[1]) == "--verify-kernels")
+    {
+        bool flagOk = true;
+        std::cout << "selected SIMD level: " << simdLevelName(simdLevel()) << std::endl;
+        for(int l = 0; l <= simdLevelSupported(); ++l)
+        {
+            bool ok = pixelKernelsVerify((SimdLevel)l);
+            std::cout << simdLevelName((SimdLevel)l) << ": " << (ok ? "bit-exact" : "MISMATCH") << std::endl;
+            flagOk = flagOk && ok;
+        }
+        return flagOk ? 0 : 1;
+    }
+
+    /// render the pairs of a manifest without display
+    if(argc > 2 && std::string(argv[1]) == "--batch")
+    {
+        std::vector<BatchEntry> entries;
+        if(!loadManifest(argv[2], entries)) return 1;
+        const int numWorkers = argc > 3 ? std::atoi(argv[3]) : numberOfThreads();
+        const int pngLevel = argc > 4 ? std::atoi(argv[4]) : defaultPngLevel();
+        BatchReport report = renderBatch<unsigned char, int>(entries, numWorkers, pngLevel);
+        std::cout << "rendered " << report.numPairs-report.numFailed << "/" << report.numPairs << " pairs in "
+                  << report.seconds << " s on " << report.numWorkers << " workers: "
+                  << report.pairsPerSecond() << " pairs/s (" << report.numSteals << " steals, "
+                  << report.numCacheHits << " image cache hits, " << report.numCacheMisses << " misses)" << std::endl;
+        return report.numFailed == 0 ? 0 : 1;
+    }
+
+    /// save the panels of synthetic iterations to numbered files instead of displaying them,
+    /// or publish the iterations to the snapshot ring read by CImgMatchingMonitor
+    std::string strExport, strPublish;
+    int numExport = 0;
+    if(argc > 2 && (std::string(argv[1]) == "--export" || std::string(argv[1]) == "--publish"))
+    {
+        (std::string(argv[1]) == "--export" ? strExport : strPublish) = argv[2];
+        numExport = argc > 3 ? std::atoi(argv[3]) : 100;
+        argc = 1;   // the synthetic matching uses the default images
+    }
+
+    /// show the fusion of K synthetic proposals, one of which is expanded by each iteration
+    int numProposals = 0;
+    if(argc > 2 && std::string(argv[1]) == "--fusion")
+    {
+        numProposals = std::max(1, std::min(std::atoi(argv[2]), 255));
+        numExport = argc > 3 ? std::atoi(argv[3]) : 2*numProposals;
+        argc = 1;
+    }
+
+    /// play the pairs of consecutive frames of a sequence, a directory or a list of images, with synthetic tracks
+    std::string strSequence;
+    double fps = 25.0;
+    int numAhead = 4;
+    if(argc > 2 && std::string(argv[1]) == "--sequence")
+    {
+        strSequence = argv[2];
+        if(argc > 3) fps = std::atof(argv[3]);
+        if(argc > 4) numAhead = std::atoi(argv[4]);
+        argc = 1;
+    }
+
+    /// show a synthetic soft assignment, K weights per point of image 0, those below the threshold skipped
+    int numSoft = 0;
+    SoftStyle softStyle;
+    if(argc > 2 && std::string(argv[1]) == "--soft")
+    {
+        numSoft = std::max(1, std::atoi(argv[2]));
+        if(argc > 3) softStyle.threshold = (float)std::atof(argv[3]);
+        argc = 1;
+    }
+
+    /// shape the synthetic move-making iterations: points, distribution, invalid labels, flips, iterations and seed,
+    /// displayed or driven without display as fast as possible
+    WorkloadOptions workloadOptions;
+    bool flagBench = false;
+    if(argc > 2 && (std::string(argv[1]) == "--workload" || std::string(argv[1]) == "--bench"))
+    {
+        flagBench = std::string(argv[1]) == "--bench";
+        if(!parseWorkload(argc, argv, 2, workloadOptions)) return 1;
+        argc = 1;
+    }
+
     std::cout << "run CImg matching result viewer..." << std::endl;
     std::vector<std::string> strFileInput;
-    std::vector<int> width, height;
-    cimg_library::CImgList<T> images;
 
     /// set input images
     int numImage = 2;
@@ -219,72 +309,361 @@ int main(int argc, char* argv[])
     }
     for(auto it = strFileInput.begin(); it != strFileInput.end(); ++it)
     {
-        int n = it - strFileInput.begin();
-        std::cout << "str[" << n << "] = " << *it << std::endl;
-        cimg_library::CImg<T> _img(it->c_str());
-        if(_img.spectrum() == 3)
+        std::cout << "str[" << (it - strFileInput.begin()) << "] = " << *it << std::endl;
+    }
+
+    /// serve the completed frames over HTTP when CIMG_MATCHING_HTTP_PORT is set, to watch without a display
+    FrameServer server;
+    FrameServer* frameServer = 0;
+    if(const char* port = std::getenv("CIMG_MATCHING_HTTP_PORT"))
+    {
+        if(!server.start(std::atoi(port))) return 1;
+        frameServer = &server;
+        std::cout << "serving the frames on http://127.0.0.1:" << server.port() << "/" << std::endl;
+    }
+    // open no display when served with CIMG_MATCHING_HEADLESS set, or without an X server to open one on
+#if cimg_display == 1
+    const bool flagNoDisplay = std::getenv("DISPLAY") == NULL;
+#else
+    const bool flagNoDisplay = cimg_display == 0;
+#endif
+    const bool flagHeadless = frameServer && (std::getenv("CIMG_MATCHING_HEADLESS") != NULL || flagNoDisplay);
+
+    /// estimate the transformation between the images when CIMG_MATCHING_TRANSFORM is affine or homography
+    bool flagTrans = false;
+    RansacOptions ransacOptions;
+    if(const char* model = std::getenv("CIMG_MATCHING_TRANSFORM"))
+    {
+        flagTrans = true;
+        ransacOptions.model = std::string(model) == "affine" ? TRANSFORM_AFFINE : TRANSFORM_HOMOGRAPHY;
+    }
+    // read each frame back from the window and report the pixels that differ, e.g. under Xvfb
+    const bool flagBlitVerify = std::getenv("CIMG_MATCHING_BLIT_VERIFY") != NULL;
+    // label the correspondences with their index and/or energy when CIMG_MATCHING_LABELS is index, energy or both
+    int pointLabels = 0;
+    if(const char* labels = std::getenv("CIMG_MATCHING_LABELS"))
+    {
+        const std::string strLabels(labels);
+        if(strLabels == "index" || strLabels == "both") pointLabels |= LABEL_INDEX;
+        if(strLabels == "energy" || strLabels == "both") pointLabels |= LABEL_ENERGY;
+    }
+
+    if(!strSequence.empty())
+    {
+        MatchingViewer<unsigned char, int> view;
+        view.frameServer(frameServer);
+        view.headless(flagHeadless);
+        view.transformView(flagTrans, ransacOptions);
+        view.regionDisplay().verification(flagBlitVerify);
+        view.pointLabels(pointLabels);
+        std::vector<std::string> strFrames;
+        if(!listFrames(strSequence, strFrames)) return 1;
+        if(!view.sequence(strFrames, numAhead))
         {
-            images.insert( getGrayscaledRGB( _img ) );
+            std::cerr << "a sequence needs two frames at least" << std::endl;
+            return 1;
         }
-        else
+        // the tracks drift by a few pixels between the frames; a lost track is restarted elsewhere
+        const int numTracks = 500;
+        std::normal_distribution<> randStep(0.0, 2.0);
+        std::uniform_real_distribution<> randUnit(0.0, 1.0);
+        cimg_library::CImg<double> tracks;
+        int numPairs = 0;
+        auto start = std::chrono::steady_clock::now();
+        view.displaySequence([&](const int){
+            const int w = view.width(0), h = view.height(0);
+            if(tracks.is_empty())
+            {
+                tracks.assign(numTracks, 2);
+                for(int m = 0; m < numTracks; ++m)
+                {
+                    tracks(m,0) = randUnit(mt)*(w-1);
+                    tracks(m,1) = randUnit(mt)*(h-1);
+                }
+            }
+            cimg_library::CImg<int> point0(numTracks, 2), point1(numTracks, 2), correspondences(numTracks, 2);
+            std::vector<double> energy(numTracks);
+            for(int m = 0; m < numTracks; ++m)
+            {
+                point0(m,0) = (int)tracks(m,0);
+                point0(m,1) = (int)tracks(m,1);
+                const double dx = randStep(mt), dy = randStep(mt);
+                tracks(m,0) += dx;
+                tracks(m,1) += dy;
+                const bool flagLost = tracks(m,0) < 0 || tracks(m,0) > w-1 || tracks(m,1) < 0 || tracks(m,1) > h-1 || randUnit(mt) < 0.02;
+                if(flagLost) {tracks(m,0) = randUnit(mt)*(w-1); tracks(m,1) = randUnit(mt)*(h-1);}
+                point1(m,0) = (int)tracks(m,0);
+                point1(m,1) = (int)tracks(m,1);
+                correspondences(m,0) = m;
+                correspondences(m,1) = flagLost ? -1 : m;
+                energy[m] = std::min(1.0, std::sqrt(dx*dx+dy*dy)/6.0);
+            }
+            view.points(point0, point1);
+            view.correspondences(correspondences);
+            view.energy(energy);
+            ++numPairs;
+        }, fps);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "played " << numPairs << " pairs of " << view.sequence().size() << " frames in " << elapsed.count() << " s: "
+                  << numPairs/elapsed.count() << " pairs/s (" << view.sequence().numberOfReady() << " frames prefetched, "
+                  << view.sequence().numberOfWaited() << " waited for)" << std::endl;
+        return 0;
+    }
+
+    if(numSoft > 0)
+    {
+        // each point of image 0 has K random candidates in image 1 and most of its weight on the first one
+        MatchingViewer<unsigned char, int> view;
+        view.regionDisplay().verification(flagBlitVerify);
+        view.images(strFileInput);
+        const int numPoints = 2000;
+        for(int n = 0; n < numImage; ++n)
         {
-            images.insert( getGraytoRGB( _img ) );
+            std::uniform_int_distribution<> randX(0, view.width(n)-1), randY(0, view.height(n)-1);
+            view.point(n).assign(numPoints, 2);
+            for(int m = 0; m < numPoints; ++m)
+            {
+                view.point(n)(m,0) = randX(mt);
+                view.point(n)(m,1) = randY(mt);
+            }
+        }
+        SoftAssignment assignment;
+        std::uniform_int_distribution<> randColumn(0, numPoints-1);
+        std::exponential_distribution<float> randWeight(10.0f);
+        assignment.rowOffsets.push_back(0);
+        for(int m = 0; m < numPoints; ++m)
+        {
+            for(int k = 0; k < numSoft; ++k)
+            {
+                assignment.columns.push_back(randColumn(mt));
+                assignment.weights.push_back(k == 0 ? 0.5f + 0.5f*std::min(randWeight(mt), 1.0f) : std::min(randWeight(mt), 1.0f));
+            }
+            assignment.rowOffsets.push_back((int)assignment.columns.size());
         }
+        size_t numSegments = 0;
+        auto start = std::chrono::steady_clock::now();
+        view.drawSoftAssignment(assignment, softStyle, &numSegments);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "drew " << numSegments << " of " << assignment.numberOfNonzeros() << " weights above "
+                  << softStyle.threshold << " in " << elapsed.count() << " s" << std::endl;
+        view.displaySoftAssignment(assignment, softStyle);
+        return 0;
+    }
 
-        width.push_back( images(n).width() );
-        height.push_back( images(n).height() );
+    /// load the matching result given next to the images:
+    /// points0 points1 correspondences [energy], as CSV or binary files
+    if(argc > numImage+3)
+    {
+        // the images are decoded in the background while the matching result is loaded
+        MatchingViewer<unsigned char, int> view;
+        view.frameServer(frameServer);
+        view.headless(flagHeadless);
+        view.transformView(flagTrans, ransacOptions);
+        view.regionDisplay().verification(flagBlitVerify);
+        view.pointLabels(pointLabels);
+        view.imagesAsync(strFileInput);
+        auto start = std::chrono::steady_clock::now();
+        if(!loadPoints(argv[numImage+1], view.point(0)) ||
+           !loadPoints(argv[numImage+2], view.point(1)) ||
+           !loadCorrespondences(argv[numImage+3], view.correspondences()))
+        {
+            return 1;
+        }
+        if(argc > numImage+4)
+        {
+            if(!loadEnergy(argv[numImage+4], view.energy())) return 1;
+        }
+        else
+        {
+            view.energy().assign(view.numberOfCorrespondences(), 0.0);
+        }
+        if(view.numberOfEnergy() != view.numberOfCorrespondences())
+        {
+            std::cerr << "the numbers of correspondences and energies differ" << std::endl;
+            return 1;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "loaded " << view.numberOfPoint(0) << "/" << view.numberOfPoint(1) << " points and "
+                  << view.numberOfCorrespondences() << " correspondences in " << elapsed.count() << " s" << std::endl;
+        view.displayUpdate();
+        while(flagHeadless)
+        { // without a window to close, the frame is served until the process is interrupted
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        return 0;
     }
 
     /// synthesize a set of points on the images
-    std::uniform_int_distribution<> randNumPoint(5, 20);
-    std::vector<int> numPoints(2);
+    MatchingViewerMoveMaking<unsigned char, int> viewmm;
+    viewmm.frameServer(frameServer);
+    viewmm.headless(flagHeadless);
+    viewmm.transformView(flagTrans, ransacOptions);
+    viewmm.regionDisplay().verification(flagBlitVerify);
+    viewmm.pointLabels(pointLabels);
+    viewmm.images(strFileInput);
+    MoveMakingWorkload<int> workload(workloadOptions, viewmm.width(0), viewmm.height(0), viewmm.width(1), viewmm.height(1));
     cimg_library::CImgList<int> points(2);
     for(int n = 0; n < numImage; ++n)
     {
-        numPoints[n] = randNumPoint(mt);
-        points(n) = cimg_library::CImg<int>(numPoints[n], 2);
-        std::uniform_int_distribution<> randX(0, width[n]-1);
-        std::uniform_int_distribution<> randY(0, height[n]-1);
-        for(int m = 0; m < numPoints[n]; ++m)
-        {
-            points(n)(m,0) = randX(mt);
-            points(n)(m,1) = randY(mt);
-        }
+        points(n) = workload.point(n);
     }
 
     /// test MatchingViewer
-    int numCorrespondences = numPoints[0];
-    std::uniform_int_distribution<> rand1(-1, numPoints[1]-1);
-    std::uniform_int_distribution<> randFusion(-1, 1);
+    const int numCorrespondences = workload.numberOfCorrespondences();
+    std::uniform_int_distribution<> rand1(-1, points(1).width()-1);
     std::uniform_real_distribution<> randE(0.0, 1.0);
-    int numIte;
 
-    MatchingViewerMoveMaking<unsigned char, int> viewmm;
-    viewmm.images(strFileInput);
     viewmm.points(points(0), points(1));
 
-    cimg_library::CImg<int> correspondencesCurrent(numCorrespondences, 2);
-    cimg_library::CImg<int> correspondencesNew(numCorrespondences, 2);
-    cimg_library::CImg<int> correspondencesFusion(numCorrespondences, 2);
-    std::vector<double> energyCurrent(numCorrespondences);
-    std::vector<double> energyNew(numCorrespondences);
-    std::vector<double> energyFusion(numCorrespondences);
-    numIte = 5;
-    while(--numIte > 0)
+    // each iteration starts from the fusion of the previous one
+    const cimg_library::CImg<int>& correspondencesCurrent = workload.correspondencesCurrent();
+    const cimg_library::CImg<int>& correspondencesNew = workload.correspondencesNew();
+    const cimg_library::CImg<int>& correspondencesFusion = workload.correspondencesFusion();
+    const std::vector<double>& energyCurrent = workload.energyCurrent();
+    const std::vector<double>& energyNew = workload.energyNew();
+    const std::vector<double>& energyFusion = workload.energyFusion();
+    auto randomize = [&](){workload.next();};
+
+    if(numProposals > 0)
     {
-        std::cout << "ite" << numIte << std::endl;
+        // alpha-expansion: each iteration draws a new proposal and the correspondences it lowers the energy of take it
+        MatchingViewerFusion<unsigned char, int> viewf;
+        viewf.frameServer(frameServer);
+        viewf.headless(flagHeadless);
+        viewf.transformView(flagTrans, ransacOptions);
+        viewf.regionDisplay().verification(flagBlitVerify);
+        viewf.pointLabels(pointLabels);
+        viewf.images(strFileInput);
+        viewf.points(points(0), points(1));
+        cimg_library::CImg<int> source(numCorrespondences);
+        cimg_library::CImg<int> proposals(numCorrespondences, numProposals);
+        cimg_library::CImg<double> energyProposals(numCorrespondences, numProposals);
+        std::vector<unsigned char> labels(numCorrespondences, 0);
+        std::vector<double> energyFusion(numCorrespondences);
         for(int m = 0; m < numCorrespondences; ++m)
         {
-            correspondencesCurrent(m,0) = m;
-            correspondencesNew(m,0) = m;
-            correspondencesFusion(m,0) = m;
-            correspondencesCurrent(m,1) = rand1(mt);
-            correspondencesNew(m,1) = rand1(mt);
-            correspondencesFusion(m,1) = randFusion(mt);
-            energyCurrent[m] = randE(mt);
-            energyNew[m] = randE(mt);
-            energyFusion[m] = randE(mt);
+            source(m) = m;
+            for(int k = 0; k < numProposals; ++k)
+            {
+                proposals(m,k) = rand1(mt);
+                energyProposals(m,k) = randE(mt);
+            }
+            energyFusion[m] = energyProposals(m,0);
+        }
+        viewf.energyPlot(true, 32);
+        for(int ite = 0; ite < numExport; ++ite)
+        {
+            const int k = ite % numProposals;
+            for(int m = 0; m < numCorrespondences; ++m)
+            {
+                proposals(m,k) = rand1(mt);
+                energyProposals(m,k) = randE(mt);
+                if(labels[m] == k || energyProposals(m,k) < energyFusion[m]) labels[m] = k;
+                energyFusion[m] = energyProposals(m,labels[m]);
+            }
+            std::cout << "expansion " << ite << " of proposal " << k << std::endl;
+            viewf.proposals(source, proposals, energyProposals);
+            viewf.fusion(labels, energyFusion);
+            viewf.displayUpdate();
+        }
+        return 0;
+    }
+
+    if(!strPublish.empty())
+    {
+        // one snapshot of the fused correspondences per iteration, at about 10 iterations per second
+        SnapshotPublisher ring;
+        if(!ring.create(strPublish, strFileInput[0], strFileInput[1])) return 1;
+        for(int ite = 0; ite < numExport; ++ite)
+        {
+            randomize();
+            MatchingFrame<int> fusion = MatchingViewerMoveMaking<unsigned char, int>::fusionFrame(
+                points(0), points(1), correspondencesCurrent, correspondencesNew, correspondencesFusion, energyFusion, numCorrespondences);
+            if(!ring.publish(ite, points(0), points(1), fusion.correspondences, fusion.energy))
+            {
+                std::cerr << "iteration " << ite << " exceeds the " << ring.capacity() << " bytes of a snapshot" << std::endl;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
+        return 0;
+    }
+
+    const bool flagVideo = !strExport.empty() &&
+        (strExport[0] == '|' || (strExport.size() > 4 && strExport.compare(strExport.size()-4, 4, ".y4m") == 0));
+    if(flagVideo)
+    {
+        // one video of all the iterations, written while the next panels are rendered
+        auto start = std::chrono::steady_clock::now();
+        Y4MWriter video;
+        if(!video.open(strExport)) return 1;
+        for(int ite = 0; ite < numExport; ++ite)
+        {
+            randomize();
+            viewmm.correspondences(correspondencesCurrent, correspondencesNew, correspondencesFusion);
+            viewmm.energy(energyCurrent, energyNew, energyFusion);
+            if(!video.push(viewmm.renderPanels(viewmm.panelFrames(numCorrespondences)))) break;
+        }
+        const bool ok = video.close();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "exported " << video.numberOfFrames() << " frames to " << strExport << " in " << elapsed.count() << " s: "
+                  << video.numberOfFrames()/elapsed.count() << " frames/s" << std::endl;
+        return ok ? 0 : 1;
+    }
+    if(!strExport.empty())
+    {
+        // the panels of an iteration are rendered while the encoder threads write the previous ones
+        auto start = std::chrono::steady_clock::now();
+        FrameEncoder<unsigned char> encoder;
+        for(int ite = 0; ite < numExport; ++ite)
+        {
+            randomize();
+            viewmm.correspondences(correspondencesCurrent, correspondencesNew, correspondencesFusion);
+            viewmm.energy(energyCurrent, energyNew, energyFusion);
+            encoder.push(viewmm.renderPanels(viewmm.panelFrames(numCorrespondences)), numberedFramePath(strExport, ite));
+        }
+        encoder.finish();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "exported " << encoder.numberOfFrames()-encoder.numberOfFailed() << "/" << encoder.numberOfFrames()
+                  << " frames (" << encoder.bytes() << " bytes) in " << elapsed.count() << " s: "
+                  << encoder.numberOfFrames()/elapsed.count() << " frames/s" << std::endl;
+        return encoder.numberOfFailed() == 0 ? 0 : 1;
+    }
+
+    if(flagBench)
+    {
+        // the iterations are resolved and their panels redrawn over the previous ones as displayUpdate does, without display
+        auto start = std::chrono::steady_clock::now();
+        long long numFlips = 0, numAccepted = 0;
+        for(int ite = 0; ite < workloadOptions.numIterations; ++ite)
+        {
+            randomize();
+            numFlips += workload.numberOfFlips();
+            numAccepted += workload.numberOfAccepted();
+            viewmm.correspondences(correspondencesCurrent, correspondencesNew, correspondencesFusion);
+            viewmm.energy(energyCurrent, energyNew, energyFusion);
+            viewmm.segmentsUpdate();
+            // no budget, so every frame is drawn at full detail in one step, never at the low level of detail
+            viewmm.panelsBegin(numCorrespondences, true, 0);
+            while(!viewmm.panelsStep()) {}
+            viewmm.panelsFrame(numCorrespondences);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const int numIterations = std::max(workloadOptions.numIterations, 1);
+        std::cout << "drove " << workloadOptions.numIterations << " iterations of " << numCorrespondences << " "
+                  << (workloadOptions.distribution == DISTRIBUTION_CLUSTERED ? "clustered" : "uniform") << " correspondences ("
+                  << workloadOptions.invalidRatio << " invalid, " << numFlips/numIterations << " flips and "
+                  << numAccepted/numIterations << " accepted per iteration) in "
+                  << elapsed.count() << " s: "
+                  << workloadOptions.numIterations/elapsed.count() << " iterations/s" << std::endl;
+        return 0;
+    }
+
+    // the energy sums, the flips and the histogram of the fused energies of the iterations
+    viewmm.energyPlot(true, 32);
+    for(int ite = workloadOptions.numIterations; ite > 0; --ite)
+    {
+        std::cout << "ite" << ite << std::endl;
+        randomize();
         viewmm.displayUpdate(
             correspondencesCurrent,
             correspondencesNew,
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+#include <CImg.h>
+
+#include "cimgFrameServer.hpp"
+#include "cimgMatchingViewer.hpp"
+#include "cimgSnapshotRing.hpp"
+
+///
+/// \brief CImgMatchingMonitor
+/// shows the newest iteration published by an optimizer in the snapshot ring,
+/// in its own process, so that closing or stalling the display does not affect the optimizer.
+///   $ ./CImgMatchingMonitor [--http port] [/ring-name [image0 image1]]
+/// The images default to the ones named by the publisher.
+/// With --http, no window is opened: the frames are served on the local port instead (see FrameServer),
+/// until the publisher stops.
+int main(int argc, char* argv[])
+{
+    FrameServer server;
+    const bool flagHttp = argc > 2 && std::string(argv[1]) == "--http";
+    if(flagHttp)
+    {
+        if(!server.start(std::atoi(argv[2]))) return 1;
+        std::cout << "serving the frames on http://127.0.0.1:" << server.port() << "/" << std::endl;
+        argv += 2;
+        argc -= 2;
+    }
+    const std::string name = argc > 1 ? argv[1] : "/cimg-matching";
+
+    /// wait for the publisher
+    SnapshotSubscriber ring;
+    std::cout << "waiting for " << name << "..." << std::endl;
+    while(!ring.attach(name))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::vector<std::string> strImage(2);
+    for(int i = 0; i < 2; ++i)
+    {
+        strImage[i] = argc > 3 ? argv[2+i] : ring.image(i);
+        std::cout << "str[" << i << "] = " << strImage[i] << std::endl;
+    }
+    MatchingViewer<unsigned char, float> view;
+    view.images(strImage);
+
+    /// show the newest snapshot, polling the ring between the window events
+    cimg_library::CImgDisplay disp;
+    MatchingSnapshot snapshot;
+    bool flagClosed = false;
+    for(;;)
+    {
+        if(ring.latest(snapshot))
+        {
+            view.points(snapshot.points0, snapshot.points1);
+            view.correspondences(snapshot.correspondences);
+            view.energy(snapshot.energy);
+            // all the correspondences, the caption showing the last one
+            MatchingFrame<float> frame = view.frame(snapshot.correspondences.width()-1);
+            std::stringstream ss;
+            ss << "iteration " << snapshot.iteration << ": " << snapshot.correspondences.width()
+               << " correspondences, energy " << snapshot.energyTotal;
+            frame.title = ss.str();
+            const cimg_library::CImg<unsigned char> img = view.render(frame);
+            if(flagHttp)
+            {
+                server.publish(img, FrameStatus::summary(snapshot.iteration, snapshot.correspondences.width(), snapshot.energy));
+            }
+            else if(disp.is_empty()) disp.assign(img, name.c_str());
+            else disp.display(img);
+        }
+        if(!flagClosed && ring.closed())
+        {
+            flagClosed = true;
+            std::cout << "the publisher has stopped after snapshot " << snapshot.number << std::endl;
+        }
+        if(!disp.is_empty() && (disp.is_closed() || disp.is_keyESC() || disp.is_keyQ())) break;
+        if(disp.is_empty() && flagClosed) break;
+        if(disp.is_empty()) std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        else disp.wait(30);
+    }
+    std::cout << "last snapshot " << snapshot.number << ", " << ring.numberOfRetries() << " reads retried" << std::endl;
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cimgMatchingViewerApi.hpp"
+
+namespace
+{
+
+//! prints \c what and returns false if \c ok is false.
+bool check(const bool ok, const std::string& what)
+{
+    if(!ok) std::cerr << "FAILED: " << what << std::endl;
+    return ok;
+}
+
+//! sets a matching of three correspondences through \c MatchingView<TP>, and checks that the inputs of
+//! different sizes are rejected.
+template <typename TP>
+bool checkView(const std::string& name)
+{
+    MatchingView<TP> view;
+    bool ok = true;
+    const std::vector<TP> x = {1, 2, 3}, y = {4, 5, 6};
+    ok = check(view.points(0, x, y), name + " points") && ok;
+    ok = check(view.points(1, y, x), name + " points") && ok;
+    ok = check(view.correspondences({0, 1, 2}, {2, -1, 0}), name + " correspondences") && ok;
+    view.energy({0.0, 1.0, 2.0});
+    ok = check(view.numberOfCorrespondences() == 3, name + " number of correspondences") && ok;
+    ok = check(!view.points(0, x, {4, 5}), name + " points of different sizes rejected") && ok;
+    ok = check(!view.correspondences({0, 1, 2}, {2, -1}), name + " correspondences of different sizes rejected") && ok;
+    ok = check(view.numberOfCorrespondences() == 3, name + " correspondences kept") && ok;
+    ok = check(!view.load("", "", ""), name + " load of no file rejected") && ok;
+    return ok;
+}
+
+//! as \c checkView, through \c MatchingViewMoveMaking<TP>.
+template <typename TP>
+bool checkViewMoveMaking(const std::string& name)
+{
+    MatchingViewMoveMaking<TP> view;
+    bool ok = true;
+    const std::vector<TP> x = {1, 2, 3}, y = {4, 5, 6};
+    ok = check(view.points(0, x, y), name + " points") && ok;
+    ok = check(view.points(1, y, x), name + " points") && ok;
+    ok = check(view.correspondences({0, 1, 2}, {2, -1, 0}, {1, 0, -1}, {1, 0, -1}), name + " correspondences") && ok;
+    view.energy({0.0, 1.0, 2.0}, {1.0, 0.0, 2.0}, {0.0, 0.0, 2.0});
+    ok = check(view.numberOfCorrespondences() == 3, name + " number of correspondences") && ok;
+    ok = check(!view.correspondences({0, 1, 2}, {2, -1, 0}, {1, 0}, {1, 0, -1}),
+               name + " correspondences of different sizes rejected") && ok;
+    ok = check(view.numberOfCorrespondences() == 3, name + " correspondences kept") && ok;
+    return ok;
+}
+
+}
+
+///
+/// \brief CImgMatchingViewerApi
+/// sets matchings through cimgMatchingViewerApi.hpp alone, without CImg.h, as a tool embedding the viewer
+/// does, and returns 1 if a check fails.
+///   $ ./CImgMatchingViewerApi
+int main(void)
+{
+    bool ok = checkView<int>("MatchingView<int>");
+    ok = checkView<float>("MatchingView<float>") && ok;
+    ok = checkViewMoveMaking<int>("MatchingViewMoveMaking<int>") && ok;
+    ok = checkViewMoveMaking<float>("MatchingViewMoveMaking<float>") && ok;
+    std::cout << (ok ? "viewer API: ok" : "viewer API: FAILED") << std::endl;
+    return ok ? 0 : 1;
+}